@@ -0,0 +1,113 @@
+#include "alipay_async_transaction.h"
+#include "alipay_order.h"
+#include "alipay_payment.h"
+#include "alipay_id_generator.h"
+#include "alipay_schema_manager.h"
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+
+// 协程下单压测：N 个事件循环线程，每个循环上并发运行 C 个下单协程，
+// 每单在一个 XA 分支内写入订单和支付记录并一阶段提交，输出总吞吐。
+// 与阻塞 API 相比，同样的在途请求数只需 N 个线程
+// 用法：async_order_bench host user password db [循环线程数] [订单总数] [每循环并发数] [每循环连接数]
+
+namespace {
+
+std::atomic<uint64_t> g_next{0};
+std::atomic<uint64_t> g_committed{0};
+std::atomic<uint64_t> g_failed{0};
+
+AsyncTask<bool> placeOrder(AlipayAsyncConnectionPool& pool) {
+    AsyncConnectionLease lease = co_await pool.acquire();
+    if (!lease) co_return false;
+
+    AlipayOrder order;
+    order.setOutTradeNo(AlipayIdGenerator::getInstance().nextString("ASYNC"));
+    order.setTotalAmount(100);
+    order.setSubject("协程压测");
+    order.setTimeoutExpress(900);
+
+    AlipayAsyncTransaction transaction(*lease);
+    if (!co_await transaction.beginTransaction()) co_return false;
+
+    AlipayPayment payment;
+    bool ok = co_await order.createOrderAsync(transaction) &&
+              co_await payment.createPaymentAsync(transaction, order.getOutTradeNo());
+    if (!ok) {
+        co_await transaction.rollbackTransaction();
+        co_return false;
+    }
+    co_return co_await transaction.commitTransaction();
+}
+
+// 不断领取订单直到总数用完；最后一个结束的协程停止循环
+AsyncTask<void> worker(AlipayAsyncConnectionPool& pool, uint64_t total,
+                       std::atomic<size_t>& running) {
+    while (g_next.fetch_add(1, std::memory_order_relaxed) < total) {
+        bool ok = co_await placeOrder(pool);
+        (ok ? g_committed : g_failed).fetch_add(1, std::memory_order_relaxed);
+    }
+    if (running.fetch_sub(1) == 1) {
+        pool.loop().stop();
+    }
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 5) {
+        std::cerr << "用法: " << argv[0]
+                  << " host user password db [循环线程数] [订单总数] [每循环并发数] [每循环连接数]\n";
+        return 1;
+    }
+    size_t loops = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 4;
+    uint64_t total = argc > 6 ? std::strtoull(argv[6], nullptr, 10) : 20000;
+    size_t concurrency = argc > 7 ? std::strtoul(argv[7], nullptr, 10) : 256;
+    size_t connections = argc > 8 ? std::strtoul(argv[8], nullptr, 10) : 32;
+
+    ConnectionPoolConfig config;
+    config.host = argv[1];
+    config.user = argv[2];
+    config.password = argv[3];
+    config.db = argv[4];
+    config.max_size = connections;
+
+    // 表结构用一条阻塞连接初始化
+    {
+        PooledConnection setup = PooledConnection::open(argv[1], argv[2], argv[3], argv[4]);
+        if (!setup.get() || !AlipaySchemaManager::getInstance().ensureSchema(setup.get())) {
+            std::cerr << "初始化表结构失败\n";
+            return 1;
+        }
+    }
+    AlipayIdGenerator::getInstance().setNodeId(1);
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < loops; ++t) {
+        threads.emplace_back([&] {
+            AlipayEventLoop loop;
+            AlipayAsyncConnectionPool pool(loop, config);
+            std::atomic<size_t> running{concurrency};
+            for (size_t i = 0; i < concurrency; ++i) {
+                loop.spawn(worker(pool, total, running));
+            }
+            loop.run();
+        });
+    }
+    for (auto& thread : threads) thread.join();
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    std::cout << "循环线程: " << loops << "，每循环并发: " << concurrency
+              << "，每循环连接: " << connections << "\n"
+              << "提交: " << g_committed.load() << "，失败: " << g_failed.load() << "\n"
+              << "吞吐: " << std::fixed << std::setprecision(0)
+              << g_committed.load() / seconds << " 单/秒\n";
+    return 0;
+}
@@ -0,0 +1,133 @@
+#include "alipay_codec.h"
+#include <iostream>
+#include <sstream>
+#include <iomanip>
+#include <string>
+#include <vector>
+#include <random>
+#include <chrono>
+#include <ctime>
+#include <cstdlib>
+
+// 金额/时间编解码压测：与旧的 stringstream/localtime/get_time/mktime 实现对比，并校验结果一致
+// 用法：codec_bench [迭代次数]
+
+namespace {
+
+// 旧实现
+std::string legacyAmountToString(uint64_t amount) {
+    std::stringstream ss;
+    ss << amount / 100 << "." << std::setw(2) << std::setfill('0') << amount % 100;
+    return ss.str();
+}
+
+uint64_t legacyStringToAmount(const std::string& amountStr) {
+    size_t dotPos = amountStr.find('.');
+    if (dotPos == std::string::npos) {
+        return std::stoull(amountStr) * 100;
+    }
+    std::string intPart = amountStr.substr(0, dotPos);
+    std::string decPart = amountStr.substr(dotPos + 1);
+    if (decPart.length() > 2) {
+        decPart = decPart.substr(0, 2);
+    } else while (decPart.length() < 2) {
+        decPart += "0";
+    }
+    return std::stoull(intPart) * 100 + std::stoull(decPart);
+}
+
+std::string legacyTimestampToString(uint64_t timestamp) {
+    time_t time = static_cast<time_t>(timestamp);
+    struct tm* timeinfo = localtime(&time);
+    char buffer[80];
+    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", timeinfo);
+    return std::string(buffer);
+}
+
+uint64_t legacyStringToTimestamp(const std::string& timeStr) {
+    struct tm tm = {};
+    std::istringstream ss(timeStr);
+    ss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
+    tm.tm_isdst = -1; // 原实现未设置，夏令时期间会差一小时
+    return static_cast<uint64_t>(mktime(&tm));
+}
+
+template <typename Function>
+void measure(const char* name, size_t iterations, Function function) {
+    auto start = std::chrono::steady_clock::now();
+    uint64_t sink = 0;
+    for (size_t i = 0; i < iterations; ++i) {
+        sink += function(i);
+    }
+    double ns = std::chrono::duration<double, std::nano>(
+        std::chrono::steady_clock::now() - start).count() / iterations;
+    std::cout << std::left << std::setw(28) << name << std::fixed << std::setprecision(1)
+              << ns << " ns/次 (" << sink % 10 << ")\n";
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    size_t iterations = argc > 1 ? std::strtoul(argv[1], nullptr, 10) : 1000000;
+
+    std::mt19937_64 gen(42);
+    std::vector<uint64_t> amounts(iterations);
+    std::vector<uint64_t> timestamps(iterations);
+    uint64_t now = static_cast<uint64_t>(time(nullptr));
+    for (size_t i = 0; i < iterations; ++i) {
+        amounts[i] = gen() % 100000000000ULL;
+        timestamps[i] = now - gen() % (20ULL * 365 * 86400);
+    }
+
+    std::vector<std::string> amountTexts(iterations);
+    std::vector<std::string> timeTexts(iterations);
+    for (size_t i = 0; i < iterations; ++i) {
+        amountTexts[i] = legacyAmountToString(amounts[i]);
+        timeTexts[i] = legacyTimestampToString(timestamps[i]);
+    }
+
+    // 1. 校验与旧实现一致
+    size_t mismatches = 0;
+    char buffer[kAmountBufferSize];
+    for (size_t i = 0; i < iterations; ++i) {
+        uint64_t amount = 0, timestamp = 0;
+        size_t n = formatAmount(buffer, sizeof(buffer), amounts[i]);
+        if (std::string(buffer, n) != amountTexts[i]) ++mismatches;
+        if (!parseAmount(amountTexts[i], amount) || amount != amounts[i]) ++mismatches;
+        n = formatTimestamp(buffer, sizeof(buffer), timestamps[i]);
+        if (std::string(buffer, n) != timeTexts[i]) ++mismatches;
+        // 夏令时结束时的重复时刻 mktime 结果不确定，解析结果以往返一致校验
+        if (!parseTimestamp(timeTexts[i], timestamp)) {
+            ++mismatches;
+            continue;
+        }
+        n = formatTimestamp(buffer, sizeof(buffer), timestamp);
+        if (std::string(buffer, n) != timeTexts[i]) ++mismatches;
+    }
+    std::cout << "与旧实现不一致: " << mismatches << " 处\n\n";
+
+    // 2. 性能对比
+    measure("legacy amountToString", iterations,
+            [&](size_t i) { return legacyAmountToString(amounts[i]).size(); });
+    measure("formatAmount", iterations,
+            [&](size_t i) { return formatAmount(buffer, sizeof(buffer), amounts[i]); });
+    measure("legacy stringToAmount", iterations,
+            [&](size_t i) { return legacyStringToAmount(amountTexts[i]); });
+    measure("parseAmount", iterations, [&](size_t i) {
+        uint64_t amount = 0;
+        parseAmount(amountTexts[i], amount);
+        return amount;
+    });
+    measure("legacy timestampToString", iterations,
+            [&](size_t i) { return legacyTimestampToString(timestamps[i]).size(); });
+    measure("formatTimestamp", iterations,
+            [&](size_t i) { return formatTimestamp(buffer, sizeof(buffer), timestamps[i]); });
+    measure("legacy stringToTimestamp", iterations,
+            [&](size_t i) { return legacyStringToTimestamp(timeTexts[i]); });
+    measure("parseTimestamp", iterations, [&](size_t i) {
+        uint64_t timestamp = 0;
+        parseTimestamp(timeTexts[i], timestamp);
+        return timestamp;
+    });
+    return 0;
+}
@@ -3,8 +3,13 @@
 #include "alipay_merchant.h"
 #include "alipay_settlement.h"
 #include "alipay_transaction_manager.h"
+#include "alipay_connection_pool.h"
+#include "alipay_order_expiry.h"
+#include "alipay_id_generator.h"
+#include "alipay_outbox.h"
 #include <iostream>
 #include <iomanip>
+#include <cstring>
 
 // 辅助函数：格式化金额显示
 std::string formatAmount(uint64_t amount) {
@@ -13,25 +18,50 @@ std::string formatAmount(uint64_t amount) {
     return ss.str();
 }
 
-int main() {
+// 用法：main [--xa]，默认以本地事务 + 事件表创建订单，--xa 时经事务管理器走 XA
+int main(int argc, char* argv[]) {
+    bool useXa = argc > 1 && std::strcmp(argv[1], "--xa") == 0;
     try {
-        // 1. 初始化各个组件
+        // 0. 设置本实例的 ID 节点号（集群内每个进程不同）
+        AlipayIdGenerator::getInstance().setNodeId(1);
+        
+        // 1. 初始化连接池（须先于事务管理器）
+        ConnectionPoolConfig poolConfig;
+        poolConfig.host = "localhost";
+        poolConfig.user = "username";
+        poolConfig.password = "password";
+        poolConfig.db = "alipay_db";
+        
+        auto& pool = AlipayConnectionPool::getInstance();
+        if (!pool.init(poolConfig)) {
+            throw std::runtime_error("连接池初始化失败");
+        }
+        
+        // 启动事件投递（示例中只打印事件，实际应投递到消息队列）
+        AlipayOutboxRelay::getInstance().start(pool, [](const std::vector<OutboxEvent>& events) {
+            for (const auto& event : events) {
+                std::cout << "[事件 " << event.id << "] " << event.event_type
+                          << " " << event.payload << "\n";
+            }
+            return true;
+        });
+        
+        // 启动订单超时关闭引擎（从库中重建待支付订单的定时器）
+        if (!AlipayOrderExpiryEngine::getInstance().start(pool)) {
+            throw std::runtime_error("订单超时关闭引擎启动失败");
+        }
+        
+        // 2. 初始化各个组件，从连接池借用连接
         AlipayMerchant merchant;
         AlipayOrder order;
         AlipayPayment payment;
         AlipaySettlement settlement;
         auto& txManager = AlipayTransactionManager::getInstance();
         
-        // 2. 连接数据库
-        const char* host = "localhost";
-        const char* user = "username";
-        const char* password = "password";
-        const char* db = "alipay_db";
-        
-        if (!merchant.connectDB(host, user, password, db) ||
-            !order.connectDB(host, user, password, db) ||
-            !payment.connectDB(host, user, password, db) ||
-            !settlement.connectDB(host, user, password, db)) {
+        if (!merchant.connectDB(pool) ||
+            !order.connectDB(pool) ||
+            !payment.connectDB(pool) ||
+            !settlement.connectDB(pool)) {
             throw std::runtime_error("数据库连接失败");
         }
         
@@ -61,7 +91,7 @@ int main() {
         }
         
         // 4. 创建订单
-        std::string orderNo = "TEST_ORDER_" + std::to_string(time(nullptr));
+        std::string orderNo = AlipayIdGenerator::getInstance().nextString("TEST_ORDER");
         order.setOutTradeNo(orderNo);
         order.setMerchantId(merchant.getMerchantId());
         order.setTotalAmount(9999);  // 99.99元
@@ -74,32 +104,40 @@ int main() {
             std::chrono::system_clock::now());
         order.setTimeExpire(now + 1800);
         
-        // 5. 开始分布式事务
-        std::shared_ptr<AlipayTransaction> transaction;
-        if (!txManager.startTransaction(orderNo, transaction)) {
-            throw std::runtime_error("事务启动失败");
-        }
-        
-        // 6. 创建订单和支付记录
-        if (!order.createOrder(*transaction)) {
-            transaction->rollbackTransaction();
-            throw std::runtime_error("订单创建失败");
-        }
-        
-        if (!payment.createPayment(orderNo, *transaction)) {
-            transaction->rollbackTransaction();
-            throw std::runtime_error("支付记录创建失败");
-        }
-        
-        // 7. 提交事务
-        if (!txManager.prepareTransaction(transaction->getXID())) {
-            transaction->rollbackTransaction();
-            throw std::runtime_error("事务准备失败");
-        }
-        
-        if (!txManager.commitTransaction(transaction->getXID())) {
-            transaction->rollbackTransaction();
-            throw std::runtime_error("事务提交失败");
+        if (useXa) {
+            // 5. 开始分布式事务
+            std::shared_ptr<AlipayTransaction> transaction;
+            if (!txManager.startTransaction(orderNo, transaction)) {
+                throw std::runtime_error("事务启动失败");
+            }
+            
+            // 6. 创建订单和支付记录
+            const std::string xid = transaction->getXID();
+            if (!order.createOrder(*transaction)) {
+                txManager.rollbackTransaction(xid);
+                throw std::runtime_error("订单创建失败");
+            }
+            
+            if (!payment.createPayment(orderNo, *transaction)) {
+                txManager.rollbackTransaction(xid);
+                throw std::runtime_error("支付记录创建失败");
+            }
+            
+            // 7. 提交事务（单一资源管理器时走一阶段提交）
+            if (!txManager.prepareTransaction(xid)) {
+                txManager.rollbackTransaction(xid);
+                throw std::runtime_error("事务准备失败");
+            }
+            
+            if (!txManager.commitTransaction(xid)) {
+                txManager.rollbackTransaction(xid);
+                throw std::runtime_error("事务提交失败");
+            }
+        } else {
+            // 5-7. 订单、支付记录和订单创建事件在一个本地事务中写入
+            if (!order.createOrderWithPayment()) {
+                throw std::runtime_error("订单创建失败");
+            }
         }
         
         std::cout << "订单创建成功！\n" 
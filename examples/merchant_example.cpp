@@ -1,5 +1,6 @@
 #include "alipay_merchant.h"
 #include "alipay_merchant_factory.h"
+#include "alipay_fee_engine.h"
 #include <iostream>
 #include <iomanip>
 
@@ -118,15 +119,18 @@ int main() {
             std::cout << "子商户(" << subMerchant.getMerchantId() 
                       << ")的父商户: " << parentId << std::endl;
             
-            // 计算实际费率分成
-            double subFeeRate = subMerchant.getFeeRate();
-            double isvFeeRate = isvMerchant.getFeeRate();
-            double profitShare = subFeeRate - isvFeeRate;
+            // 计算实际费率分成（以一笔 1000.00 元交易为例）
+            uint32_t subFeeRate = subMerchant.getFeeRateBps();
+            uint32_t isvFeeRate = isvMerchant.getFeeRateBps();
+            FeeProfitShare share = AlipayFeeEngine(FeeRounding::HALF_UP)
+                .profitShare(100000, subFeeRate, isvFeeRate);
             
             std::cout << "子商户费率: " << std::fixed << std::setprecision(2) 
-                      << subFeeRate * 100 << "%" << std::endl;
-            std::cout << "服务商费率: " << isvFeeRate * 100 << "%" << std::endl;
-            std::cout << "服务商分润: " << profitShare * 100 << "%" << std::endl;
+                      << subFeeRate / 100.0 << "%" << std::endl;
+            std::cout << "服务商费率: " << isvFeeRate / 100.0 << "%" << std::endl;
+            std::cout << "手续费: " << share.total_fee << " 分，其中平台 "
+                      << share.platform_fee << " 分，服务商分润 "
+                      << share.isv_profit << " 分" << std::endl;
         }
         
         // 5. 测试商户状态变更
@@ -0,0 +1,142 @@
+#include "alipay_payment_notify.h"
+#include "alipay_payment.h"
+#include "alipay_id_generator.h"
+#include "alipay_schema_manager.h"
+#include "alipay_sql_builder.h"
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <future>
+#include <random>
+#include <mutex>
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+
+// 支付通知写入压测：先建 M 个待支付记录，再由 T 个线程模拟突发通知（每单 TRADE_SUCCESS、
+// TRADE_FINISHED 各一条，并带重复和乱序），对比逐条 updatePaymentStatus 与合并写入的耗时和语句数
+// 用法：payment_notify_bench host user password db [订单数] [线程数] [每单重复次数]
+
+namespace {
+
+std::vector<PaymentNotification> makeNotifications(const std::vector<std::string>& orders,
+                                                   size_t duplicates) {
+    std::vector<PaymentNotification> notifications;
+    for (const auto& outTradeNo : orders) {
+        for (size_t d = 0; d < duplicates; ++d) {
+            notifications.push_back({outTradeNo, "T" + outTradeNo,
+                                     AlipayPayment::TRADE_STATUS_TRADE_SUCCESS});
+            notifications.push_back({outTradeNo, "T" + outTradeNo,
+                                     AlipayPayment::TRADE_STATUS_TRADE_FINISHED});
+        }
+    }
+    std::mt19937 gen(42);
+    std::shuffle(notifications.begin(), notifications.end(), gen);
+    return notifications;
+}
+
+bool resetPayments(MYSQL* conn, const std::vector<std::string>& orders) {
+    AlipayMultiRowInsert insert(conn, "INSERT INTO alipay_payments ("
+        "out_trade_no, trade_status, update_time) VALUES ",
+        " ON DUPLICATE KEY UPDATE trade_no = NULL, trade_status = VALUES(trade_status), pay_time = NULL");
+    for (const auto& outTradeNo : orders) {
+        insert.addRow().str(outTradeNo).str(AlipayPayment::TRADE_STATUS_WAIT_BUYER_PAY).u64(0);
+    }
+    return insert.flush();
+}
+
+template <typename Submit>
+double runThreads(const std::vector<PaymentNotification>& notifications, size_t threads,
+                  Submit submit) {
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t] {
+            for (size_t i = t; i < notifications.size(); i += threads) {
+                submit(notifications[i]);
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 5) {
+        std::cerr << "用法: " << argv[0] << " host user password db [订单数] [线程数] [每单重复次数]\n";
+        return 1;
+    }
+    size_t orderCount = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 5000;
+    size_t threads = argc > 6 ? std::strtoul(argv[6], nullptr, 10) : 16;
+    size_t duplicates = argc > 7 ? std::strtoul(argv[7], nullptr, 10) : 2;
+
+    ConnectionPoolConfig config;
+    config.host = argv[1];
+    config.user = argv[2];
+    config.password = argv[3];
+    config.db = argv[4];
+    config.max_size = threads + 4;
+    config.min_idle = threads;
+
+    auto& pool = AlipayConnectionPool::getInstance();
+    if (!pool.init(config)) {
+        std::cerr << "连接池初始化失败\n";
+        return 1;
+    }
+    AlipayIdGenerator::getInstance().setNodeId(1);
+
+    std::vector<std::string> orders;
+    for (size_t i = 0; i < orderCount; ++i) {
+        orders.push_back(AlipayIdGenerator::getInstance().nextString("NOTIFY"));
+    }
+    auto notifications = makeNotifications(orders, duplicates);
+
+    {
+        auto lease = pool.acquire();
+        if (!lease || !AlipaySchemaManager::getInstance().ensureSchema(lease.get()) ||
+            !resetPayments(lease.get(), orders)) {
+            std::cerr << "初始化支付记录失败\n";
+            return 1;
+        }
+    }
+
+    // 逐条 UPDATE
+    double direct = runThreads(notifications, threads, [&](const PaymentNotification& n) {
+        AlipayPayment payment;
+        if (payment.connectDB(pool)) {
+            payment.updatePaymentStatus(n.out_trade_no, n.trade_no, n.trade_status);
+        }
+    });
+
+    {
+        auto lease = pool.acquire();
+        resetPayments(lease.get(), orders);
+    }
+
+    // 合并写入：等待每条通知的确认
+    auto& pipeline = AlipayPaymentNotifyPipeline::getInstance();
+    pipeline.start(pool);
+    size_t failed = 0;
+    std::mutex failedMutex;
+    double merged = runThreads(notifications, threads, [&](const PaymentNotification& n) {
+        if (!pipeline.submit(n).get()) {
+            std::lock_guard<std::mutex> lock(failedMutex);
+            ++failed;
+        }
+    });
+    pipeline.stop();
+    PaymentNotifyStats stats = pipeline.stats();
+
+    std::cout << "通知数: " << notifications.size() << "，线程: " << threads << "\n"
+              << std::fixed << std::setprecision(0)
+              << "逐条更新: " << notifications.size() / direct << " 条/秒，UPDATE "
+              << notifications.size() << " 条\n"
+              << "合并写入: " << notifications.size() / merged << " 条/秒，UPDATE "
+              << stats.statements << " 条，合并掉 " << stats.coalesced << " 条，失败 " << failed << "\n";
+
+    pool.shutdown();
+    return 0;
+}
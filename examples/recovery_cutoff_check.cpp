@@ -0,0 +1,59 @@
+#include "alipay_id_generator.h"
+#include <iostream>
+#include <string>
+#include <thread>
+#include <chrono>
+
+// 事务恢复截止判断的检查：定长 XID、升级前的 "TXN_<毫秒>_<随机数>" 格式以及其他格式
+// 用法：recovery_cutoff_check，全部通过时返回 0
+
+namespace {
+
+int failures = 0;
+
+void expect(const std::string& name, bool actual, bool expected) {
+    if (actual != expected) {
+        std::cout << "FAIL " << name << ": 期望 " << expected << "，实际 " << actual << "\n";
+        ++failures;
+    }
+}
+
+uint64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+} // namespace
+
+int main() {
+    auto& generator = AlipayIdGenerator::getInstance();
+
+    std::string before = generator.nextString("TXN");
+    std::string cutoff = generator.nextString("TXN");
+    std::string after = generator.nextString("TXN");
+
+    expect("定长 XID 早于截止", AlipayIdGenerator::generatedBefore(before, cutoff), true);
+    expect("截止 XID 自身", AlipayIdGenerator::generatedBefore(cutoff, cutoff), false);
+    expect("定长 XID 晚于截止", AlipayIdGenerator::generatedBefore(after, cutoff), false);
+
+    // 旧格式的毫秒数是 13 位，字典序大于当前的定长 XID，必须按时间戳判断
+    uint64_t cutoffMs = nowMs();
+    std::this_thread::sleep_for(std::chrono::milliseconds(2));
+    cutoff = generator.nextString("TXN");
+    std::string legacyOld = "TXN_" + std::to_string(cutoffMs - 60000) + "_1234";
+    std::string legacyNew = "TXN_" + std::to_string(nowMs() + 60000) + "_5678";
+    expect("旧格式字典序大于截止", legacyOld > cutoff, true);
+    expect("旧格式早于截止", AlipayIdGenerator::generatedBefore(legacyOld, cutoff), true);
+    expect("旧格式晚于截止", AlipayIdGenerator::generatedBefore(legacyNew, cutoff), false);
+
+    // 前缀不同、格式不符的 XID 不由恢复裁决
+    expect("前缀不同", AlipayIdGenerator::generatedBefore(
+        "ORD_" + std::to_string(cutoffMs - 60000) + "_1234", cutoff), false);
+    expect("调用方自定义 XID", AlipayIdGenerator::generatedBefore("TXN_custom", cutoff), false);
+    expect("旧格式缺随机数", AlipayIdGenerator::generatedBefore(
+        "TXN_" + std::to_string(cutoffMs - 60000) + "_", cutoff), false);
+    expect("截止 XID 格式错误", AlipayIdGenerator::generatedBefore(before, "TXN_1"), false);
+
+    std::cout << (failures == 0 ? "全部通过" : "存在失败") << "\n";
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,140 @@
+#include "alipay_transaction_manager.h"
+#include "alipay_connection_pool.h"
+#include "alipay_id_generator.h"
+#include <iostream>
+#include <iomanip>
+#include <thread>
+#include <vector>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+
+// 事务管理器竞争压测：1..N 个线程并发执行 start -> XA PREPARE -> prepare -> XA COMMIT -> commit，
+// 输出各线程数下的提交吞吐。加 --serialized 时每次调用管理器都持有同一把全局锁，
+// 复现拆分前"整个管理器一把锁、锁内做网络 I/O"的行为作对照。
+// 加 --participants=N 时再注册 N 个资源管理器（各自一个连接池，指向同一个库），走多分支并发两阶段提交
+// 用法：transaction_manager_bench host user password db [最大线程数] [每线程事务数] [--serialized] [--participants=N]
+
+namespace {
+
+std::mutex g_serialized; // 仅 --serialized 模式使用
+
+struct BenchResult {
+    double seconds = 0;
+    uint64_t committed = 0;
+    uint64_t failed = 0;
+};
+
+BenchResult runThreads(size_t threads, size_t perThread, bool serialized) {
+    auto& manager = AlipayTransactionManager::getInstance();
+    std::atomic<uint64_t> committed{0};
+    std::atomic<uint64_t> failed{0};
+
+    auto call = [serialized](auto&& operation) {
+        if (!serialized) return operation();
+        std::lock_guard<std::mutex> lock(g_serialized);
+        return operation();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < threads; ++t) {
+        workers.emplace_back([&] {
+            for (size_t i = 0; i < perThread; ++i) {
+                std::shared_ptr<AlipayTransaction> transaction;
+                std::string orderNo = AlipayIdGenerator::getInstance().nextString("BENCH");
+
+                bool ok = call([&] { return manager.startTransaction(orderNo, transaction); });
+                if (ok) {
+                    const std::string xid = transaction->getXID();
+                    ok = call([&] { return manager.prepareTransaction(xid); }) &&
+                         call([&] { return manager.commitTransaction(xid); });
+                    if (!ok) call([&] { return manager.rollbackTransaction(xid); });
+                }
+                (ok ? committed : failed).fetch_add(1, std::memory_order_relaxed);
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+
+    BenchResult result;
+    result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    result.committed = committed.load();
+    result.failed = failed.load();
+    return result;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    if (argc < 5) {
+        std::cerr << "用法: " << argv[0]
+                  << " host user password db [最大线程数] [每线程事务数] [--serialized] [--participants=N]\n";
+        return 1;
+    }
+    size_t maxThreads = argc > 5 ? std::strtoul(argv[5], nullptr, 10) : 16;
+    size_t perThread = argc > 6 ? std::strtoul(argv[6], nullptr, 10) : 200;
+    bool serialized = false;
+    size_t participants = 0;
+    for (int i = 7; i < argc; ++i) {
+        if (std::strcmp(argv[i], "--serialized") == 0) serialized = true;
+        if (std::strncmp(argv[i], "--participants=", 15) == 0) {
+            participants = std::strtoul(argv[i] + 15, nullptr, 10);
+        }
+    }
+
+    // 每个事务同时占用 XA 分支和事务日志两条连接
+    ConnectionPoolConfig config;
+    config.host = argv[1];
+    config.user = argv[2];
+    config.password = argv[3];
+    config.db = argv[4];
+    config.max_size = maxThreads * 2 + 4;
+    config.min_idle = maxThreads * 2;
+
+    auto& pool = AlipayConnectionPool::getInstance();
+    if (!pool.init(config)) {
+        std::cerr << "连接池初始化失败\n";
+        return 1;
+    }
+    AlipayIdGenerator::getInstance().setNodeId(1);
+
+    // 额外的资源管理器：每个事务在每个池上各占一条连接
+    std::vector<std::unique_ptr<AlipayConnectionPool>> participantPools;
+    for (size_t i = 0; i < participants; ++i) {
+        ConnectionPoolConfig participantConfig = config;
+        participantConfig.max_size = maxThreads + 2;
+        participantConfig.min_idle = maxThreads;
+        auto participantPool = std::make_unique<AlipayConnectionPool>();
+        if (!participantPool->init(participantConfig) ||
+            !AlipayTransactionManager::getInstance().addParticipant(
+                "rm" + std::to_string(i + 1), *participantPool)) {
+            std::cerr << "资源管理器 " << i + 1 << " 初始化失败\n";
+            return 1;
+        }
+        participantPools.push_back(std::move(participantPool));
+    }
+
+    std::cout << (serialized ? "模式: 全局锁（对照）\n" : "模式: 分片锁\n")
+              << "资源管理器: " << participants + 1 << "\n";
+    std::cout << std::left << std::setw(8) << "线程" << std::setw(14) << "提交/秒"
+              << std::setw(10) << "加速比" << "失败\n";
+
+    double baseline = 0;
+    for (size_t threads = 1; threads <= maxThreads; threads *= 2) {
+        BenchResult result = runThreads(threads, perThread, serialized);
+        double throughput = result.committed / result.seconds;
+        if (threads == 1) baseline = throughput;
+
+        std::cout << std::left << std::setw(8) << threads << std::setw(14) << std::fixed
+                  << std::setprecision(0) << throughput << std::setw(10) << std::setprecision(2)
+                  << (baseline > 0 ? throughput / baseline : 0) << result.failed << "\n";
+    }
+
+    for (auto& participantPool : participantPools) participantPool->shutdown();
+    pool.shutdown();
+    return 0;
+}
@@ -0,0 +1,265 @@
+#include "alipay_transaction_wal.h"
+#include <iostream>
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <thread>
+#include <random>
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <csignal>
+
+// WAL 崩溃点测试：子进程并发写入事务状态，在指定崩溃点第 N 次到达时直接 _exit（不做任何清理），
+// 父进程随后重放 WAL，校验所有已确认（append 返回成功）的状态都没有丢失且未倒退，
+// 并可在最新段末尾追加随机字节模拟写了一半的记录。
+// 写入失败场景用 RLIMIT_FSIZE 限制子进程的文件大小，使写入中途失败（模拟磁盘写满），
+// 失败后子进程继续写入，校验截断与切段失败后 WAL 仍可重放。
+// 用法：transaction_wal_crash_harness [工作目录，默认 /tmp]
+
+namespace {
+
+const char* kCrashPoints[] = {
+    "mid_write", "before_sync", "after_sync",
+    "segment_created", "snapshot_written", "before_compact",
+};
+const int kHits[] = {1, 3, 10, 40};
+const rlim_t kFileSizeLimits[] = {1500, 3000};
+const size_t kThreads = 4;
+const size_t kTransactionsPerThread = 150;
+
+int rank(TransactionStatus status) {
+    return AlipayTransactionWal::isTerminal(status) ? 3 : static_cast<int>(status);
+}
+
+// 事务 i 是否会走到提交（其余停在 PREPARED，模拟待恢复的事务）
+bool commits(size_t index) {
+    return index % 3 != 0;
+}
+
+TransactionWalOptions harnessOptions(const std::string& directory) {
+    TransactionWalOptions options;
+    options.directory = directory;
+    options.segment_bytes = 4096;   // 频繁切换段以覆盖压缩路径
+    options.max_batch = 16;
+    options.max_wait_us = 200;
+    return options;
+}
+
+// 子进程：写入并把每条已确认的状态写回管道；fileLimit 非 0 时限制文件大小，追加失败的事务就此放弃
+void runChild(const std::string& directory, const char* point, int hit, rlim_t fileLimit,
+              int ackFd) {
+    if (fileLimit > 0) {
+        signal(SIGXFSZ, SIG_IGN);
+        rlimit limit{fileLimit, fileLimit};
+        if (setrlimit(RLIMIT_FSIZE, &limit) != 0) _exit(5);
+    }
+
+    std::atomic<int> hits{0};
+    TransactionWalOptions options = harnessOptions(directory);
+    options.crash_hook = [point, hit, &hits](const char* reached) {
+        if (strcmp(reached, point) == 0 && ++hits == hit) _exit(0);
+    };
+
+    AlipayTransactionWal wal(options);
+    std::string error;
+    if (!wal.open(error)) {
+        std::cerr << "子进程打开 WAL 失败: " << error << "\n";
+        _exit(2);
+    }
+
+    std::vector<std::thread> workers;
+    for (size_t t = 0; t < kThreads; ++t) {
+        workers.emplace_back([&, t] {
+            for (size_t i = 0; i < kTransactionsPerThread; ++i) {
+                TransactionRecord record{"T" + std::to_string(t) + "_" + std::to_string(i),
+                                         TransactionStatus::STARTED, 1, 1, "ORDER", {"orders"}};
+                std::vector<TransactionStatus> steps = {TransactionStatus::STARTED,
+                                                        TransactionStatus::PREPARED};
+                if (commits(i)) steps.push_back(TransactionStatus::COMMITTED);
+
+                for (TransactionStatus status : steps) {
+                    record.status = status;
+                    if (!wal.append(record)) {
+                        if (fileLimit == 0) _exit(3);
+                        break;
+                    }
+                    std::string ack = record.xid + " " + std::to_string(static_cast<int>(status)) + "\n";
+                    if (write(ackFd, ack.data(), ack.size()) < 0) _exit(4);
+                }
+            }
+        });
+    }
+    for (auto& worker : workers) worker.join();
+    _exit(0);
+}
+
+std::string newestSegment(const std::string& directory) {
+    std::string newest;
+    DIR* dir = opendir(directory.c_str());
+    while (dirent* entry = dir ? readdir(dir) : nullptr) {
+        std::string name = entry->d_name;
+        if (name.rfind("wal-", 0) == 0 && name > newest) newest = name;
+    }
+    if (dir) closedir(dir);
+    return newest.empty() ? "" : directory + "/" + newest;
+}
+
+size_t segmentCount(const std::string& directory) {
+    size_t count = 0;
+    DIR* dir = opendir(directory.c_str());
+    while (dirent* entry = dir ? readdir(dir) : nullptr) {
+        if (strncmp(entry->d_name, "wal-", 4) == 0) ++count;
+    }
+    if (dir) closedir(dir);
+    return count;
+}
+
+void removeDirectory(const std::string& directory) {
+    DIR* dir = opendir(directory.c_str());
+    while (dirent* entry = dir ? readdir(dir) : nullptr) {
+        if (entry->d_name[0] != '.') unlink((directory + "/" + entry->d_name).c_str());
+    }
+    if (dir) closedir(dir);
+    rmdir(directory.c_str());
+}
+
+// 返回发现的问题数
+size_t runCase(const std::string& base, const char* point, int hit, bool garbage,
+               rlim_t fileLimit, std::mt19937& gen) {
+    std::string pattern = base + "/wal_crash_XXXXXX";
+    std::vector<char> buffer(pattern.begin(), pattern.end());
+    buffer.push_back('\0');
+    if (!mkdtemp(buffer.data())) {
+        std::cerr << "创建临时目录失败\n";
+        return 1;
+    }
+    std::string directory = buffer.data();
+
+    int fds[2];
+    if (pipe(fds) != 0) return 1;
+    pid_t pid = fork();
+    if (pid == 0) {
+        close(fds[0]);
+        runChild(directory, point, hit, fileLimit, fds[1]);
+    }
+    close(fds[1]);
+
+    // 先读完确认再等待子进程，避免管道写满
+    std::unordered_map<std::string, int> acked;
+    std::string pending;
+    char chunk[4096];
+    ssize_t n;
+    while ((n = read(fds[0], chunk, sizeof(chunk))) > 0) {
+        pending.append(chunk, static_cast<size_t>(n));
+        size_t pos;
+        while ((pos = pending.find('\n')) != std::string::npos) {
+            std::string line = pending.substr(0, pos);
+            pending.erase(0, pos + 1);
+            size_t space = line.find(' ');
+            int status = std::atoi(line.c_str() + space + 1);
+            int& best = acked[line.substr(0, space)];
+            best = std::max(best, rank(static_cast<TransactionStatus>(status)));
+        }
+    }
+    close(fds[0]);
+    int childStatus = 0;
+    waitpid(pid, &childStatus, 0);
+    if (!WIFEXITED(childStatus) || WEXITSTATUS(childStatus) != 0) {
+        std::cerr << point << "#" << hit << ": 子进程异常退出\n";
+        removeDirectory(directory);
+        return 1;
+    }
+
+    // 模拟最后一批写了一半
+    if (garbage) {
+        std::string segment = newestSegment(directory);
+        int fd = segment.empty() ? -1 : open(segment.c_str(), O_WRONLY | O_APPEND);
+        if (fd >= 0) {
+            std::string junk(1 + gen() % 64, '\0');
+            for (auto& c : junk) c = static_cast<char>(gen());
+            if (write(fd, junk.data(), junk.size()) < 0) {}
+            close(fd);
+        }
+    }
+
+    size_t problems = 0;
+    std::unordered_map<std::string, int> recovered;
+    for (int attempt = 0; attempt < 2; ++attempt) {
+        AlipayTransactionWal wal(harnessOptions(directory));
+        std::string error;
+        if (!wal.open(error)) {
+            std::cerr << point << "#" << hit << ": 重放失败: " << error << "\n";
+            removeDirectory(directory);
+            return problems + 1;
+        }
+
+        std::unordered_map<std::string, int> live;
+        for (const auto& record : wal.liveTransactions()) {
+            live[record.xid] = rank(record.status);
+        }
+        // 再次打开结果应一致（重放幂等），且旧段已被压缩掉
+        if (attempt == 1 && live != recovered) {
+            std::cerr << point << "#" << hit << ": 二次重放结果不一致\n";
+            ++problems;
+        }
+        recovered = std::move(live);
+        wal.close();
+        if (segmentCount(directory) != 1) {
+            std::cerr << point << "#" << hit << ": 压缩后仍有 " << segmentCount(directory) << " 个段\n";
+            ++problems;
+        }
+    }
+
+    for (const auto& [xid, status] : acked) {
+        auto it = recovered.find(xid);
+        size_t index = std::strtoul(xid.c_str() + xid.find('_') + 1, nullptr, 10);
+        if (status == 3) {
+            if (it != recovered.end()) ++problems;  // 已确认提交却仍未结束
+        } else if (it == recovered.end()) {
+            if (!commits(index)) ++problems;        // 不会提交的事务丢失
+        } else if (it->second < status) {
+            ++problems;                             // 状态倒退
+        }
+    }
+    if (problems > 0) {
+        std::cerr << point << "#" << hit << (garbage ? " +garbage" : "")
+                  << (fileLimit > 0 ? " +fsize=" + std::to_string(fileLimit) : "") << ": "
+                  << problems << " 个问题\n";
+    }
+    removeDirectory(directory);
+    return problems;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    std::string base = argc > 1 ? argv[1] : "/tmp";
+    std::mt19937 gen(7);
+
+    size_t cases = 0;
+    size_t problems = 0;
+    for (const char* point : kCrashPoints) {
+        for (int hit : kHits) {
+            for (bool garbage : {false, true}) {
+                problems += runCase(base, point, hit, garbage, 0, gen);
+                ++cases;
+            }
+        }
+    }
+    // 写入失败：单独运行，以及失败后在切段途中崩溃
+    for (rlim_t limit : kFileSizeLimits) {
+        problems += runCase(base, "none", 0, false, limit, gen);
+        problems += runCase(base, "segment_created", 2, false, limit, gen);
+        problems += runCase(base, "snapshot_written", 2, false, limit, gen);
+        cases += 3;
+    }
+    std::cout << cases << " 个崩溃场景，发现问题 " << problems << " 个\n";
+    return problems == 0 ? 0 : 1;
+}
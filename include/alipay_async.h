@@ -0,0 +1,270 @@
+#pragma once
+
+#include <coroutine>
+#include <exception>
+#include <optional>
+#include <utility>
+#include <string>
+#include <vector>
+#include <deque>
+#include <map>
+#include <memory>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <atomic>
+#include <cstdint>
+#include <mysql/mysql.h>
+#include "alipay_connection_pool.h"
+
+struct epoll_event;
+
+// 基于 C++20 协程和 MariaDB 客户端非阻塞接口（mysql_*_start / mysql_*_cont）的异步数据库访问：
+// 每个事件循环线程用 epoll 等待成百上千条连接的套接字，协程在等待 MySQL 时挂起而不占用线程。
+// 需要 MariaDB Connector/C（或带非阻塞接口的 libmariadb）
+
+namespace alipay_async_detail {
+
+// 协程结束时恢复等待者（对称转移，不增加调用栈深度）
+struct FinalAwaiter {
+    bool await_ready() const noexcept { return false; }
+    template <typename Promise>
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<Promise> handle) noexcept {
+        auto continuation = handle.promise().continuation;
+        return continuation ? continuation : std::noop_coroutine();
+    }
+    void await_resume() const noexcept {}
+};
+
+struct PromiseBase {
+    std::coroutine_handle<> continuation;
+    std::exception_ptr error;
+
+    std::suspend_always initial_suspend() noexcept { return {}; }
+    FinalAwaiter final_suspend() noexcept { return {}; }
+    void unhandled_exception() { error = std::current_exception(); }
+};
+
+} // namespace alipay_async_detail
+
+// 惰性启动的协程任务：被 co_await 时才开始执行，完成后恢复等待者；
+// 未被等待就析构时直接销毁协程帧
+template <typename T>
+class AsyncTask {
+public:
+    struct promise_type : alipay_async_detail::PromiseBase {
+        std::optional<T> value;
+
+        AsyncTask get_return_object() {
+            return AsyncTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        template <typename U>
+        void return_value(U&& result) { value.emplace(std::forward<U>(result)); }
+    };
+
+    AsyncTask(AsyncTask&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    AsyncTask& operator=(AsyncTask&& other) noexcept {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+    ~AsyncTask() { if (handle_) handle_.destroy(); }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle_.promise().continuation = awaiting;
+        return handle_;
+    }
+    T await_resume() {
+        auto& promise = handle_.promise();
+        if (promise.error) std::rethrow_exception(promise.error);
+        return std::move(*promise.value);
+    }
+
+private:
+    explicit AsyncTask(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+    std::coroutine_handle<promise_type> handle_;
+};
+
+template <>
+class AsyncTask<void> {
+public:
+    struct promise_type : alipay_async_detail::PromiseBase {
+        AsyncTask get_return_object() {
+            return AsyncTask(std::coroutine_handle<promise_type>::from_promise(*this));
+        }
+        void return_void() {}
+    };
+
+    AsyncTask(AsyncTask&& other) noexcept : handle_(std::exchange(other.handle_, {})) {}
+    AsyncTask& operator=(AsyncTask&& other) noexcept {
+        if (this != &other) {
+            if (handle_) handle_.destroy();
+            handle_ = std::exchange(other.handle_, {});
+        }
+        return *this;
+    }
+    ~AsyncTask() { if (handle_) handle_.destroy(); }
+
+    bool await_ready() const noexcept { return false; }
+    std::coroutine_handle<> await_suspend(std::coroutine_handle<> awaiting) noexcept {
+        handle_.promise().continuation = awaiting;
+        return handle_;
+    }
+    void await_resume() {
+        if (handle_.promise().error) std::rethrow_exception(handle_.promise().error);
+    }
+
+private:
+    explicit AsyncTask(std::coroutine_handle<promise_type> handle) : handle_(handle) {}
+    std::coroutine_handle<promise_type> handle_;
+};
+
+// 一条连接上正在进行的非阻塞调用
+struct AsyncMysqlWait {
+    MYSQL* conn = nullptr;
+    int status = 0;                         // MYSQL_WAIT_* 组合
+    std::function<int(int ready)> cont;     // 调用对应的 *_cont，返回新的 status
+    std::coroutine_handle<> waiter;         // 调用完成后恢复的协程
+    int fd = -1;                            // 已加入 epoll 的套接字
+    std::multimap<uint64_t, AsyncMysqlWait*>::iterator timer;
+    bool has_timer = false;
+};
+
+// 单线程事件循环：epoll 等待 MySQL 套接字与超时，恢复就绪的协程。
+// 一个循环只在调用 run() 的线程上执行协程；post/spawn/stop 可在任意线程调用
+class AlipayEventLoop {
+public:
+    AlipayEventLoop();
+    ~AlipayEventLoop();
+
+    AlipayEventLoop(const AlipayEventLoop&) = delete;
+    AlipayEventLoop& operator=(const AlipayEventLoop&) = delete;
+
+    // 在当前线程运行，直到 stop()
+    void run();
+    void stop();
+
+    // 在循环线程上恢复协程
+    void post(std::coroutine_handle<> handle);
+    // 在循环线程上启动任务，任务结束后自行销毁；任务抛出的异常被忽略
+    void spawn(AsyncTask<void> task);
+
+    // 供 AlipayAsyncConnection 使用：按 wait.status 等待套接字或超时，完成后恢复 wait.waiter
+    void arm(AsyncMysqlWait& wait);
+    // 连接关闭前从 epoll 中移除
+    void forget(AsyncMysqlWait& wait);
+
+private:
+    void dispatch(AsyncMysqlWait& wait, int ready);
+    void runPosted();
+
+    int epoll_fd_ = -1;
+    int event_fd_ = -1;                     // 跨线程唤醒
+
+    std::mutex mutex_;
+    std::vector<std::coroutine_handle<>> posted_;
+    std::atomic<bool> stopping_{false};
+
+    std::multimap<uint64_t, AsyncMysqlWait*> timers_; // 仅循环线程访问
+    epoll_event* batch_ = nullptr;          // 正在处理的 epoll_wait 结果，forget 时清掉其中的过期事件
+    int batch_size_ = 0;
+};
+
+// 非阻塞 MySQL 连接，只能在所属事件循环的线程上使用，同一时刻只能有一个调用在进行
+class AlipayAsyncConnection {
+public:
+    explicit AlipayAsyncConnection(AlipayEventLoop& loop);
+    ~AlipayAsyncConnection();
+
+    AlipayAsyncConnection(const AlipayAsyncConnection&) = delete;
+    AlipayAsyncConnection& operator=(const AlipayAsyncConnection&) = delete;
+
+    AsyncTask<bool> connect(const ConnectionPoolConfig& config);
+
+    // 执行不需要结果集的语句（有结果集时读完丢弃）
+    AsyncTask<bool> execute(std::string sql);
+    // 执行查询并取回完整结果集，调用方负责 mysql_free_result；失败返回 nullptr
+    AsyncTask<MYSQL_RES*> select(std::string sql);
+
+    MYSQL* get() const { return conn_; }   // 用于转义和读取错误信息，不可用于阻塞调用
+    AlipayEventLoop& loop() { return loop_; }
+    uint64_t affectedRows() const { return affected_rows_; }
+
+    // 连接出错或事务未结束时标记，归还连接池时直接关闭
+    void markBroken() { broken_ = true; }
+    bool broken() const { return broken_; }
+
+private:
+    class Call;
+    void checkError();
+
+    AlipayEventLoop& loop_;
+    MYSQL* conn_ = nullptr;
+    AsyncMysqlWait wait_;
+    uint64_t affected_rows_ = 0;
+    bool broken_ = false;
+};
+
+class AlipayAsyncConnectionPool;
+
+// 借出的异步连接（RAII），析构时归还连接池
+class AsyncConnectionLease {
+public:
+    AsyncConnectionLease() = default;
+    AsyncConnectionLease(AlipayAsyncConnectionPool* pool, std::unique_ptr<AlipayAsyncConnection> conn);
+    ~AsyncConnectionLease();
+
+    AsyncConnectionLease(AsyncConnectionLease&& other) noexcept;
+    AsyncConnectionLease& operator=(AsyncConnectionLease&& other) noexcept;
+    AsyncConnectionLease(const AsyncConnectionLease&) = delete;
+    AsyncConnectionLease& operator=(const AsyncConnectionLease&) = delete;
+
+    AlipayAsyncConnection* get() const { return conn_.get(); }
+    AlipayAsyncConnection* operator->() const { return conn_.get(); }
+    AlipayAsyncConnection& operator*() const { return *conn_; }
+    explicit operator bool() const { return conn_ != nullptr; }
+
+    void release();
+
+private:
+    AlipayAsyncConnectionPool* pool_ = nullptr;
+    std::unique_ptr<AlipayAsyncConnection> conn_;
+};
+
+// 单个事件循环上的异步连接池：按需建连，达到 max_size 后借连接的协程排队等待。
+// 只能在所属事件循环的线程上使用
+class AlipayAsyncConnectionPool {
+public:
+    AlipayAsyncConnectionPool(AlipayEventLoop& loop, const ConnectionPoolConfig& config);
+    ~AlipayAsyncConnectionPool();
+
+    AlipayAsyncConnectionPool(const AlipayAsyncConnectionPool&) = delete;
+    AlipayAsyncConnectionPool& operator=(const AlipayAsyncConnectionPool&) = delete;
+
+    // 借出一条连接，建连失败返回空句柄
+    AsyncTask<AsyncConnectionLease> acquire();
+
+    size_t totalConnections() const { return total_; }
+    size_t idleConnections() const { return idle_.size(); }
+    AlipayEventLoop& loop() { return loop_; }
+
+private:
+    friend class AsyncConnectionLease;
+
+    struct Waiter {
+        std::coroutine_handle<> handle;
+        std::unique_ptr<AlipayAsyncConnection>* slot; // 直接交给等待者的连接，空表示名额已释放需自行建连
+    };
+    class WaitForConnection;
+
+    void giveBack(std::unique_ptr<AlipayAsyncConnection> conn);
+
+    AlipayEventLoop& loop_;
+    ConnectionPoolConfig config_;
+    std::deque<std::unique_ptr<AlipayAsyncConnection>> idle_;
+    std::deque<Waiter> waiters_;
+    size_t total_ = 0;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <string>
+#include "alipay_async.h"
+
+// AlipayTransaction 的协程版本，作用于单个非阻塞连接上的 XA 分支：
+//     AlipayAsyncTransaction transaction(*lease);
+//     if (!co_await transaction.beginTransaction()) co_return false;
+//     ... co_await order.createOrderAsync(transaction) ...
+//     co_return co_await transaction.commitTransaction();
+// 只有一个资源管理器，提交走 XA COMMIT ... ONE PHASE；离开作用域时仍未结束的事务
+// 不能把连接还给别人，连接被标记为损坏并关闭，MySQL 随之回滚该分支
+class AlipayAsyncTransaction {
+public:
+    explicit AlipayAsyncTransaction(AlipayAsyncConnection& conn);
+    ~AlipayAsyncTransaction();
+
+    AlipayAsyncTransaction(const AlipayAsyncTransaction&) = delete;
+    AlipayAsyncTransaction& operator=(const AlipayAsyncTransaction&) = delete;
+
+    // xid 为空时自动生成
+    AsyncTask<bool> beginTransaction(std::string xid = "");
+    AsyncTask<bool> commitTransaction();
+    AsyncTask<bool> rollbackTransaction();
+
+    AlipayAsyncConnection& connection() { return conn_; }
+    const std::string& getXID() const { return current_xid_; }
+    bool active() const { return active_; }
+    // 提交时连接中断，服务端可能已提交，不能再回滚
+    bool outcomeUnknown() const { return outcome_unknown_; }
+
+private:
+    AlipayAsyncConnection& conn_;
+    std::string current_xid_;
+    bool active_ = false;   // 已 XA START，尚未提交或回滚
+    bool outcome_unknown_ = false;
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdint>
+#include <cstddef>
+
+// 金额与时间的编解码：基于 std::to_chars/from_chars，写入调用方缓冲，不分配内存，线程安全
+
+// 缓冲区大小（含余量）
+constexpr size_t kAmountBufferSize = 24;      // "18446744073709551615" 分转元后的最大长度
+constexpr size_t kTimestampBufferSize = 20;   // "YYYY-MM-DD HH:MM:SS"
+
+// 分转元，如 9999 -> "99.99"；返回写入长度，缓冲不足时返回 0
+size_t formatAmount(char* out, size_t capacity, uint64_t amount);
+
+// 元转分，小数超过两位时截断；格式错误或溢出返回 false
+bool parseAmount(std::string_view text, uint64_t& amount);
+
+// 秒级时间戳按本地时区格式化为 "YYYY-MM-DD HH:MM:SS"；返回写入长度，缓冲不足时返回 0
+size_t formatTimestamp(char* out, size_t capacity, uint64_t timestamp);
+
+// 解析本地时区的 "YYYY-MM-DD HH:MM:SS"；格式错误返回 false
+bool parseTimestamp(std::string_view text, uint64_t& timestamp);
+
+// 本地时区的 UTC 偏移（秒）
+// 首次使用时以 localtime_r 预计算前后数十年的偏移切换点，之后只做二分查找，
+// 表外的时间回退到 localtime_r/mktime；进程启动后修改 TZ 不生效
+class AlipayTimeZone {
+public:
+    static const AlipayTimeZone& local();
+
+    // utc 时刻对应的偏移
+    int64_t offsetAt(int64_t utc) const;
+
+    // 本地时间（按 UTC 计的秒数）转 UTC；夏令时结束造成的重复时刻取较早者
+    int64_t toUtc(int64_t localSeconds) const;
+
+private:
+    AlipayTimeZone();
+
+    struct Transition {
+        int64_t utc;        // 自该时刻起生效
+        int64_t offset;
+    };
+
+    static int64_t systemOffsetAt(int64_t utc);
+
+    int64_t range_begin_;
+    int64_t range_end_;
+    std::vector<Transition> transitions_; // 按 utc 升序，构造后只读
+};
+
+// 民用历日期与 1970-01-01 起天数的互转（前推格里高利历）
+int64_t daysFromCivil(int64_t year, unsigned month, unsigned day);
+void civilFromDays(int64_t days, int64_t& year, unsigned& month, unsigned& day);
@@ -0,0 +1,125 @@
+#pragma once
+
+#include <string>
+#include <deque>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <cstdint>
+#include <mysql/mysql.h>
+#include "alipay_statement_cache.h"
+
+// 连接池配置
+struct ConnectionPoolConfig {
+    std::string host = "localhost";
+    std::string user;
+    std::string password;
+    std::string db;
+    unsigned int port = 0;
+    std::string charset = "utf8mb4";
+
+    size_t max_size = 32;                 // 最大物理连接数
+    size_t min_idle = 4;                  // 空闲回收时至少保留的连接数
+    uint64_t idle_timeout_ms = 300000;    // 空闲超过该时长的连接被回收
+    uint64_t ping_interval_ms = 30000;    // 空闲超过该时长的连接借出前先 mysql_ping
+    uint64_t acquire_timeout_ms = 3000;   // 借连接的最长等待时间
+    unsigned int connect_timeout_s = 3;   // 建连超时
+};
+
+// 连接池中的一条物理连接，析构时先关闭语句再关闭连接
+struct PooledMysql {
+    PooledMysql() = default;
+    ~PooledMysql();
+    PooledMysql(const PooledMysql&) = delete;
+    PooledMysql& operator=(const PooledMysql&) = delete;
+
+    MYSQL* conn = nullptr;
+    uint64_t created_ms = 0;    // 建连时间
+    uint64_t last_used_ms = 0;  // 最近一次归还时间
+    AlipayStatementCache statements; // 该连接上已预处理的语句
+};
+
+class AlipayConnectionPool;
+
+// 借出的连接（RAII），析构时自动归还连接池
+class PooledConnection {
+public:
+    PooledConnection() = default;
+    PooledConnection(AlipayConnectionPool* pool, std::unique_ptr<PooledMysql> entry);
+    ~PooledConnection();
+
+    PooledConnection(PooledConnection&& other) noexcept;
+    PooledConnection& operator=(PooledConnection&& other) noexcept;
+    PooledConnection(const PooledConnection&) = delete;
+    PooledConnection& operator=(const PooledConnection&) = delete;
+
+    // 不经过连接池直接建立一条独占连接，析构时关闭
+    static PooledConnection open(const char* host, const char* user,
+                                 const char* password, const char* db);
+
+    MYSQL* get() const { return entry_ ? entry_->conn : nullptr; }
+    explicit operator bool() const { return get() != nullptr; }
+
+    // 该连接的预处理语句缓存，须在持有连接时使用
+    AlipayStatementCache& statements() const { return entry_->statements; }
+
+    // 标记连接已损坏（如网络错误），归还时直接关闭而不放回池中
+    void markBroken() { broken_ = true; }
+
+    // 提前归还连接
+    void release();
+
+private:
+    AlipayConnectionPool* pool_ = nullptr;
+    std::unique_ptr<PooledMysql> entry_;
+    bool broken_ = false;
+};
+
+// 线程安全的 MySQL 连接池
+class AlipayConnectionPool {
+public:
+    static AlipayConnectionPool& getInstance();
+
+    // 初始化连接池（预建 min_idle 条连接）
+    bool init(const ConnectionPoolConfig& config);
+    bool isInitialized() const;
+    void shutdown();
+
+    // 借出一条连接，超时或建连失败返回空句柄
+    PooledConnection acquire();
+
+    // 回收空闲超时的连接
+    void evictIdle();
+
+    // 统计信息
+    size_t totalConnections() const;
+    size_t idleConnections() const;
+
+    AlipayConnectionPool() = default;
+    ~AlipayConnectionPool();
+    AlipayConnectionPool(const AlipayConnectionPool&) = delete;
+    AlipayConnectionPool& operator=(const AlipayConnectionPool&) = delete;
+
+private:
+    friend class PooledConnection;
+
+    std::unique_ptr<PooledMysql> createConnection();
+    bool checkHealth(PooledMysql& entry, uint64_t now);
+    void giveBack(std::unique_ptr<PooledMysql> entry, bool broken);
+    void evictIdleLocked(uint64_t now, std::deque<std::unique_ptr<PooledMysql>>& evicted);
+
+    ConnectionPoolConfig config_;
+    mutable std::mutex mutex_;
+    std::condition_variable available_;
+    std::deque<std::unique_ptr<PooledMysql>> idle_; // 队头为最近归还的连接
+    size_t total_ = 0;   // 已建立的物理连接数（含借出的）
+    bool initialized_ = false;
+};
+
+// 建立一条 MySQL 连接（连接池与独占连接共用）
+MYSQL* openMysqlConnection(const char* host, const char* user, const char* password,
+                           const char* db, unsigned int port, const char* charset,
+                           unsigned int connectTimeoutSeconds);
+
+// 当前毫秒时间戳（单调时钟）
+uint64_t steadyNowMs();
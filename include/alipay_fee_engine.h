@@ -0,0 +1,50 @@
+#pragma once
+
+#include <string_view>
+#include <cstdint>
+#include <cstddef>
+
+// 手续费舍入方式
+enum class FeeRounding {
+    TRUNCATE,   // 截断（向下取整到分）
+    HALF_UP,    // 四舍五入
+    HALF_EVEN,  // 银行家舍入
+    UP,         // 进位（向上取整到分）
+};
+
+// 服务商分润：子商户按自身费率支付的手续费中，服务商费率部分归平台，差额归服务商
+struct FeeProfitShare {
+    uint64_t total_fee = 0;     // 子商户支付的手续费(分)
+    uint64_t platform_fee = 0;  // 平台收取(分)
+    uint64_t isv_profit = 0;    // 服务商分润(分)
+};
+
+// 定点手续费计算：费率以基点（万分之一，与 fee_rate DECIMAL(5,4) 精度一致）整数保存，
+// 金额单位为分，全程整数运算；要求 amount * rate_bps 不超过 uint64（单笔约 1.8e15 分）
+class AlipayFeeEngine {
+public:
+    static constexpr uint32_t kBasisPointScale = 10000;
+
+    explicit AlipayFeeEngine(FeeRounding rounding = FeeRounding::TRUNCATE) : rounding_(rounding) {}
+
+    FeeRounding rounding() const { return rounding_; }
+
+    // 单笔手续费
+    uint64_t fee(uint64_t amount, uint32_t rateBps) const;
+
+    // 批量计算：fees[i] 为 amounts[i] 的手续费，settlements[i] = amounts[i] - fees[i]，返回手续费合计。
+    // 舍入方式在循环外分派，循环体无分支，便于编译器展开/向量化
+    uint64_t computeBatch(const uint64_t* amounts, size_t count, uint32_t rateBps,
+                          uint64_t* fees, uint64_t* settlements) const;
+
+    // 子商户费率 subRateBps、服务商费率 isvRateBps 下的分润；服务商费率不低于子商户费率时分润为 0
+    FeeProfitShare profitShare(uint64_t amount, uint32_t subRateBps, uint32_t isvRateBps) const;
+
+    // "0.0060" 之类的十进制费率转基点，超过 4 位小数或大于 1 时返回 false
+    static bool parseRate(std::string_view text, uint32_t& rateBps);
+    // 兼容 double 费率，四舍五入到最近的基点
+    static uint32_t rateFromDouble(double rate);
+
+private:
+    FeeRounding rounding_;
+};
@@ -0,0 +1,88 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <atomic>
+#include <cstdint>
+#include <cstddef>
+
+// 固定长度的 ID 缓冲，格式化时不分配内存
+struct AlipayIdBuffer {
+    static constexpr size_t kCapacity = 64;     // 与 settlement_id 等列的 VARCHAR(64) 一致
+
+    char data[kCapacity];
+    size_t size = 0;
+
+    std::string_view view() const { return std::string_view(data, size); }
+    std::string str() const { return std::string(data, size); }
+};
+
+// ID 生成统计
+struct IdGeneratorStats {
+    uint64_t clock_regressions = 0;   // 系统时钟回拨期间生成的 ID 数
+    uint64_t sequence_overflows = 0;  // 单毫秒序列号用尽、借用下一毫秒的次数
+};
+
+// 雪花算法 ID 生成器（无锁）
+// 位布局：41 位毫秒时间戳 | 8 位节点号 | 5 位线程槽 | 9 位序列号
+// 每个线程固定映射到一个槽位，槽位状态（时间戳 + 序列号）以 CAS 更新；
+// 线程数超过槽位数时多个线程共享槽位，CAS 保证仍然唯一
+// 时钟回拨时沿用上次的时间戳继续递增，不阻塞也不回退
+class AlipayIdGenerator {
+public:
+    static constexpr int kTimestampBits = 41;
+    static constexpr int kNodeBits = 8;
+    static constexpr int kSlotBits = 5;
+    static constexpr int kSequenceBits = 9;
+    static constexpr uint64_t kEpochMs = 1704067200000ULL; // 2024-01-01 00:00:00 UTC
+    static constexpr uint32_t kMaxNodeId = (1u << kNodeBits) - 1;
+    static constexpr size_t kDigits = 19;                  // 十进制定长位数（63 位以内）
+
+    static AlipayIdGenerator& getInstance();
+
+    // 设置节点号（0~255），同一集群内每个进程必须不同，须在生成 ID 前调用
+    bool setNodeId(uint32_t nodeId);
+    uint32_t nodeId() const { return node_id_.load(std::memory_order_relaxed); }
+
+    // 生成下一个 64 位 ID
+    uint64_t next();
+
+    // 生成 "prefix_0000000000000000000" 格式的 ID；前缀超过 kCapacity - kDigits - 1 时抛出 std::invalid_argument
+    AlipayIdBuffer nextId(std::string_view prefix);
+    std::string nextString(std::string_view prefix) { return nextId(prefix).str(); }
+
+    // 把 ID 格式化到调用方缓冲，返回写入长度；容量不足时返回 0
+    static size_t format(char* out, size_t capacity, std::string_view prefix, uint64_t id);
+
+    // 从 ID 中取出毫秒时间戳（Unix 纪元）
+    static uint64_t timestampOf(uint64_t id);
+
+    // 判断 id 是否生成于 cutoff 之前，cutoff 须为 nextId 生成的 ID，两者前缀相同。
+    // 同为定长格式时按字典序比较；旧版本的 "prefix_<毫秒>_<随机数>" 格式按其中的毫秒数
+    // 与 cutoff 的时间戳比较；前缀不同或其他格式返回 false
+    static bool generatedBefore(std::string_view id, std::string_view cutoff);
+
+    IdGeneratorStats stats() const;
+
+    AlipayIdGenerator() = default;
+    AlipayIdGenerator(const AlipayIdGenerator&) = delete;
+    AlipayIdGenerator& operator=(const AlipayIdGenerator&) = delete;
+
+private:
+    static constexpr uint32_t kSlots = 1u << kSlotBits;
+    static constexpr uint64_t kSequenceMask = (1ULL << kSequenceBits) - 1;
+
+    // 每个槽位独占一条缓存行，避免伪共享
+    struct alignas(64) Slot {
+        std::atomic<uint64_t> state{0};     // 高位为时间戳，低 kSequenceBits 位为序列号
+    };
+
+    uint32_t slotForThisThread();
+
+    Slot slots_[kSlots];
+    std::atomic<uint32_t> node_id_{0};
+    std::atomic<uint32_t> next_slot_{0};
+    std::atomic<uint64_t> max_clock_ms_{0};   // 见过的最大系统时钟（相对 kEpochMs）
+    std::atomic<uint64_t> clock_regressions_{0};
+    std::atomic<uint64_t> sequence_overflows_{0};
+};
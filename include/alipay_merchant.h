@@ -4,6 +4,8 @@
 #include <optional>
 #include <cstdint>
 #include <mysql/mysql.h>
+#include "alipay_connection_pool.h"
+#include "alipay_status.h"
 #include <memory>
 
 class AlipayMerchant {
@@ -14,6 +16,7 @@ public:
     // 数据库连接
     bool connectDB(const char* host, const char* user, 
                   const char* password, const char* db);
+    bool connectDB(AlipayConnectionPool& pool); // 从连接池借用连接
 
     // 商户操作
     bool createMerchant();
@@ -33,23 +36,25 @@ public:
                        const std::string& bankBranch);
     void setSettlementInfo(const std::string& type,
                           const std::string& cycle,
-                          double feeRate);
+                          double feeRate);    // 四舍五入到最近的基点
 
     // Getters
     std::string getMerchantId() const;
     std::string getMerchantName() const;
     std::string getMerchantType() const;
-    double getFeeRate() const;
+    double getFeeRate() const;      // 仅用于展示
+    uint32_t getFeeRateBps() const; // 费率（基点），用于手续费计算
     std::string getSettlementCycle() const;
     std::string getBankAccountNo() const;
 
 private:
-    MYSQL* conn;
+    PooledConnection lease_; // 持有的连接（池化或独占）
+    MYSQL* conn;             // lease_ 中的连接
     
     std::string merchant_id_;
     std::string merchant_name_;
     std::string merchant_type_;
-    std::string status_;
+    MerchantStatus status_ = MerchantStatus::UNKNOWN;
     uint64_t create_time_;
     uint64_t update_time_;
     
@@ -64,9 +69,7 @@ private:
     
     std::string settlement_type_;
     std::string settlement_cycle_;
-    double fee_rate_;
+    uint32_t fee_rate_bps_;  // 费率（基点），与 fee_rate DECIMAL(5,4) 一一对应
 
     std::shared_ptr<MerchantType> merchant_type_;
-
-    bool createMerchantTable();
 }; 
\ No newline at end of file
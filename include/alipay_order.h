@@ -3,8 +3,12 @@
 #include <string>
 #include <vector>
 #include <optional>
+#include <span>
 #include <cstdint>
 #include <mysql/mysql.h>
+#include "alipay_connection_pool.h"
+#include "alipay_query_cache.h"
+#include "alipay_async_transaction.h"
 
 // 商品明细信息
 struct AlipayGoodsDetail {
@@ -28,6 +32,34 @@ struct AlipayExtendParams {
     std::optional<std::string> card_type;              // 可选 - 卡类型(32)
 };
 
+// 订单查询模式
+enum class OrderQueryMode {
+    SUMMARY,    // 只查订单主表；商品明细和扩展参数在首次调用对应 getter 时再加载
+    FULL        // 一次往返（JOIN）加载订单、商品明细和扩展参数
+};
+
+// 订单主表快照，用于进程内查询缓存（不含商品明细和扩展参数）
+struct AlipayOrderSnapshot {
+    std::string out_trade_no;
+    uint64_t total_amount = 0;
+    std::string subject;
+    std::string product_code;
+    std::optional<std::string> body;
+    std::optional<uint64_t> time_expire;
+    std::optional<uint64_t> timeout_express;
+    std::optional<std::string> store_id;
+    std::optional<std::string> merchant_order_no;
+    uint64_t create_time = 0;
+    std::optional<std::string> merchant_id;
+};
+
+// 批量创建订单的单条结果
+struct OrderBatchResult {
+    std::string out_trade_no;
+    bool success = false;
+    std::string error;          // 失败原因
+};
+
 // 支付宝订单模型
 class AlipayOrder {
 public:
@@ -37,10 +69,27 @@ public:
     // 数据库连接
     bool connectDB(const char* host, const char* user, 
                   const char* password, const char* db);
+    bool connectDB(AlipayConnectionPool& pool); // 从连接池借用连接
 
     // 订单操作
     bool createOrder();
-    bool queryOrder(const std::string& outTradeNo);
+    // 本地事务模式：订单、商品明细、扩展参数、WAIT_BUYER_PAY 支付记录和 ORDER_CREATED 事件
+    // 在同一个 InnoDB 本地事务中写入（各表须在同一个库），事件由 AlipayOutboxRelay 异步投递，不经过 XA
+    bool createOrderWithPayment();
+    // 协程版本：在事件循环线程上经非阻塞连接写入订单、商品明细和扩展参数，
+    // 等待 MySQL 期间不占用线程；协程结束前订单对象须保持有效
+    AsyncTask<bool> createOrderAsync(AlipayAsyncTransaction& transaction);
+    bool queryOrder(const std::string& outTradeNo,
+                    OrderQueryMode mode = OrderQueryMode::SUMMARY);
+    bool queryOrderCached(const std::string& outTradeNo); // 经缓存的 SUMMARY 查询（收银台轮询）
+
+    // 订单查询缓存，状态变更后须调用 invalidate
+    static AlipayQueryCache<AlipayOrderSnapshot>& cache();
+
+    // 批量创建订单：订单、商品明细、扩展参数均以多行 INSERT 写入，
+    // 返回与输入一一对应的结果，单个订单号重复不影响同批其他订单
+    std::vector<OrderBatchResult> createOrders(std::span<const AlipayOrder> orders);
+    static constexpr size_t kOrderBatchChunk = 200; // 每个本地事务写入的订单数
 
     // 必填参数设置
     void setOutTradeNo(const std::string& value);    // 商户订单号(64)
@@ -56,6 +105,7 @@ public:
     void setExtendParams(const AlipayExtendParams& params); // 业务扩展参数
     void setStoreId(const std::string& value);       // 商户门店编号(32)
     void setMerchantOrderNo(const std::string& value); // 商户原始订单号(32)
+    void setMerchantId(const std::string& value);    // 收款商户ID(32)，批量结算按商户汇总
 
     // Getters
     std::string getOutTradeNo() const;
@@ -69,6 +119,7 @@ public:
     AlipayExtendParams getExtendParams() const;
     std::string getStoreId() const;
     std::string getMerchantOrderNo() const;
+    std::string getMerchantId() const;
     uint64_t getCreateTime() const;
 
     // 工具方法
@@ -78,7 +129,8 @@ public:
     static uint64_t stringToTimestamp(const std::string& timeStr); // 字符串转时间戳
 
 private:
-    MYSQL* conn;
+    mutable PooledConnection lease_; // 持有的连接（池化或独占），const 的懒加载也要借用语句
+    MYSQL* conn;             // lease_ 中的连接
 
     // 订单基本信息
     std::string out_trade_no_;       // 商户订单号
@@ -91,13 +143,28 @@ private:
     std::optional<std::string> store_id_;          // 商户门店编号
     std::optional<std::string> merchant_order_no_; // 商户原始订单号
     uint64_t create_time_;           // 订单创建时间
+    std::optional<std::string> merchant_id_;       // 收款商户ID
+
+    // 商品信息和扩展参数（SUMMARY 查询后懒加载，故为 mutable）
+    mutable std::vector<AlipayGoodsDetail> goods_detail_; // 商品明细
+    mutable std::optional<AlipayExtendParams> extend_params_; // 业务扩展参数
+    mutable bool goods_loaded_;      // 商品明细是否已在内存中（查库得到或由调用方设置）
+    mutable bool extend_loaded_;     // 扩展参数是否已在内存中（查库得到或由调用方设置）
 
-    // 商品信息和扩展参数
-    std::vector<AlipayGoodsDetail> goods_detail_; // 商品明细
-    std::optional<AlipayExtendParams> extend_params_; // 业务扩展参数
+    // 查询辅助方法
+    struct OrderColumns;
+    struct DetailColumns;
+    bool fetchWithDetails(const std::string& outTradeNo, OrderColumns* order) const;
+    void loadDetails() const;
+    AlipayOrderSnapshot snapshot() const;
+    void applySnapshot(const AlipayOrderSnapshot& snapshot);
 
-    // 数据库操作辅助方法
-    bool createOrderTable();    // 创建订单表
-    bool createGoodsTable();   // 创建商品明细表
-    bool createExtendParamsTable(); // 创建扩展参数表
+    // 批量写入辅助方法
+    void insertOrderChunk(std::span<const AlipayOrder> orders,
+                          const std::vector<size_t>& indexes,
+                          std::vector<OrderBatchResult>& results);
+    bool insertOrderRows(std::span<const AlipayOrder> orders,
+                         const std::vector<size_t>& indexes,
+                         uint64_t createTime, unsigned int& errorCode,
+                         std::string& error);
 }; 
\ No newline at end of file
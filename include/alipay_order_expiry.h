@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <optional>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "alipay_connection_pool.h"
+#include "alipay_timing_wheel.h"
+
+// 订单超时关闭配置
+struct OrderExpiryOptions {
+    std::chrono::milliseconds tick_interval{1000};   // 时间轮推进间隔
+    size_t close_batch_size = 500;                   // 每条关单 UPDATE 的订单数
+    size_t rebuild_page_size = 1000;                 // 启动重建时每页读取的订单数
+    uint64_t default_timeout_seconds = 15 * 24 * 3600; // 未设置超时参数时的关单时间（支付宝默认 15 天）
+    uint64_t retry_delay_seconds = 5;                // 关单失败后的重试间隔
+};
+
+// 订单超时关闭统计
+struct OrderExpiryStats {
+    uint64_t scheduled = 0;     // 加入时间轮的次数
+    uint64_t cancelled = 0;     // 支付完成等原因取消的定时器
+    uint64_t expired = 0;       // 到期的定时器
+    uint64_t closed = 0;        // 实际由 WAIT_BUYER_PAY 改为 TRADE_CLOSED 的订单
+    uint64_t close_failures = 0; // 关单语句执行失败次数
+    uint64_t rebuilt = 0;       // 启动重建时载入的待支付订单
+};
+
+// 订单超时关闭引擎：创建订单时按 time_expire/timeout_express 登记到期时间，
+// 到期后批量把仍在等待付款的支付记录改为 TRADE_CLOSED，取代定时全表扫描
+class AlipayOrderExpiryEngine {
+public:
+    static AlipayOrderExpiryEngine& getInstance();
+
+    // 从数据库重建待支付订单的定时器并启动后台线程
+    bool start(AlipayConnectionPool& pool, const OrderExpiryOptions& options = OrderExpiryOptions());
+    void stop();
+    bool isRunning() const { return running_.load(std::memory_order_acquire); }
+
+    // 登记订单的关单时间（秒级时间戳）；引擎未启动时忽略
+    void schedule(const std::string& outTradeNo, uint64_t expireAt);
+
+    // 支付成功或主动关单后取消定时器
+    void cancel(const std::string& outTradeNo);
+
+    // 按订单参数计算关单时间：time_expire 与 create_time + timeout_express 取较早者
+    uint64_t expireAtFor(uint64_t createTime, std::optional<uint64_t> timeExpire,
+                         std::optional<uint64_t> timeoutExpress) const;
+
+    size_t pendingTimers() const;
+    OrderExpiryStats stats() const;
+
+private:
+    AlipayOrderExpiryEngine() = default;
+    ~AlipayOrderExpiryEngine();
+    AlipayOrderExpiryEngine(const AlipayOrderExpiryEngine&) = delete;
+    AlipayOrderExpiryEngine& operator=(const AlipayOrderExpiryEngine&) = delete;
+
+    bool rebuild();
+    void run();
+    void closeOrders(std::vector<std::string>& outTradeNos);
+    bool closeBatch(MYSQL* conn, const std::string* first, size_t count, uint64_t& closed);
+
+    AlipayConnectionPool* pool_ = nullptr;
+    OrderExpiryOptions options_;
+
+    mutable std::mutex mutex_;              // 保护 wheel_
+    AlipayTimingWheel wheel_{0};
+    std::atomic<bool> running_{false};
+
+    std::mutex thread_mutex_;
+    std::condition_variable wakeup_;
+    std::thread worker_;
+    bool stopping_ = false;
+
+    std::atomic<uint64_t> scheduled_{0};
+    std::atomic<uint64_t> cancelled_{0};
+    std::atomic<uint64_t> expired_{0};
+    std::atomic<uint64_t> closed_{0};
+    std::atomic<uint64_t> close_failures_{0};
+    std::atomic<uint64_t> rebuilt_{0};
+};
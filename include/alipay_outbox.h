@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include <mysql/mysql.h>
+#include "alipay_connection_pool.h"
+
+// 事件表 alipay_outbox 中的一条事件
+struct OutboxEvent {
+    uint64_t id = 0;                // 自增主键，同时作为投递时的事件 ID（消费方据此去重）
+    std::string aggregate_id;       // 业务主键，如商户订单号
+    std::string event_type;         // 事件类型
+    std::string payload;            // 事件内容（JSON）
+    uint64_t create_time = 0;
+};
+
+// 在调用方已开启的本地事务中写入一条事件（不提交），与业务数据一起生效或回滚
+bool appendOutboxEvent(MYSQL* conn, const OutboxEvent& event);
+
+// 事件投递配置
+struct OutboxRelayOptions {
+    std::chrono::milliseconds poll_interval{200};   // 没有新事件时的轮询间隔
+    size_t batch_size = 500;                        // 每批读取并投递的事件数
+    std::chrono::milliseconds retry_delay{1000};    // 投递失败后的重试间隔
+};
+
+// 事件投递统计
+struct OutboxRelayStats {
+    uint64_t published = 0;     // 已投递并删除的事件数
+    uint64_t batches = 0;       // 投递成功的批次数
+    uint64_t failures = 0;      // 投递或删除失败的批次数
+};
+
+// 事件投递：后台线程按主键顺序分批读取 alipay_outbox，交给 publisher 投递，成功后删除该批事件。
+// 投递成功而删除失败时会重复投递（至少一次），消费方按事件 ID 去重
+class AlipayOutboxRelay {
+public:
+    // 批量投递回调，全部投递成功才返回 true
+    using Publisher = std::function<bool(const std::vector<OutboxEvent>& events)>;
+
+    // 事件类型
+    static constexpr const char* EVENT_ORDER_CREATED = "ORDER_CREATED"; // 订单及待支付记录已创建
+
+    static AlipayOutboxRelay& getInstance();
+
+    bool start(AlipayConnectionPool& pool, Publisher publisher,
+               const OutboxRelayOptions& options = OutboxRelayOptions());
+    void stop();
+    bool isRunning() const { return running_.load(std::memory_order_acquire); }
+
+    // 本地事务提交后调用，立即唤醒投递线程而不必等到下一次轮询
+    void notify();
+
+    OutboxRelayStats stats() const;
+
+private:
+    AlipayOutboxRelay() = default;
+    ~AlipayOutboxRelay();
+    AlipayOutboxRelay(const AlipayOutboxRelay&) = delete;
+    AlipayOutboxRelay& operator=(const AlipayOutboxRelay&) = delete;
+
+    void run();
+    // 投递一批，返回本批事件数；失败返回 -1
+    long relayBatch(MYSQL* conn);
+
+    AlipayConnectionPool* pool_ = nullptr;
+    Publisher publisher_;
+    OutboxRelayOptions options_;
+    std::atomic<bool> running_{false};
+
+    std::mutex mutex_;
+    std::condition_variable wakeup_;
+    std::thread worker_;
+    bool stopping_ = false;
+    bool notified_ = false;
+
+    std::atomic<uint64_t> published_{0};
+    std::atomic<uint64_t> batches_{0};
+    std::atomic<uint64_t> failures_{0};
+};
@@ -2,12 +2,34 @@
 
 #include <string>
 #include <optional>
+#include <vector>
 #include <cstdint>
 #include <mysql/mysql.h>
+#include "alipay_connection_pool.h"
+#include "alipay_query_cache.h"
+#include "alipay_status.h"
+#include "alipay_async_transaction.h"
+
+// 支付记录快照，用于进程内查询缓存
+struct AlipayPaymentSnapshot {
+    std::string out_trade_no;
+    std::optional<std::string> trade_no;
+    std::optional<TradeStatus> trade_status;
+    std::optional<uint64_t> pay_time;
+    uint64_t update_time = 0;
+};
+
+// 条件状态变更的结果
+enum class PaymentTransitionResult {
+    APPLIED,            // 已从允许的前驱状态变更为目标状态
+    ALREADY_APPLIED,    // 记录已处于目标状态（重复通知），未做修改
+    ILLEGAL,            // 当前状态不允许变更到目标状态，或记录不存在
+    FAILED              // 执行出错，结果未知
+};
 
 class AlipayPayment {
 public:
-    // 交易状态常量
+    // 交易状态的对外名称（支付宝协议中的取值），库中存储 TradeStatus 编码
     static constexpr const char* TRADE_STATUS_WAIT_BUYER_PAY = "WAIT_BUYER_PAY";  // 交易创建，等待买家付款
     static constexpr const char* TRADE_STATUS_TRADE_CLOSED = "TRADE_CLOSED";      // 未付款交易超时关闭，或支付完成后全额退款
     static constexpr const char* TRADE_STATUS_TRADE_SUCCESS = "TRADE_SUCCESS";    // 交易支付成功
@@ -19,14 +41,39 @@ public:
     // 数据库连接
     bool connectDB(const char* host, const char* user, 
                   const char* password, const char* db);
+    bool connectDB(AlipayConnectionPool& pool); // 从连接池借用连接
 
     // 支付操作
     bool createPayment(const std::string& outTradeNo);
     bool queryPayment(const std::string& outTradeNo);
+    bool queryPaymentCached(const std::string& outTradeNo); // 经缓存查询（收银台轮询）
     bool updatePaymentStatus(const std::string& outTradeNo, 
                            const std::string& tradeNo,
                            const std::string& status);
 
+    // 按状态转换表做条件更新：一条 UPDATE ... WHERE trade_status IN (允许的前驱, 目标)，
+    // 由匹配行数和变更行数区分结果，不需要先查询再更新，也不加锁读
+    PaymentTransitionResult transitionPaymentStatus(const std::string& outTradeNo,
+                                                    const std::string& tradeNo,
+                                                    TradeStatus status);
+    PaymentTransitionResult transitionPaymentStatus(const std::string& outTradeNo,
+                                                    const std::string& tradeNo,
+                                                    const std::string& status); // 未知状态为 ILLEGAL
+    // 状态转换表：WAIT_BUYER_PAY -> TRADE_SUCCESS / TRADE_FINISHED（不可退款产品）/ TRADE_CLOSED，
+    // TRADE_SUCCESS -> TRADE_FINISHED / TRADE_CLOSED（全额退款），TRADE_FINISHED、TRADE_CLOSED 为终态。
+    // 通知合并写入（AlipayPaymentNotifyPipeline）使用同一张表
+    static bool canTransition(TradeStatus from, TradeStatus to);
+    static std::vector<TradeStatus> predecessorsOf(TradeStatus to);
+
+    // 协程版本，语义同上，经事件循环线程上的非阻塞连接执行；
+    // 字符串参数按值保存在协程帧中，协程结束前对象须保持有效
+    AsyncTask<bool> createPaymentAsync(AlipayAsyncTransaction& transaction,
+                                       std::string outTradeNo);
+    AsyncTask<bool> updatePaymentStatusAsync(AlipayAsyncConnection& conn,
+                                             std::string outTradeNo,
+                                             std::string tradeNo,
+                                             std::string status);
+
     // Setters
     void setTradeNo(const std::string& value);       // 支付宝交易号(64)
     void setTradeStatus(const std::string& value);   // 交易状态
@@ -36,23 +83,32 @@ public:
     std::string getOutTradeNo() const;
     std::string getTradeNo() const;
     std::string getTradeStatus() const;
+    TradeStatus getTradeStatusCode() const;         // 未查询或未设置时为 UNKNOWN
     uint64_t getPayTime() const;
     uint64_t getUpdateTime() const;
 
+    // 支付记录查询缓存，状态变更后须调用 invalidate
+    static AlipayQueryCache<AlipayPaymentSnapshot>& cache();
+    // 状态写入后的收尾：失效查询缓存（执行报错时结果未知，同样失效）；
+    // 写入成功且离开等待付款状态时取消超时关单
+    static void finishStatusWrite(const std::string& outTradeNo, TradeStatus status, bool written);
+
     // 工具方法
     static std::string timestampToString(uint64_t timestamp);
     static uint64_t stringToTimestamp(const std::string& timeStr);
 
 private:
-    MYSQL* conn;
+    // 状态写入成功后同步本地字段
+    void applyStatusLocally(const std::string& outTradeNo, const std::string& tradeNo,
+                            TradeStatus status, uint64_t updateTime);
+
+    PooledConnection lease_; // 持有的连接（池化或独占）
+    MYSQL* conn;             // lease_ 中的连接
 
     // 支付信息
     std::string out_trade_no_;                   // 商户订单号
     std::optional<std::string> trade_no_;        // 支付宝交易号
-    std::optional<std::string> trade_status_;    // 交易状态
+    std::optional<TradeStatus> trade_status_;    // 交易状态
     std::optional<uint64_t> pay_time_;           // 支付时间戳
     uint64_t update_time_;                       // 状态更新时间
-
-    // 数据库操作辅助方法
-    bool createPaymentTable();    // 创建支付表
 }; 
\ No newline at end of file
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <future>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <mysql/mysql.h>
+#include "alipay_connection_pool.h"
+#include "alipay_status.h"
+
+// 一条支付宝异步通知
+struct PaymentNotification {
+    std::string out_trade_no;       // 商户订单号
+    std::string trade_no;           // 支付宝交易号
+    std::string trade_status;       // 交易状态（通知中的字符串取值）
+};
+
+// 通知合并写入配置
+struct PaymentNotifyOptions {
+    size_t queue_capacity = 10000;                  // 队列满时 submit 阻塞（背压）
+    size_t max_batch = 500;                         // 每条 UPDATE 最多更新的订单数
+    std::chrono::milliseconds max_wait{5};          // 队列不足一批时最多等待的时长
+};
+
+// 通知合并写入统计
+struct PaymentNotifyStats {
+    uint64_t received = 0;      // 已提交的通知数
+    uint64_t coalesced = 0;     // 与同批同一订单合并掉的通知数
+    uint64_t rows = 0;          // 写入的订单数（合并后）
+    uint64_t statements = 0;    // 执行的 UPDATE 条数
+    uint64_t failures = 0;      // 执行失败的 UPDATE 条数
+};
+
+// 支付通知合并写入：多个线程 submit，单个写入线程取出队列中的全部通知，
+// 同一订单只保留最靠后的状态（WAIT_BUYER_PAY < TRADE_SUCCESS < TRADE_FINISHED/TRADE_CLOSED），
+// 每 max_batch 个订单以一条 CASE 多行 UPDATE 写入。
+// UPDATE 只推进状态：库中已是同级或更靠后状态的订单不会被乱序到达的旧通知改回。
+// 每条通知各自得到确认：所在 UPDATE 执行成功为 true
+class AlipayPaymentNotifyPipeline {
+public:
+    static AlipayPaymentNotifyPipeline& getInstance();
+
+    bool start(AlipayConnectionPool& pool,
+               const PaymentNotifyOptions& options = PaymentNotifyOptions());
+    // 写完队列中已有的通知后停止
+    void stop();
+    bool isRunning() const { return running_.load(std::memory_order_acquire); }
+
+    // 提交一条通知；未启动或已停止时立即以 false 完成
+    std::future<bool> submit(PaymentNotification notification);
+
+    PaymentNotifyStats stats() const;
+
+    // 批内合并时的状态先后，沿状态转换表（AlipayPayment::canTransition）单调递增
+    static int statusRank(TradeStatus status);
+
+private:
+    struct Pending {
+        PaymentNotification notification;
+        std::promise<bool> ack;
+    };
+    // 同一订单合并后的写入
+    struct Merged {
+        PaymentNotification notification;
+        TradeStatus status = TradeStatus::UNKNOWN;
+        bool paid = false;                      // 合并前出现过已付款状态，需记录支付时间
+        bool applied = false;                   // 写入后库中已是目标状态（转换未被拒绝）
+        std::vector<std::promise<bool>> acks;
+    };
+
+    AlipayPaymentNotifyPipeline() = default;
+    ~AlipayPaymentNotifyPipeline();
+    AlipayPaymentNotifyPipeline(const AlipayPaymentNotifyPipeline&) = delete;
+    AlipayPaymentNotifyPipeline& operator=(const AlipayPaymentNotifyPipeline&) = delete;
+
+    void run();
+    void flush(std::vector<Pending>& pending);
+    bool writeChunk(MYSQL* conn, const std::vector<Merged*>& chunk, uint64_t now);
+
+    AlipayConnectionPool* pool_ = nullptr;
+    PaymentNotifyOptions options_;
+    std::atomic<bool> running_{false};
+
+    std::mutex mutex_;
+    std::condition_variable not_empty_;
+    std::condition_variable not_full_;
+    std::deque<Pending> queue_;
+    std::thread worker_;
+    bool stopping_ = false;
+
+    std::atomic<uint64_t> received_{0};
+    std::atomic<uint64_t> coalesced_{0};
+    std::atomic<uint64_t> rows_{0};
+    std::atomic<uint64_t> statements_{0};
+    std::atomic<uint64_t> failures_{0};
+};
@@ -0,0 +1,213 @@
+#pragma once
+
+#include <string>
+#include <list>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <optional>
+#include <functional>
+#include <cstdint>
+
+// 查询缓存配置
+struct QueryCacheOptions {
+    size_t shards = 16;                          // 分片数，减少锁竞争
+    size_t capacity_per_shard = 4096;            // 每个分片的最大条目数（LRU 淘汰）
+    std::chrono::milliseconds ttl{1000};         // 条目有效期，兜底其他进程的写入
+};
+
+// 查询缓存统计
+struct QueryCacheStats {
+    uint64_t hits = 0;
+    uint64_t misses = 0;        // 实际触发加载的次数
+    uint64_t coalesced = 0;     // 合并到他人加载结果上的未命中次数
+    uint64_t invalidations = 0;
+};
+
+// 进程内分片 LRU + TTL 读穿缓存，以字符串为键
+// 同一个键的并发未命中只会触发一次加载（single-flight），其余调用等待同一结果
+template <typename Value>
+class AlipayQueryCache {
+public:
+    using Clock = std::chrono::steady_clock;
+    using Loader = std::function<std::optional<Value>()>;
+
+    explicit AlipayQueryCache(const QueryCacheOptions& options = QueryCacheOptions())
+        : options_(options),
+          shards_(options.shards == 0 ? 1 : options.shards) {}
+
+    // 读缓存，未命中或已过期返回空
+    std::optional<Value> get(const std::string& key) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto value = lookupLocked(shard, key, Clock::now());
+        if (value) hits_.fetch_add(1, std::memory_order_relaxed);
+        return value;
+    }
+
+    // 读穿：未命中时调用 loader，loader 返回空表示不存在或出错，结果不缓存
+    std::optional<Value> getOrLoad(const std::string& key, const Loader& loader) {
+        Shard& shard = shardFor(key);
+        std::shared_ptr<Flight> flight;
+        bool leader = false;
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            if (auto value = lookupLocked(shard, key, Clock::now())) {
+                hits_.fetch_add(1, std::memory_order_relaxed);
+                return value;
+            }
+
+            auto it = shard.flights.find(key);
+            if (it != shard.flights.end()) {
+                flight = it->second;
+            } else {
+                flight = std::make_shared<Flight>();
+                flight->result = flight->promise.get_future().share();
+                shard.flights.emplace(key, flight);
+                leader = true;
+            }
+        }
+
+        if (!leader) {
+            coalesced_.fetch_add(1, std::memory_order_relaxed);
+            return flight->result.get();
+        }
+
+        misses_.fetch_add(1, std::memory_order_relaxed);
+        std::optional<Value> value;
+        try {
+            value = loader();
+        } catch (...) {
+            value.reset();
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            // 加载期间发生过失效（写入）时，结果可能是旧值，不放入缓存
+            if (value && !flight->invalidated) {
+                storeLocked(shard, key, *value);
+            }
+            auto it = shard.flights.find(key);
+            if (it != shard.flights.end() && it->second == flight) {
+                shard.flights.erase(it);
+            }
+        }
+
+        flight->promise.set_value(value);
+        return value;
+    }
+
+    // 写入或覆盖
+    void put(const std::string& key, const Value& value) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        storeLocked(shard, key, value);
+    }
+
+    // 使条目失效，并阻止正在进行的加载把旧值写回
+    void invalidate(const std::string& key) {
+        Shard& shard = shardFor(key);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+        }
+        auto flight = shard.flights.find(key);
+        if (flight != shard.flights.end()) {
+            flight->second->invalidated = true;
+            shard.flights.erase(flight);
+        }
+        invalidations_.fetch_add(1, std::memory_order_relaxed);
+    }
+
+    void clear() {
+        for (auto& shard : shards_) {
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.lru.clear();
+            shard.index.clear();
+            for (auto& flight : shard.flights) {
+                flight.second->invalidated = true;
+            }
+            shard.flights.clear();
+        }
+    }
+
+    QueryCacheStats stats() const {
+        QueryCacheStats stats;
+        stats.hits = hits_.load(std::memory_order_relaxed);
+        stats.misses = misses_.load(std::memory_order_relaxed);
+        stats.coalesced = coalesced_.load(std::memory_order_relaxed);
+        stats.invalidations = invalidations_.load(std::memory_order_relaxed);
+        return stats;
+    }
+
+private:
+    struct Node {
+        std::string key;
+        Value value;
+        Clock::time_point expires_at;
+    };
+
+    struct Flight {
+        std::promise<std::optional<Value>> promise;
+        std::shared_future<std::optional<Value>> result;
+        bool invalidated = false;   // 受分片锁保护
+    };
+
+    struct Shard {
+        std::mutex mutex;
+        std::list<Node> lru;    // 队头为最近使用
+        std::unordered_map<std::string, typename std::list<Node>::iterator> index;
+        std::unordered_map<std::string, std::shared_ptr<Flight>> flights;
+    };
+
+    Shard& shardFor(const std::string& key) {
+        return shards_[std::hash<std::string>()(key) % shards_.size()];
+    }
+
+    std::optional<Value> lookupLocked(Shard& shard, const std::string& key,
+                                      Clock::time_point now) {
+        auto it = shard.index.find(key);
+        if (it == shard.index.end()) return std::nullopt;
+
+        if (it->second->expires_at <= now) {
+            shard.lru.erase(it->second);
+            shard.index.erase(it);
+            return std::nullopt;
+        }
+
+        shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+        return it->second->value;
+    }
+
+    void storeLocked(Shard& shard, const std::string& key, const Value& value) {
+        auto expires_at = Clock::now() + options_.ttl;
+        auto it = shard.index.find(key);
+        if (it != shard.index.end()) {
+            it->second->value = value;
+            it->second->expires_at = expires_at;
+            shard.lru.splice(shard.lru.begin(), shard.lru, it->second);
+            return;
+        }
+
+        if (shard.lru.size() >= options_.capacity_per_shard && !shard.lru.empty()) {
+            shard.index.erase(shard.lru.back().key);
+            shard.lru.pop_back();
+        }
+
+        shard.lru.push_front(Node{key, value, expires_at});
+        shard.index.emplace(key, shard.lru.begin());
+    }
+
+    QueryCacheOptions options_;
+    std::vector<Shard> shards_;
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> coalesced_{0};
+    std::atomic<uint64_t> invalidations_{0};
+};
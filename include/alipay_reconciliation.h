@@ -0,0 +1,108 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <cstdio>
+#include <cstdint>
+#include <mysql/mysql.h>
+#include "alipay_connection_pool.h"
+
+// 对账配置；对账单为按行分隔的文本，列号从 0 开始
+struct ReconciliationOptions {
+    char delimiter = ',';
+    bool has_header = true;                 // 跳过 '#' 注释行后的第一行为表头
+    size_t out_trade_no_column = 0;         // 商户订单号
+    size_t trade_no_column = 1;             // 支付宝交易号
+    size_t trade_status_column = 2;         // 交易状态名称（如 TRADE_SUCCESS）
+    size_t amount_column = 3;               // 订单金额（元）
+    size_t pay_time_column = 4;             // 付款时间 YYYY-MM-DD HH:MM:SS，可为空
+
+    size_t chunk_bytes = 64 << 20;          // 每个解析任务处理的文件字节数
+    size_t workers = 4;                     // 并行解析线程数；同时驻留内存的块数不超过该值
+    size_t report_batch_size = 500;         // 差异记录每批写入的行数
+    size_t lookup_batch_size = 500;         // 对账单独有的订单每批回查数据库的个数
+};
+
+// 一次对账的汇总
+struct ReconciliationResult {
+    std::string batch_key;
+    bool success = false;
+    std::string error;
+    uint64_t statement_lines = 0;       // 对账单数据行数（不含注释和表头）
+    uint64_t invalid_lines = 0;         // 无法解析而跳过的行数
+    uint64_t db_rows = 0;               // 账期内数据库侧的支付记录数
+    uint64_t matched = 0;               // 一致的记录数
+    uint64_t missing_in_db = 0;         // 对账单有、数据库无
+    uint64_t missing_in_statement = 0;  // 数据库已支付、对账单无
+    uint64_t amount_mismatches = 0;
+    uint64_t status_mismatches = 0;
+    uint64_t elapsed_ms = 0;
+};
+
+// 流式对账：对账单 mmap 后按块并行解析，每块排序后写入临时文件（有序段），
+// 再多路归并成按商户订单号有序的流；数据库侧按同一顺序以 mysql_use_result 流式读取，
+// 两路归并连接，差异写入 alipay_reconciliation_diffs。
+// 内存占用只与 chunk_bytes * workers 和批大小有关，与文件大小无关
+class AlipayReconciliation {
+public:
+    // 差异类型
+    static constexpr const char* DIFF_MISSING_IN_DB = "MISSING_IN_DB";
+    static constexpr const char* DIFF_MISSING_IN_STATEMENT = "MISSING_IN_STATEMENT";
+    static constexpr const char* DIFF_AMOUNT = "AMOUNT_MISMATCH";
+    static constexpr const char* DIFF_STATUS = "STATUS_MISMATCH";
+
+    explicit AlipayReconciliation(AlipayConnectionPool& pool,
+                                  const ReconciliationOptions& options = ReconciliationOptions());
+
+    // 将 statementPath 与 pay_time 在 [windowStart, windowEnd) 内的支付记录对账；
+    // batchKey 标识对账批次（如 "2024-03-20"），重跑时先清除该批次的旧差异
+    ReconciliationResult run(const std::string& statementPath, const std::string& batchKey,
+                             uint64_t windowStart, uint64_t windowEnd);
+
+    // 对账单中的一条记录，定长以便整块写入临时文件
+    struct StatementRecord {
+        char out_trade_no[64];
+        char trade_no[64];
+        char trade_status[32];
+        uint8_t out_trade_no_length;
+        uint8_t trade_no_length;
+        uint8_t trade_status_length;
+        uint64_t amount;
+        uint64_t pay_time;
+
+        std::string_view key() const { return {out_trade_no, out_trade_no_length}; }
+        std::string_view tradeNo() const { return {trade_no, trade_no_length}; }
+        std::string_view status() const { return {trade_status, trade_status_length}; }
+    };
+
+private:
+    struct DbRow {
+        std::string out_trade_no;
+        std::string trade_no;
+        std::string trade_status;
+        uint64_t amount = 0;
+    };
+
+    class DiffWriter;
+
+    // 并行解析并生成有序段，每段一个临时文件
+    bool buildRuns(const std::string& path, std::vector<FILE*>& runs,
+                   ReconciliationResult& result);
+    bool parseChunk(const char* begin, const char* end, bool skipHeader, FILE*& run,
+                    uint64_t& lines, uint64_t& invalid, std::string& error) const;
+    bool parseLine(std::string_view line, StatementRecord& record) const;
+
+    bool mergeJoin(std::vector<FILE*>& runs, PooledConnection& streamLease,
+                   PooledConnection& writeLease, const std::string& batchKey,
+                   uint64_t windowStart, uint64_t windowEnd, ReconciliationResult& result);
+    // 对账单独有的订单可能支付时间不在账期内，批量回查后再判定
+    bool resolveUnmatched(PooledConnection& lease, std::vector<StatementRecord>& pending,
+                          DiffWriter& writer, ReconciliationResult& result);
+    // 差异写入失败时返回 false
+    bool compare(const StatementRecord& record, const DbRow& row, DiffWriter& writer,
+                 ReconciliationResult& result);
+
+    AlipayConnectionPool& pool_;
+    ReconciliationOptions options_;
+};
@@ -0,0 +1,55 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <vector>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <mysql/mysql.h>
+
+// 把字符串列在线改写为编码列：加列并建同步触发器、按主键分块回填、
+// 在新列上建索引，再在短暂的表写锁内删触发器并换列名，最后在线删除旧列
+struct SchemaColumnRecode {
+    const char* table;
+    const char* key;                      // 单列主键，用于键集分块
+    const char* column;                   // 原字符串列，替换后同名
+    const char* index;                    // 原列上的索引，替换后由新列上的索引接替
+    std::string (*code_sql)(std::string_view column); // 由给定列计算编码的 SQL 表达式
+};
+
+// 一次 schema 变更
+struct SchemaMigration {
+    uint32_t version;                     // 递增版本号
+    const char* description;              // 变更说明
+    std::vector<const char*> statements;  // 依次执行的 SQL
+    std::vector<SchemaColumnRecode> recodes = {}; // 在 statements 之后执行
+};
+
+// 表结构管理：进程内只执行一次，按 schema_version 表记录的版本依次应用迁移
+class AlipaySchemaManager {
+public:
+    static AlipaySchemaManager& getInstance();
+
+    // 确保表结构为最新版本；已完成时直接返回，不产生任何数据库往返
+    bool ensureSchema(MYSQL* conn);
+
+    // 数据库中当前的 schema 版本
+    uint32_t currentVersion() const { return current_version_.load(); }
+
+    // 代码中最新的 schema 版本
+    static uint32_t latestVersion();
+
+private:
+    AlipaySchemaManager() = default;
+    ~AlipaySchemaManager() = default;
+
+    bool migrate(MYSQL* conn);
+    bool readVersion(MYSQL* conn, uint32_t& version);
+    bool applyMigration(MYSQL* conn, const SchemaMigration& migration);
+    bool recodeColumn(MYSQL* conn, const SchemaColumnRecode& recode);
+
+    std::mutex mutex_;
+    std::atomic<bool> ready_{false};
+    std::atomic<uint32_t> current_version_{0};
+};
@@ -4,10 +4,13 @@
 #include <optional>
 #include <cstdint>
 #include <mysql/mysql.h>
+#include "alipay_connection_pool.h"
+#include "alipay_fee_engine.h"
+#include "alipay_status.h"
 
 class AlipaySettlement {
 public:
-    // 结算状态常量
+    // 结算状态的名称，库中存储 SettlementStatus 编码
     static constexpr const char* STATUS_PENDING = "PENDING";        // 待结算
     static constexpr const char* STATUS_PROCESSING = "PROCESSING";  // 结算中
     static constexpr const char* STATUS_SUCCESS = "SUCCESS";        // 结算成功
@@ -19,6 +22,10 @@ public:
     // 数据库连接
     bool connectDB(const char* host, const char* user, 
                   const char* password, const char* db);
+    bool connectDB(AlipayConnectionPool& pool); // 从连接池借用连接
+
+    // 手续费舍入方式，默认截断到分
+    void setFeeRounding(FeeRounding rounding);
 
     // 结算操作
     bool createSettlement(const std::string& outTradeNo,
@@ -33,17 +40,19 @@ public:
     uint64_t getSettlementAmount() const;
     uint64_t getFeeAmount() const;
     std::string getStatus() const;
+    SettlementStatus getStatusCode() const;
     uint64_t getSettleTime() const;
 
 private:
-    MYSQL* conn;
+    PooledConnection lease_; // 持有的连接（池化或独占）
+    MYSQL* conn;             // lease_ 中的连接
     
     std::string settlement_id_;
     std::string merchant_id_;
     std::string out_trade_no_;
     uint64_t settlement_amount_;
     uint64_t fee_amount_;
-    std::string status_;
+    SettlementStatus status_ = SettlementStatus::UNKNOWN;
     std::optional<uint64_t> settle_time_;
     uint64_t create_time_;
     uint64_t update_time_;
@@ -51,5 +60,5 @@ private:
     std::string bank_name_;
     std::optional<std::string> remark_;
 
-    bool createSettlementTable();
+    AlipayFeeEngine fee_engine_;
 }; 
\ No newline at end of file
@@ -0,0 +1,135 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <cstdint>
+#include <mysql/mysql.h>
+#include "alipay_connection_pool.h"
+#include "alipay_work_stealing_pool.h"
+#include "alipay_fee_engine.h"
+
+// 批量结算配置
+struct SettlementBatchOptions {
+    size_t merchant_page_size = 500;                     // 每次读取的商户数
+    size_t page_size = 1000;                             // 每个本地事务结算的支付记录数
+    uint64_t max_order_lifetime_seconds = 15 * 24 * 3600; // 订单创建到支付的最长间隔，限定 create_time 扫描范围
+    size_t workers = 8;                                  // 并行结算的工作线程数，每个线程占用一条连接
+    size_t pages_per_task = 10;                          // 单个任务最多结算的页数，超出后剩余的 create_time 区间作为续作任务重新入队
+    size_t straggler_count = 10;                         // 报告耗时最长的商户数
+    FeeRounding fee_rounding = FeeRounding::TRUNCATE;    // 手续费舍入方式，与单笔结算一致
+};
+
+// 耗时最长的商户
+struct SettlementStraggler {
+    std::string merchant_id;
+    uint64_t elapsed_ms = 0;    // 该商户各任务的累计执行时间
+    uint64_t settled_count = 0;
+    uint32_t tasks = 0;         // 该商户被切分成的任务数
+};
+
+// 一次批量结算的汇总
+struct SettlementBatchResult {
+    std::string run_key;            // 结算批次，如 "T+1:2024-03-20"
+    bool success = false;
+    std::string error;
+    uint64_t merchants = 0;         // 本次处理的商户数
+    uint64_t skipped_merchants = 0; // 检查点显示已完成而跳过的商户数
+    uint64_t settled_count = 0;     // 新写入的结算单数
+    uint64_t settlement_amount = 0; // 结算金额合计(分)
+    uint64_t fee_amount = 0;        // 手续费合计(分)
+
+    uint64_t elapsed_ms = 0;        // 总耗时
+    double throughput = 0;          // 结算单/秒
+    uint64_t tasks = 0;             // 执行的任务数（含续作）
+    uint64_t stolen_tasks = 0;      // 被其他工作线程窃取执行的任务数
+    uint64_t median_merchant_ms = 0; // 商户耗时中位数，与 stragglers 对照
+    std::vector<SettlementStraggler> stragglers; // 按耗时降序
+};
+
+// 按结算周期批量结算：按商户拆分任务交给工作窃取线程池，每个商户流式读取账期内已支付且未结算的订单，
+// 批量计算手续费后以多行 INSERT 写入结算单；每页结算单与检查点在同一个本地事务内提交，
+// 中断后以相同参数重跑即从检查点继续。
+// 同一商户的任务串行执行（上一段完成后才提交下一段），大商户按 create_time 游标切段，不会长期占住一个线程
+class AlipaySettlementBatch {
+public:
+    explicit AlipaySettlementBatch(AlipayConnectionPool& pool,
+                                   const SettlementBatchOptions& options = SettlementBatchOptions());
+
+    // 结算 settlement_cycle 为 cycle 的全部 ACTIVE 商户在 businessDate（运行日，秒级时间戳）对应账期内的支付
+    SettlementBatchResult run(const std::string& cycle, uint64_t businessDate);
+
+    // 账期 [start, end)，按本地时区的自然日/周/月划分：
+    // T+1 为前一天，T+2 为前两天，WEEKLY 为上一个周一至周日，MONTHLY 为上一个自然月
+    static bool settlementWindow(const std::string& cycle, uint64_t businessDate,
+                                 uint64_t& start, uint64_t& end);
+
+    // 结算批次键："<cycle>:<账期起始日>"
+    static std::string runKey(const std::string& cycle, uint64_t windowStart);
+
+private:
+    struct MerchantInfo {
+        std::string merchant_id;
+        uint32_t fee_rate_bps = 0;  // 费率（基点）
+        std::string bank_account_no;
+        std::string bank_name;
+    };
+
+    struct Checkpoint {
+        bool done = false;
+        uint64_t last_create_time = 0;
+        std::string last_out_trade_no;
+    };
+
+    struct PaymentRow {
+        std::string out_trade_no;
+        uint64_t create_time = 0;
+        uint64_t total_amount = 0;
+    };
+
+    bool loadCheckpoints(PooledConnection& lease, const std::string& runKey,
+                         std::unordered_map<std::string, Checkpoint>& checkpoints,
+                         std::string& error);
+    bool loadMerchants(PooledConnection& lease, const std::string& cycle,
+                       const std::string& afterMerchantId,
+                       std::vector<MerchantInfo>& merchants, std::string& error);
+    // 商户在本次运行中的进度，由同一商户的续作任务依次传递
+    struct MerchantProgress {
+        MerchantInfo merchant;
+        Checkpoint cursor;
+        uint64_t elapsed_us = 0;
+        uint64_t settled_count = 0;
+        uint32_t tasks = 0;
+    };
+
+    // 一次运行的共享状态
+    struct RunState {
+        std::string run_key;
+        uint64_t window_start = 0;
+        uint64_t window_end = 0;
+        std::vector<PooledConnection> leases;   // 按工作线程编号，各线程只访问自己的连接
+        std::mutex mutex;                       // 保护 result 与 timings
+        SettlementBatchResult result;
+        std::vector<SettlementStraggler> timings;
+        std::atomic<bool> failed{false};
+        std::unique_ptr<AlipayWorkStealingPool> workers;
+    };
+
+    void runTask(RunState& state, std::shared_ptr<MerchantProgress> progress, size_t worker);
+    // 从 progress.cursor 起最多结算 pages_per_task 页，done 表示该商户已结算完
+    bool settleRange(PooledConnection& lease, MerchantProgress& progress, const RunState& state,
+                     SettlementBatchResult& totals, bool& done, std::string& error);
+    bool fetchPage(PooledConnection& lease, const std::string& merchantId,
+                   uint64_t windowStart, uint64_t windowEnd, const Checkpoint& cursor,
+                   std::vector<PaymentRow>& rows, std::string& error);
+    bool commitPage(PooledConnection& lease, const MerchantInfo& merchant,
+                    const std::string& runKey, const std::vector<PaymentRow>& rows,
+                    const Checkpoint& cursor, bool done, SettlementBatchResult& result,
+                    std::string& error);
+
+    AlipayConnectionPool& pool_;
+    SettlementBatchOptions options_;
+};
@@ -0,0 +1,111 @@
+#pragma once
+
+#include <string>
+#include <string_view>
+#include <optional>
+#include <cstdint>
+#include <cstring>
+#include <mysql/mysql.h>
+
+// 单行 VALUES 的值追加器，自动处理分隔符和转义
+class SqlRow {
+public:
+    SqlRow(MYSQL* conn, std::string& out) : conn_(conn), out_(out) {}
+
+    SqlRow& str(std::string_view value);
+    SqlRow& optStr(const std::optional<std::string>& value);
+    SqlRow& u64(uint64_t value);
+    SqlRow& optU64(const std::optional<uint64_t>& value);
+    SqlRow& i64(int64_t value);
+    SqlRow& null();
+    SqlRow& raw(std::string_view expression); // 原样追加（如 NOW()），调用方保证安全
+
+private:
+    void separator();
+
+    MYSQL* conn_;
+    std::string& out_;
+    bool first_ = true;
+};
+
+// 多行 INSERT 拼接器：按行累积 VALUES，超过字节上限时自动执行一次
+// 行数不固定的批量语句使用文本协议，避免按行数生成大量预处理语句
+class AlipayMultiRowInsert {
+public:
+    static constexpr size_t kDefaultMaxBytes = 1 << 20; // 远小于默认 max_allowed_packet
+
+    // prefix 形如 "INSERT INTO t (a, b) VALUES "，suffix 形如 " ON DUPLICATE KEY UPDATE ..."
+    AlipayMultiRowInsert(MYSQL* conn, std::string prefix, std::string suffix = "",
+                         size_t maxBytes = kDefaultMaxBytes);
+
+    // 开始新的一行；若已累积的语句超过上限会先执行，执行失败后 failed() 为真
+    SqlRow addRow();
+
+    // 执行累积的行，返回此前的执行是否全部成功
+    bool flush();
+
+    size_t pendingRows() const { return rows_; }
+    uint64_t affectedRows() const { return affected_rows_; }
+    unsigned int lastErrno() const { return last_errno_; }
+    const std::string& lastError() const { return last_error_; }
+    bool failed() const { return last_errno_ != 0; }
+
+private:
+    void reset();
+
+    MYSQL* conn_;
+    std::string prefix_;
+    std::string suffix_;
+    size_t max_bytes_;
+    std::string sql_;
+    size_t rows_ = 0;
+    uint64_t affected_rows_ = 0;
+    unsigned int last_errno_ = 0;
+    std::string last_error_;
+};
+
+// 在 SQL 中追加转义后的字符串字面量（含两侧引号）
+void appendSqlString(MYSQL* conn, std::string& out, std::string_view value);
+
+// 在 SQL 中追加无符号整数
+void appendSqlUInt(std::string& out, uint64_t value);
+
+// 预处理语句结果集的字符串列缓冲，N 为列定义的字符数（utf8mb4 每字符最多 4 字节）
+template <size_t N>
+struct StringResult {
+    char buffer[N * 4 + 1];
+    unsigned long length = 0;
+    my_bool is_null = 1;
+
+    void bind(MYSQL_BIND& bind) {
+        memset(&bind, 0, sizeof(bind));
+        bind.buffer_type = MYSQL_TYPE_STRING;
+        bind.buffer = buffer;
+        bind.buffer_length = sizeof(buffer);
+        bind.length = &length;
+        bind.is_null = &is_null;
+    }
+
+    std::string value() const { return is_null ? std::string() : std::string(buffer, length); }
+    std::optional<std::string> optional() const {
+        return is_null ? std::nullopt : std::optional<std::string>(value());
+    }
+};
+
+// 预处理语句结果集的无符号整数列
+struct UInt64Result {
+    uint64_t value = 0;
+    my_bool is_null = 1;
+
+    void bind(MYSQL_BIND& bind) {
+        memset(&bind, 0, sizeof(bind));
+        bind.buffer_type = MYSQL_TYPE_LONGLONG;
+        bind.buffer = &value;
+        bind.is_unsigned = true;
+        bind.is_null = &is_null;
+    }
+
+    std::optional<uint64_t> optional() const {
+        return is_null ? std::nullopt : std::optional<uint64_t>(value);
+    }
+};
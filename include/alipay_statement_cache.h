@@ -0,0 +1,84 @@
+#pragma once
+
+#include <string>
+#include <list>
+#include <unordered_map>
+#include <atomic>
+#include <cstdint>
+#include <mysql/mysql.h>
+
+// 预处理语句缓存统计
+struct StatementCacheStats {
+    uint64_t hits = 0;           // 命中次数
+    uint64_t misses = 0;         // 未命中（需 prepare）次数
+    uint64_t invalidations = 0;  // 因重连/语句失效而丢弃的语句数
+};
+
+// 单条连接上的预处理语句缓存，按 SQL 文本索引
+// 非线程安全：与所属连接一样，同一时刻只被一个借用者使用
+class AlipayStatementCache {
+public:
+    explicit AlipayStatementCache(size_t capacity = 64);
+    ~AlipayStatementCache();
+
+    AlipayStatementCache(const AlipayStatementCache&) = delete;
+    AlipayStatementCache& operator=(const AlipayStatementCache&) = delete;
+
+    // 取出已预处理的语句，未命中时 prepare 并缓存；失败返回 nullptr
+    MYSQL_STMT* acquire(MYSQL* conn, const std::string& sql);
+
+    // 丢弃单条语句（如执行时报语句失效）
+    void invalidate(MYSQL_STMT* stmt);
+
+    // 丢弃全部语句（连接重建后旧句柄均已失效）
+    void clear();
+
+    const std::string& lastError() const { return last_error_; }
+    unsigned int lastErrno() const { return last_errno_; }
+    size_t size() const { return entries_.size(); }
+    StatementCacheStats stats() const { return stats_; }
+
+    // 进程内所有连接的累计统计
+    static StatementCacheStats globalStats();
+
+private:
+    struct Entry {
+        std::string sql;
+        MYSQL_STMT* stmt;
+    };
+
+    size_t capacity_;
+    std::list<Entry> entries_;  // 队头为最近使用
+    std::unordered_map<std::string, std::list<Entry>::iterator> index_;
+    unsigned long thread_id_ = 0; // 语句所属的服务端会话，变化说明发生过重连
+    std::string last_error_;
+    unsigned int last_errno_ = 0;
+    StatementCacheStats stats_;
+
+    static std::atomic<uint64_t> global_hits_;
+    static std::atomic<uint64_t> global_misses_;
+    static std::atomic<uint64_t> global_invalidations_;
+};
+
+class PooledConnection;
+
+// 从连接的缓存借用一条语句（RAII），析构时释放结果集；
+// 语句失效时将其从缓存中移除，prepare 或执行遇到客户端错误（断线等）时
+// 清空缓存并把连接标记为损坏，归还时关闭而不放回池中
+class CachedStatement {
+public:
+    CachedStatement(PooledConnection& lease, const std::string& sql);
+    ~CachedStatement();
+
+    CachedStatement(const CachedStatement&) = delete;
+    CachedStatement& operator=(const CachedStatement&) = delete;
+
+    MYSQL_STMT* get() const { return stmt_; }
+    explicit operator bool() const { return stmt_ != nullptr; }
+    const char* error() const;
+
+private:
+    PooledConnection& lease_;
+    AlipayStatementCache* cache_;
+    MYSQL_STMT* stmt_;
+};
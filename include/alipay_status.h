@@ -0,0 +1,118 @@
+#pragma once
+
+#include <array>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <cstdint>
+
+// 持久化的状态枚举：库中以 TINYINT UNSIGNED 存储编码，C++ 中按整数比较；
+// 字符串名称只在对外协议（支付宝通知、对账单等）和日志中使用。
+// 编码写入数据库后不可修改，只允许追加新值；名称为空的编码表示未知值
+
+// 交易状态（alipay_payments.trade_status）
+enum class TradeStatus : uint8_t {
+    UNKNOWN = 0,
+    WAIT_BUYER_PAY = 1,     // 交易创建，等待买家付款
+    TRADE_SUCCESS = 2,      // 交易支付成功
+    TRADE_FINISHED = 3,     // 交易结束，不可退款
+    TRADE_CLOSED = 4        // 未付款交易超时关闭，或支付完成后全额退款
+};
+
+// 结算状态（alipay_settlements.status）
+enum class SettlementStatus : uint8_t {
+    UNKNOWN = 0,
+    PENDING = 1,            // 待结算
+    PROCESSING = 2,         // 结算中
+    SUCCESS = 3,            // 结算成功
+    FAILED = 4              // 结算失败
+};
+
+// 商户状态（alipay_merchants.status）
+enum class MerchantStatus : uint8_t {
+    UNKNOWN = 0,
+    ACTIVE = 1,             // 正常
+    SUSPENDED = 2,          // 暂停
+    CLOSED = 3              // 已注销
+};
+
+// 各枚举的名称表，下标即编码；TransactionStatus 的特化见 alipay_transaction_record.h
+template <typename E>
+struct StatusNames;
+
+template <>
+struct StatusNames<TradeStatus> {
+    static constexpr std::array<std::string_view, 5> names = {
+        "", "WAIT_BUYER_PAY", "TRADE_SUCCESS", "TRADE_FINISHED", "TRADE_CLOSED"};
+};
+
+template <>
+struct StatusNames<SettlementStatus> {
+    static constexpr std::array<std::string_view, 5> names = {
+        "", "PENDING", "PROCESSING", "SUCCESS", "FAILED"};
+};
+
+template <>
+struct StatusNames<MerchantStatus> {
+    static constexpr std::array<std::string_view, 4> names = {
+        "", "ACTIVE", "SUSPENDED", "CLOSED"};
+};
+
+template <typename E>
+constexpr uint8_t statusCode(E status) {
+    return static_cast<uint8_t>(status);
+}
+
+// 未知编码返回空串
+template <typename E>
+constexpr std::string_view statusName(E status) {
+    constexpr auto& names = StatusNames<E>::names;
+    uint8_t code = statusCode(status);
+    return code < names.size() ? names[code] : std::string_view();
+}
+
+template <typename E>
+constexpr std::optional<E> statusFromName(std::string_view name) {
+    constexpr auto& names = StatusNames<E>::names;
+    for (size_t code = 0; code < names.size(); ++code) {
+        if (!names[code].empty() && names[code] == name) return static_cast<E>(code);
+    }
+    return std::nullopt;
+}
+
+template <typename E>
+constexpr std::optional<E> statusFromCode(uint64_t code) {
+    constexpr auto& names = StatusNames<E>::names;
+    if (code >= names.size() || names[code].empty()) return std::nullopt;
+    return static_cast<E>(code);
+}
+
+// 把库中的编码列文本（mysql_fetch_row 的结果）转为枚举
+template <typename E>
+std::optional<E> statusFromField(const char* field) {
+    if (!field) return std::nullopt;
+    uint64_t code = 0;
+    for (const char* p = field; *p; ++p) {
+        if (*p < '0' || *p > '9') return std::nullopt;
+        code = code * 10 + static_cast<uint64_t>(*p - '0');
+    }
+    return statusFromCode<E>(code);
+}
+
+// 生成把字符串列映射为编码的 SQL 表达式，供在线迁移回填使用；
+// 未知值映射为 unknownCode（须为名称表之外或名称为空的编码）
+template <typename E>
+std::string statusCodeCaseSql(std::string_view column, uint8_t unknownCode = 0) {
+    constexpr auto& names = StatusNames<E>::names;
+    std::string sql = "CASE ";
+    sql += column;
+    for (size_t code = 0; code < names.size(); ++code) {
+        if (names[code].empty()) continue;
+        sql += " WHEN '";
+        sql += names[code];
+        sql += "' THEN ";
+        sql += std::to_string(code);
+    }
+    sql += " ELSE " + std::to_string(unknownCode) + " END";
+    return sql;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <cstdint>
+
+// 分层时间轮，以秒为刻度，键为字符串（如商户订单号）
+// 插入、取消均为 O(1)：节点存放在连续数组中，以下标串成槽内双向链表，
+// 键到节点的映射用哈希表；非线程安全，由调用方加锁
+class AlipayTimingWheel {
+public:
+    // 第 0 层 256 槽（每槽 1 秒），第 1~3 层各 64 槽，总跨度约 2 年
+    static constexpr int kLevels = 4;
+    static constexpr int kRootBits = 8;
+    static constexpr int kLevelBits = 6;
+    static constexpr uint64_t kMaxSpan = uint64_t(1) << (kRootBits + kLevelBits * (kLevels - 1));
+
+    explicit AlipayTimingWheel(uint64_t startTick);
+
+    // 安排 key 在 deadline 到期；已存在时改为新的到期时间
+    void schedule(const std::string& key, uint64_t deadline);
+
+    // 取消定时器，不存在时返回 false
+    bool cancel(const std::string& key);
+
+    // 推进到 now（含），把到期的键追加到 expired
+    void advance(uint64_t now, std::vector<std::string>& expired);
+
+    size_t size() const { return index_.size(); }
+    uint64_t currentTick() const { return current_; }
+
+private:
+    static constexpr uint32_t kNil = UINT32_MAX;
+    static constexpr uint32_t kRootSlots = 1u << kRootBits;
+    static constexpr uint32_t kLevelSlots = 1u << kLevelBits;
+    static constexpr uint32_t kSlotCount = kRootSlots + kLevelSlots * (kLevels - 1);
+
+    struct Node {
+        std::string key;
+        uint64_t deadline = 0;
+        uint32_t prev = kNil;
+        uint32_t next = kNil;
+        uint32_t slot = kNil;   // 所在槽位，kNil 表示空闲节点
+    };
+
+    uint32_t slotFor(uint64_t deadline) const;
+    void link(uint32_t node);
+    void unlink(uint32_t node);
+    uint32_t allocate();
+    void release(uint32_t node);
+    void cascade(int level);
+
+    uint64_t current_;                      // 下一个待处理的刻度
+    std::vector<Node> nodes_;
+    uint32_t free_head_ = kNil;             // 空闲节点链表（复用 next 字段）
+    std::array<uint32_t, kSlotCount> heads_;
+    std::unordered_map<std::string, uint32_t> index_;
+};
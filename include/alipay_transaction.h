@@ -1,7 +1,10 @@
 #pragma once
 
 #include <string>
+#include <vector>
+#include <atomic>
 #include <mysql/mysql.h>
+#include "alipay_connection_pool.h"
 
 class AlipayTransaction {
 public:
@@ -11,20 +14,79 @@ public:
     // 数据库连接
     bool connectDB(const char* host, const char* user, 
                   const char* password, const char* db);
+    bool connectDB(AlipayConnectionPool& pool); // 从连接池借用连接
 
-    // XA事务操作
+    // 加入另一个资源管理器（如结算库），从其连接池借用连接；
+    // 事务已开始时立即在该连接上 XA START
+    bool addParticipant(const std::string& name, AlipayConnectionPool& pool);
+
+    // XA事务操作（依次作用于所有分支）
     bool beginTransaction(const std::string& xid);
     bool prepareTransaction();
     bool commitTransaction();
     bool rollbackTransaction();
+    // 只有一个资源管理器时免去 XA PREPARE：XA END 后直接 XA COMMIT ... ONE PHASE
+    bool commitOnePhase();
+
+    // 单个分支的操作，不同分支可在不同线程上并发调用；
+    // 已提交或已回滚的分支再次提交/回滚直接返回成功，便于重试
+    bool prepareBranch(size_t index);
+    bool commitBranch(size_t index);
+    bool rollbackBranch(size_t index);
+    bool hasCommittedBranch() const;
+    // 一阶段提交因连接中断失败，服务端可能已提交，不能再回滚
+    bool outcomeUnknown() const;
+
+    // 完成与中止互斥：准备或提交前先 claimCompletion()，超时回收前先 tryAbort()，
+    // 两者只有先到者成功；中止后所有连接在析构时关闭而不归还连接池
+    bool claimCompletion();
+    bool tryAbort();
+    bool aborted() const { return completion_.load() == kAborted; }
+    // 分支连接的 MySQL 线程 ID，用于从其他连接 KILL
+    unsigned long connectionId(size_t index) const { return branches_[index].thread_id; }
+
+    // 参与本事务的资源管理器（数据库连接）数
+    size_t resourceManagerCount() const { return branches_.size(); }
+    const std::string& participantName(size_t index) const { return branches_[index].name; }
 
-    // 获取数据库连接
+    // 获取数据库连接（第一个资源管理器）
     MYSQL* getConnection() const { return conn; }
+    const std::string& getXID() const { return current_xid_; }
     
     // 生成XID
     static std::string generateXID(const std::string& prefix);
 
 private:
-    MYSQL* conn;
+    enum class BranchState {
+        IDLE,           // 未开始
+        ACTIVE,         // 已 XA START
+        ENDED,          // 已 XA END
+        PREPARED,       // 已 XA PREPARE
+        COMMITTED,      // 已提交
+        ROLLED_BACK,    // 已回滚
+        UNKNOWN         // 一阶段提交时连接中断，结果未知
+    };
+
+    // 一个资源管理器上的 XA 分支；首个分支沿用不带 bqual 的 XID，其余以参与者名称作 bqual
+    struct Branch {
+        std::string name;
+        PooledConnection lease;
+        MYSQL* conn = nullptr;
+        unsigned long thread_id = 0;
+        BranchState state = BranchState::IDLE;
+    };
+
+    static constexpr int kOpen = 0;
+    static constexpr int kCompleting = 1;
+    static constexpr int kAborted = 2;
+
+    std::string branchXid(size_t index) const;
+    bool startBranch(Branch& branch, const std::string& xid);
+    bool endBranch(size_t index);
+    bool execute(size_t index, const std::string& statement);
+
+    std::vector<Branch> branches_;
+    MYSQL* conn;             // 首个分支的连接
     std::string current_xid_;
-}; 
\ No newline at end of file
+    std::atomic<int> completion_{kOpen};
+}; 
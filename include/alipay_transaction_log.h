@@ -0,0 +1,78 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include "alipay_connection_pool.h"
+#include "alipay_transaction_record.h"
+
+// 组提交配置：批次达到 max_batch 条或最早一条已等待 max_wait_us 时落库，
+// 调大两者以时延换吞吐
+struct TransactionLogOptions {
+    size_t max_batch = 128;
+    uint64_t max_wait_us = 1000;
+};
+
+// 组提交统计
+struct TransactionLogStats {
+    uint64_t batches = 0;       // 已写入的批次数
+    uint64_t records = 0;       // 已写入的记录数
+    uint64_t failed_batches = 0;
+};
+
+// 事务日志组提交：并发事务的状态变更排队合并，由写线程以一条多行
+// INSERT ... ON DUPLICATE KEY UPDATE 写入 alipay_transactions，同批的等待者一起被唤醒
+class AlipayTransactionLogWriter {
+public:
+    explicit AlipayTransactionLogWriter(AlipayConnectionPool& pool,
+                                        const TransactionLogOptions& options = TransactionLogOptions());
+    ~AlipayTransactionLogWriter();
+
+    AlipayTransactionLogWriter(const AlipayTransactionLogWriter&) = delete;
+    AlipayTransactionLogWriter& operator=(const AlipayTransactionLogWriter&) = delete;
+
+    // 追加一条事务记录（首次写入或状态变更），阻塞到所在批次落库，返回是否写入成功
+    bool append(const TransactionRecord& record);
+    // 非阻塞版本
+    std::shared_future<bool> appendAsync(const TransactionRecord& record);
+
+    // 修改配置，对之后开启的批次生效
+    void setOptions(const TransactionLogOptions& options);
+    TransactionLogStats stats() const;
+
+    // 写完已排队的记录后停止写线程；之后的 append 直接返回失败
+    void stop();
+
+private:
+    struct LogBatch {
+        std::vector<TransactionRecord> records;
+        std::chrono::steady_clock::time_point opened;
+        size_t capacity = 0;
+        std::promise<bool> promise;
+        std::shared_future<bool> done;
+    };
+
+    void run();
+    bool write(const std::vector<TransactionRecord>& records);
+
+    AlipayConnectionPool& pool_;
+    TransactionLogOptions options_;
+
+    mutable std::mutex mutex_;
+    std::condition_variable pending_;
+    std::deque<std::shared_ptr<LogBatch>> batches_; // 队尾为正在接收记录的批次
+    bool stopping_ = false;
+    std::thread writer_;
+
+    std::atomic<uint64_t> batches_written_{0};
+    std::atomic<uint64_t> records_written_{0};
+    std::atomic<uint64_t> failed_batches_{0};
+};
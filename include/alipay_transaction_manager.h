@@ -1,60 +1,181 @@
 #pragma once
 
 #include "alipay_transaction.h"
+#include "alipay_connection_pool.h"
+#include "alipay_transaction_record.h"
+#include "alipay_transaction_log.h"
+#include "alipay_transaction_wal.h"
+#include "alipay_work_stealing_pool.h"
 #include <unordered_map>
+#include <unordered_set>
+#include <queue>
+#include <condition_variable>
+#include <array>
 #include <mutex>
 #include <memory>
 #include <vector>
+#include <future>
+#include <functional>
+#include <thread>
+#include <atomic>
 
-// 事务状态
-enum class TransactionStatus {
-    INIT,           // 初始状态
-    STARTED,        // 已开始
-    PREPARED,       // 已准备
-    COMMITTED,      // 已提交
-    ROLLED_BACK,    // 已回滚
-    FAILED          // 失败
+// 事务恢复进度
+struct TransactionRecoveryStats {
+    bool running = false;
+    uint64_t scanned = 0;       // 读到的未结束事务数
+    uint64_t committed = 0;     // 裁决为提交
+    uint64_t rolled_back = 0;   // 裁决为回滚
+    uint64_t one_phase = 0;     // 一阶段提交的事务，结果由资源管理器决定，无需裁决（记为 FAILED）
+    uint64_t orphans = 0;       // 只在 XA RECOVER 中出现的分支，按推定回滚处理
+    uint64_t unresolved = 0;    // 资源管理器未注册或不可达，留在活动表中待下次恢复
 };
 
-// 事务记录
-struct TransactionRecord {
-    std::string xid;
-    TransactionStatus status;
-    uint64_t create_time;
-    uint64_t update_time;
-    std::string order_no;
-    std::vector<std::string> participants; // 参与者列表
+// 超时回收与清理配置
+struct TransactionReaperOptions {
+    uint64_t timeout_ms = 60000;            // 事务从开始到进入准备阶段的最长时间
+    uint64_t retention_s = 7 * 86400;       // 已结束事务在事务表中的保留时间，0 表示不自动清理
+    uint64_t cleanup_interval_s = 600;      // 自动清理的间隔
+    size_t cleanup_chunk_size = 1000;       // 每条 DELETE 覆盖的主键区间行数
+};
+
+// 超时回收与清理统计
+struct TransactionReaperStats {
+    uint64_t reaped = 0;        // 超时被回滚的事务数
+    uint64_t purged = 0;        // 从事务表删除的已结束事务数
 };
 
 class AlipayTransactionManager {
 public:
     static AlipayTransactionManager& getInstance();
 
-    // 事务操作
+    // 事务操作：由管理器驱动 XA 分支。只有一个资源管理器的事务走一阶段提交，
+    // prepareTransaction 不发 XA PREPARE、不写日志，commitTransaction 直接 XA COMMIT ... ONE PHASE
     bool startTransaction(const std::string& orderNo, 
                         std::shared_ptr<AlipayTransaction>& transaction);
     bool prepareTransaction(const std::string& xid);
     bool commitTransaction(const std::string& xid);
     bool rollbackTransaction(const std::string& xid);
 
-    // 事务恢复
+    // 事务恢复：后台线程按 xid 分批流式读取未结束的事务，对照各资源管理器的 XA RECOVER，
+    // 在 I/O 线程池上并发裁决（PREPARED 提交，其余回滚）；立即返回，恢复期间照常接受新事务
     void recoverTransactions();
-    void cleanupTransactions(uint64_t beforeTime);
+    void waitForRecovery();
+    TransactionRecoveryStats recoveryStats() const;
+
+    // 按主键顺序分块删除 update_time 早于 beforeTime 的已结束事务，每块一条短语句；
+    // 返回删除的行数。启用 WAL 时只触发一次段压缩
+    uint64_t cleanupTransactions(uint64_t beforeTime);
+
+    // 超时回收：开始时间超过 timeout_ms 仍未进入准备阶段的事务，KILL 其分支连接（MySQL 随之回滚并释放行锁）
+    // 并记为 ROLLED_BACK；已进入准备或提交的事务不受影响。后台线程同时按 retention_s 定期清理事务表
+    void setReaperOptions(const TransactionReaperOptions& options);
+    TransactionReaperStats reaperStats() const;
 
     // 事务状态查询
     TransactionStatus getTransactionStatus(const std::string& xid);
+    // 活动表中未结束的事务（含恢复中的）
     std::vector<TransactionRecord> getPendingTransactions();
 
+    // 事务日志组提交配置与统计
+    void setLogOptions(const TransactionLogOptions& options);
+    TransactionLogStats logStats() const;
+
+    // 改用本地 WAL 保存事务状态（不再写 alipay_transactions），须在开始第一个事务前调用；
+    // 之后 recoverTransactions() 从 WAL 重放
+    bool enableWal(const TransactionWalOptions& options, std::string& error);
+
+    // 注册另一个资源管理器（如结算库），之后开始的事务都在其上开一个 XA 分支，
+    // 各分支的 XA PREPARE / XA COMMIT 在 I/O 线程池上并发执行；须在开始第一个事务前调用
+    bool addParticipant(const std::string& name, AlipayConnectionPool& pool);
+
 private:
     AlipayTransactionManager();
     ~AlipayTransactionManager();
 
-    // 事务表操作
-    bool createTransactionTable();
+    // 事务表操作，经组提交写入
     bool saveTransactionRecord(const TransactionRecord& record);
-    bool updateTransactionStatus(const std::string& xid, TransactionStatus status);
+    bool updateTransactionStatus(const TransactionRecord& record, TransactionStatus status);
+
+    // 活动事务按 XID 哈希分片，每个分片一把锁；锁内只做内存操作，数据库读写都在锁外
+    static constexpr size_t kShardCount = 64;
+    struct ActiveTransaction {
+        TransactionRecord record;
+        std::shared_ptr<AlipayTransaction> transaction; // 恢复出的事务没有 XA 分支对象
+    };
+    struct alignas(64) TransactionShard {
+        std::mutex mutex;
+        std::unordered_map<std::string, ActiveTransaction> transactions;
+    };
+
+    // 恢复：各资源管理器上处于 PREPARED 的分支，键为 gtrid + '\n' + bqual；下标 0 为本库，i + 1 为 participants_[i]
+    using PreparedBranches = std::unordered_set<std::string>;
+    void runRecovery();
+    bool loadPreparedBranches(AlipayConnectionPool& pool, PreparedBranches& branches);
+    bool fetchRecoveryChunk(MYSQL* conn, TransactionStatus status, std::string& afterXid,
+                            std::vector<TransactionRecord>& records);
+    void dispatchRecoveryChunk(std::vector<TransactionRecord>& records,
+                               std::vector<std::future<void>>& inflight);
+    void resolveRecord(const TransactionRecord& record);
+    bool resolveBranch(size_t rm, const std::string& gtrid, const std::string& bqual, bool commit);
+    void resolveOrphans();
 
-    std::mutex mutex_;
-    std::unordered_map<std::string, TransactionRecord> active_transactions_;
-    MYSQL* conn_;
-}; 
\ No newline at end of file
+    // 超时回收线程
+    struct Deadline {
+        uint64_t at_ms;         // steadyNowMs() 时间
+        std::string xid;
+        uint32_t attempts = 0;  // 未能 KILL 全部分支而重试的次数
+        bool operator>(const Deadline& other) const { return at_ms > other.at_ms; }
+    };
+    void scheduleDeadline(const std::string& xid);
+    void runReaper();
+    void reap(const Deadline& deadline);
+
+    AlipayConnectionPool* participantPool(const std::string& name);
+
+    // 对事务的每个分支执行 operation 并等待全部完成，全部成功才返回 true
+    bool forEachBranch(AlipayTransaction& transaction,
+                       const std::function<bool(size_t)>& operation);
+
+    TransactionShard& shardFor(const std::string& xid);
+    // 取出活动事务的副本，不存在时返回 false
+    bool findTransaction(const std::string& xid, ActiveTransaction& active);
+    void setStatus(const std::string& xid, TransactionStatus status);
+    void erase(const std::string& xid);
+
+    std::array<TransactionShard, kShardCount> active_transactions_;
+    AlipayConnectionPool& pool_; // 事务日志与 XA 分支均从连接池借用连接
+    AlipayTransactionLogWriter log_;
+    std::unique_ptr<AlipayTransactionWal> wal_; // 启用后取代 log_
+
+    struct Participant {
+        std::string name;               // 同时作为该分支 XID 的 bqual
+        AlipayConnectionPool* pool;
+    };
+    static constexpr size_t kIoWorkers = 16;
+    std::vector<Participant> participants_;
+    std::unique_ptr<AlipayWorkStealingPool> io_pool_; // 分支并发提交与恢复裁决共用
+
+    static constexpr size_t kRecoveryChunkSize = 500;
+    std::thread recovery_thread_;
+    std::string recovery_cutoff_xid_;   // 本进程生成的 XID 都大于它，恢复只裁决此前生成的事务（含旧版本格式）
+    std::atomic<bool> recovery_running_{false};
+    std::atomic<bool> stopping_{false};
+    std::mutex prepared_mutex_;
+    std::vector<PreparedBranches> prepared_;
+    std::atomic<uint64_t> recovery_scanned_{0};
+    std::atomic<uint64_t> recovery_committed_{0};
+    std::atomic<uint64_t> recovery_rolled_back_{0};
+    std::atomic<uint64_t> recovery_one_phase_{0};
+    std::atomic<uint64_t> recovery_orphans_{0};
+    std::atomic<uint64_t> recovery_unresolved_{0};
+
+    // 截止时间小顶堆；事务正常结束时不删除，出堆时发现已不在活动表中即跳过
+    std::mutex reaper_mutex_;
+    std::condition_variable reaper_wakeup_;
+    std::priority_queue<Deadline, std::vector<Deadline>, std::greater<Deadline>> deadlines_;
+    TransactionReaperOptions reaper_options_;
+    bool reaper_stopping_ = false;
+    std::atomic<uint64_t> reaped_{0};
+    std::atomic<uint64_t> purged_{0};
+    std::thread reaper_thread_;
+};
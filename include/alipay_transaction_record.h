@@ -0,0 +1,45 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include "alipay_status.h"
+
+// 事务状态，编码（枚举值）同时用于 alipay_transactions.status 和 WAL 记录
+enum class TransactionStatus : uint8_t {
+    INIT,           // 初始状态
+    STARTED,        // 已开始
+    PREPARED,       // 已准备
+    COMMITTED,      // 已提交
+    ROLLED_BACK,    // 已回滚
+    FAILED          // 失败
+};
+
+template <>
+struct StatusNames<TransactionStatus> {
+    static constexpr std::array<std::string_view, 6> names = {
+        "INIT", "STARTED", "PREPARED", "COMMITTED", "ROLLED_BACK", "FAILED"};
+};
+
+// participants 的首项记录提交路径，其后为参与者名称
+constexpr const char* kCommitPathOnePhase = "ONE_PHASE"; // 单个资源管理器，XA COMMIT ... ONE PHASE
+constexpr const char* kCommitPathTwoPhase = "TWO_PHASE"; // 多个资源管理器，完整两阶段提交
+
+// 事务记录
+struct TransactionRecord {
+    std::string xid;
+    TransactionStatus status;
+    uint64_t create_time;
+    uint64_t update_time;
+    std::string order_no;
+    std::vector<std::string> participants; // 提交路径 + 参与者列表
+};
+
+// 是否走一阶段提交
+inline bool isOnePhaseCommit(const TransactionRecord& record) {
+    return !record.participants.empty() && record.participants.front() == kCommitPathOnePhase;
+}
+
+// 事务状态与字符串互转
+const char* transactionStatusToString(TransactionStatus status);
+TransactionStatus transactionStatusFromString(const std::string& status);
@@ -0,0 +1,108 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <unordered_map>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <future>
+#include <atomic>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+#include "alipay_transaction_record.h"
+
+// 本地 WAL 配置
+struct TransactionWalOptions {
+    std::string directory;                  // 段文件目录，须已存在
+    size_t segment_bytes = 64 << 20;        // 段文件超过该大小后切换新段
+    size_t max_batch = 128;                 // 每次 fdatasync 最多合并的记录数
+    uint64_t max_wait_us = 1000;            // 批次最长等待时间
+
+    // 崩溃点注入，仅供测试：在各关键步骤以步骤名调用
+    std::function<void(const char* point)> crash_hook;
+};
+
+// WAL 统计
+struct TransactionWalStats {
+    uint64_t records = 0;       // 已落盘的记录数
+    uint64_t syncs = 0;         // fdatasync 次数
+    uint64_t rotations = 0;     // 段切换次数
+    uint64_t live = 0;          // 未结束的事务数
+};
+
+// 事务协调者的本地预写日志：只追加、按段切换，每条记录带长度和 CRC32C 校验；
+// 并发追加合并为一次 write + fdatasync。
+// 切换新段时先写入全部未结束事务的快照，新段落盘后旧段即可删除（压缩）。
+// 打开时按顺序重放各段，最后一段末尾的残缺记录（崩溃时未写完）被截断
+class AlipayTransactionWal {
+public:
+    explicit AlipayTransactionWal(const TransactionWalOptions& options);
+    ~AlipayTransactionWal();
+
+    AlipayTransactionWal(const AlipayTransactionWal&) = delete;
+    AlipayTransactionWal& operator=(const AlipayTransactionWal&) = delete;
+
+    // 重放已有段并切换到新段，之后才可追加
+    bool open(std::string& error);
+    void close();
+
+    // 追加一条状态变更，阻塞到所在批次 fdatasync 完成
+    bool append(const TransactionRecord& record);
+    std::shared_future<bool> appendAsync(const TransactionRecord& record);
+
+    // 未结束（非 COMMITTED/ROLLED_BACK/FAILED）的事务的最新状态
+    std::vector<TransactionRecord> liveTransactions() const;
+
+    // 请求在下一次落盘时切换新段并删除旧段
+    void compact();
+
+    TransactionWalStats stats() const;
+
+    static bool isTerminal(TransactionStatus status);
+
+private:
+    struct WalBatch {
+        std::string bytes;
+        std::vector<TransactionRecord> records;
+        std::chrono::steady_clock::time_point opened;
+        size_t capacity = 0;
+        std::promise<bool> promise;
+        std::shared_future<bool> done;
+    };
+
+    std::string segmentPath(uint64_t sequence) const;
+    bool replaySegment(uint64_t sequence, bool last, std::string& error);
+    bool startSegment(uint64_t sequence, std::string& error);
+    bool rotate(std::string& error);
+    bool writeAll(const char* data, size_t size);
+    bool truncateTail();
+    void applyLive(const TransactionRecord& record);
+    void crashPoint(const char* point) const;
+    void run();
+
+    TransactionWalOptions options_;
+
+    int fd_ = -1;
+    uint64_t sequence_ = 0;                 // 当前段序号
+    uint64_t segment_size_ = 0;             // 当前段已落盘的字节数
+    bool tail_dirty_ = false;               // 写入失败后当前段末尾可能有残缺记录，仅写线程访问
+    std::vector<uint64_t> sealed_;          // 可在新段落盘后删除的旧段
+
+    mutable std::mutex live_mutex_;
+    std::unordered_map<std::string, TransactionRecord> live_;
+
+    std::mutex mutex_;
+    std::condition_variable pending_;
+    std::deque<std::shared_ptr<WalBatch>> batches_; // 队尾为正在接收记录的批次
+    bool stopping_ = false;
+    bool compact_requested_ = false;
+    std::thread flusher_;
+
+    std::atomic<uint64_t> records_{0};
+    std::atomic<uint64_t> syncs_{0};
+    std::atomic<uint64_t> rotations_{0};
+};
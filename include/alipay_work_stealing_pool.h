@@ -0,0 +1,63 @@
+#pragma once
+
+#include <deque>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <condition_variable>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <cstdint>
+
+// 工作窃取线程池统计
+struct WorkStealingStats {
+    uint64_t executed = 0;  // 已执行的任务数
+    uint64_t stolen = 0;    // 其中从其他线程队列窃取的任务数
+};
+
+// 工作窃取线程池：每个工作线程有自己的双端队列，从队尾取自己的任务，
+// 空闲时从其他线程的队头窃取；任务参数为执行它的工作线程编号，便于使用按线程划分的资源（如连接）
+class AlipayWorkStealingPool {
+public:
+    using Task = std::function<void(size_t worker)>;
+
+    explicit AlipayWorkStealingPool(size_t workers);
+    ~AlipayWorkStealingPool();
+
+    AlipayWorkStealingPool(const AlipayWorkStealingPool&) = delete;
+    AlipayWorkStealingPool& operator=(const AlipayWorkStealingPool&) = delete;
+
+    // 提交任务（轮流放入各工作线程的队列），可在任务内部调用
+    void submit(Task task);
+
+    // 阻塞直到已提交的任务（包括执行期间新提交的）全部完成
+    void wait();
+
+    size_t workerCount() const { return workers_.size(); }
+    WorkStealingStats stats() const;
+
+private:
+    // 每个工作线程的队列独占缓存行
+    struct alignas(64) Worker {
+        std::mutex mutex;
+        std::deque<Task> tasks;
+        std::atomic<uint64_t> executed{0};
+        std::atomic<uint64_t> stolen{0};
+    };
+
+    bool popLocal(size_t index, Task& task);
+    bool steal(size_t index, Task& task);
+    void run(size_t index);
+
+    std::vector<std::unique_ptr<Worker>> workers_;
+    std::vector<std::thread> threads_;
+
+    std::mutex mutex_;                      // 配合条件变量使用
+    std::condition_variable work_available_;
+    std::condition_variable all_done_;
+    std::atomic<size_t> queued_{0};         // 队列中尚未被取走的任务数
+    std::atomic<size_t> pending_{0};        // 已提交但尚未执行完的任务数
+    std::atomic<size_t> next_worker_{0};
+    bool stopping_ = false;
+};
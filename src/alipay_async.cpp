@@ -0,0 +1,391 @@
+#include "alipay_async.h"
+#include <climits>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+
+namespace {
+
+// spawn 使用的包装协程：启动后不再有人等待，结束时自行销毁
+struct DetachedTask {
+    struct promise_type {
+        DetachedTask get_return_object() {
+            return DetachedTask{std::coroutine_handle<promise_type>::from_promise(*this)};
+        }
+        std::suspend_always initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() {}
+    };
+    std::coroutine_handle<promise_type> handle;
+};
+
+DetachedTask runDetached(AsyncTask<void> task) {
+    try {
+        co_await task;
+    }
+    catch (...) {
+        // 任务自行处理错误，这里只防止异常逃逸
+    }
+}
+
+constexpr int kMaxEvents = 64;
+
+} // namespace
+
+// AlipayEventLoop 实现
+AlipayEventLoop::AlipayEventLoop() {
+    epoll_fd_ = epoll_create1(EPOLL_CLOEXEC);
+    event_fd_ = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+
+    epoll_event event{};
+    event.events = EPOLLIN;
+    event.data.ptr = nullptr; // 空指针表示跨线程唤醒
+    epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, event_fd_, &event);
+}
+
+AlipayEventLoop::~AlipayEventLoop() {
+    if (event_fd_ >= 0) close(event_fd_);
+    if (epoll_fd_ >= 0) close(epoll_fd_);
+}
+
+void AlipayEventLoop::stop() {
+    stopping_.store(true);
+    uint64_t one = 1;
+    if (write(event_fd_, &one, sizeof(one)) < 0) {}
+}
+
+void AlipayEventLoop::post(std::coroutine_handle<> handle) {
+    bool wake;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake = posted_.empty();
+        posted_.push_back(handle);
+    }
+    // 队列非空时循环已被唤醒过，不必重复写 eventfd
+    if (wake) {
+        uint64_t one = 1;
+        if (write(event_fd_, &one, sizeof(one)) < 0) {}
+    }
+}
+
+void AlipayEventLoop::spawn(AsyncTask<void> task) {
+    post(runDetached(std::move(task)).handle);
+}
+
+void AlipayEventLoop::runPosted() {
+    std::vector<std::coroutine_handle<>> ready;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready.swap(posted_);
+    }
+    for (auto handle : ready) {
+        handle.resume();
+    }
+}
+
+void AlipayEventLoop::arm(AsyncMysqlWait& wait) {
+    epoll_event event{};
+    event.data.ptr = &wait;
+    event.events = EPOLLONESHOT;
+    if (wait.status & MYSQL_WAIT_READ) event.events |= EPOLLIN;
+    if (wait.status & MYSQL_WAIT_WRITE) event.events |= EPOLLOUT;
+    if (wait.status & MYSQL_WAIT_EXCEPT) event.events |= EPOLLPRI;
+
+    // 建连过程中套接字可能更换（如重试其他地址）
+    int fd = mysql_get_socket(wait.conn);
+    if (fd != wait.fd) {
+        if (wait.fd >= 0) epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, wait.fd, nullptr);
+        epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &event);
+        wait.fd = fd;
+    } else {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, fd, &event);
+    }
+
+    if (wait.status & MYSQL_WAIT_TIMEOUT) {
+        wait.timer = timers_.emplace(steadyNowMs() + mysql_get_timeout_value_ms(wait.conn), &wait);
+        wait.has_timer = true;
+    }
+}
+
+void AlipayEventLoop::forget(AsyncMysqlWait& wait) {
+    if (wait.has_timer) {
+        timers_.erase(wait.timer);
+        wait.has_timer = false;
+    }
+    if (wait.fd >= 0) {
+        epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, wait.fd, nullptr);
+        wait.fd = -1;
+    }
+    // 本轮 epoll_wait 返回的事件中可能还有它，标记为跳过
+    for (int i = 0; i < batch_size_; ++i) {
+        if (batch_[i].data.ptr == &wait) batch_[i].data.ptr = this;
+    }
+}
+
+void AlipayEventLoop::dispatch(AsyncMysqlWait& wait, int ready) {
+    if (wait.has_timer) {
+        timers_.erase(wait.timer);
+        wait.has_timer = false;
+    }
+    if (!wait.waiter) return; // 上一次调用遗留的事件
+
+    wait.status = wait.cont(ready);
+    if (wait.status != 0) {
+        arm(wait);
+        return;
+    }
+    wait.cont = nullptr;
+    std::exchange(wait.waiter, {}).resume();
+}
+
+void AlipayEventLoop::run() {
+    epoll_event events[kMaxEvents];
+    while (!stopping_.load()) {
+        int timeout = -1;
+        if (!timers_.empty()) {
+            uint64_t now = steadyNowMs();
+            uint64_t first = timers_.begin()->first;
+            timeout = first > now ? static_cast<int>(std::min<uint64_t>(first - now, INT_MAX)) : 0;
+        }
+
+        int count = epoll_wait(epoll_fd_, events, kMaxEvents, timeout);
+        batch_ = events;
+        batch_size_ = count > 0 ? count : 0;
+        for (int i = 0; i < batch_size_; ++i) {
+            void* ptr = events[i].data.ptr;
+            if (ptr == nullptr) {
+                uint64_t value;
+                if (read(event_fd_, &value, sizeof(value)) < 0) {}
+                runPosted();
+                continue;
+            }
+            if (ptr == this) continue; // 已关闭的连接
+
+            // 错误和挂断交给 *_cont 读取时报告
+            int ready = 0;
+            if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) ready |= MYSQL_WAIT_READ;
+            if (events[i].events & EPOLLOUT) ready |= MYSQL_WAIT_WRITE;
+            if (events[i].events & EPOLLPRI) ready |= MYSQL_WAIT_EXCEPT;
+            dispatch(*static_cast<AsyncMysqlWait*>(ptr), ready);
+        }
+        batch_size_ = 0;
+
+        uint64_t now = steadyNowMs();
+        while (!timers_.empty() && timers_.begin()->first <= now) {
+            AsyncMysqlWait& wait = *timers_.begin()->second;
+            timers_.erase(timers_.begin());
+            wait.has_timer = false;
+
+            // 超时后不再关心这次的套接字事件
+            epoll_event event{};
+            event.data.ptr = &wait;
+            epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, wait.fd, &event);
+            dispatch(wait, MYSQL_WAIT_TIMEOUT);
+        }
+    }
+}
+
+// AlipayAsyncConnection 实现
+class AlipayAsyncConnection::Call {
+public:
+    Call(AlipayAsyncConnection& conn, int status, std::function<int(int)> cont)
+        : conn_(conn), status_(status), cont_(std::move(cont)) {}
+
+    bool await_ready() const noexcept { return status_ == 0; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        AsyncMysqlWait& wait = conn_.wait_;
+        wait.status = status_;
+        wait.cont = std::move(cont_);
+        wait.waiter = handle;
+        conn_.loop_.arm(wait);
+    }
+    void await_resume() const noexcept {}
+
+private:
+    AlipayAsyncConnection& conn_;
+    int status_;
+    std::function<int(int)> cont_;
+};
+
+AlipayAsyncConnection::AlipayAsyncConnection(AlipayEventLoop& loop) : loop_(loop) {}
+
+AlipayAsyncConnection::~AlipayAsyncConnection() {
+    if (conn_) {
+        loop_.forget(wait_);
+        mysql_close(conn_);
+    }
+}
+
+void AlipayAsyncConnection::checkError() {
+    // 2000 以上为客户端错误（断线、超时等），连接不可再用
+    if (mysql_errno(conn_) >= 2000) {
+        broken_ = true;
+    }
+}
+
+AsyncTask<bool> AlipayAsyncConnection::connect(const ConnectionPoolConfig& config) {
+    conn_ = mysql_init(nullptr);
+    if (!conn_) {
+        broken_ = true;
+        co_return false;
+    }
+    wait_.conn = conn_;
+
+    mysql_options(conn_, MYSQL_OPT_NONBLOCK, nullptr);
+    unsigned int timeout = config.connect_timeout_s;
+    if (timeout > 0) {
+        mysql_options(conn_, MYSQL_OPT_CONNECT_TIMEOUT, &timeout);
+    }
+    mysql_options(conn_, MYSQL_SET_CHARSET_NAME, config.charset.c_str());
+
+    MYSQL* connected = nullptr;
+    co_await Call(*this,
+        mysql_real_connect_start(&connected, conn_, config.host.c_str(), config.user.c_str(),
+                                 config.password.c_str(), config.db.c_str(), config.port,
+                                 nullptr, 0),
+        [this, &connected](int ready) { return mysql_real_connect_cont(&connected, conn_, ready); });
+
+    if (!connected) {
+        broken_ = true;
+        co_return false;
+    }
+    co_return true;
+}
+
+AsyncTask<bool> AlipayAsyncConnection::execute(std::string sql) {
+    MYSQL_RES* result = co_await select(std::move(sql));
+    if (result) {
+        mysql_free_result(result);
+    }
+    co_return mysql_errno(conn_) == 0;
+}
+
+AsyncTask<MYSQL_RES*> AlipayAsyncConnection::select(std::string sql) {
+    if (!conn_ || broken_) co_return nullptr;
+
+    int error = 0;
+    co_await Call(*this,
+        mysql_real_query_start(&error, conn_, sql.data(), static_cast<unsigned long>(sql.size())),
+        [this, &error](int ready) { return mysql_real_query_cont(&error, conn_, ready); });
+    if (error) {
+        checkError();
+        co_return nullptr;
+    }
+    affected_rows_ = mysql_affected_rows(conn_);
+
+    // 没有结果集的语句（INSERT/UPDATE 等）
+    if (mysql_field_count(conn_) == 0) co_return nullptr;
+
+    MYSQL_RES* result = nullptr;
+    co_await Call(*this, mysql_store_result_start(&result, conn_),
+        [this, &result](int ready) { return mysql_store_result_cont(&result, conn_, ready); });
+    if (!result) {
+        checkError();
+    }
+    co_return result;
+}
+
+// AsyncConnectionLease 实现
+AsyncConnectionLease::AsyncConnectionLease(AlipayAsyncConnectionPool* pool,
+                                           std::unique_ptr<AlipayAsyncConnection> conn)
+    : pool_(pool), conn_(std::move(conn)) {}
+
+AsyncConnectionLease::~AsyncConnectionLease() {
+    release();
+}
+
+AsyncConnectionLease::AsyncConnectionLease(AsyncConnectionLease&& other) noexcept
+    : pool_(std::exchange(other.pool_, nullptr)), conn_(std::move(other.conn_)) {}
+
+AsyncConnectionLease& AsyncConnectionLease::operator=(AsyncConnectionLease&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool_ = std::exchange(other.pool_, nullptr);
+        conn_ = std::move(other.conn_);
+    }
+    return *this;
+}
+
+void AsyncConnectionLease::release() {
+    if (!conn_) return;
+    if (pool_) {
+        pool_->giveBack(std::move(conn_));
+    } else {
+        conn_.reset();
+    }
+    pool_ = nullptr;
+}
+
+// AlipayAsyncConnectionPool 实现
+class AlipayAsyncConnectionPool::WaitForConnection {
+public:
+    WaitForConnection(AlipayAsyncConnectionPool& pool, std::unique_ptr<AlipayAsyncConnection>& slot)
+        : pool_(pool), slot_(slot) {}
+
+    bool await_ready() const noexcept { return false; }
+    void await_suspend(std::coroutine_handle<> handle) {
+        pool_.waiters_.push_back(Waiter{handle, &slot_});
+    }
+    void await_resume() const noexcept {}
+
+private:
+    AlipayAsyncConnectionPool& pool_;
+    std::unique_ptr<AlipayAsyncConnection>& slot_;
+};
+
+AlipayAsyncConnectionPool::AlipayAsyncConnectionPool(AlipayEventLoop& loop,
+                                                     const ConnectionPoolConfig& config)
+    : loop_(loop), config_(config) {}
+
+AlipayAsyncConnectionPool::~AlipayAsyncConnectionPool() {
+    idle_.clear();
+}
+
+AsyncTask<AsyncConnectionLease> AlipayAsyncConnectionPool::acquire() {
+    while (true) {
+        if (!idle_.empty()) {
+            auto conn = std::move(idle_.front());
+            idle_.pop_front();
+            co_return AsyncConnectionLease(this, std::move(conn));
+        }
+
+        if (total_ < config_.max_size) {
+            ++total_;
+            auto conn = std::make_unique<AlipayAsyncConnection>(loop_);
+            if (co_await conn->connect(config_)) {
+                co_return AsyncConnectionLease(this, std::move(conn));
+            }
+            // 建连失败：让出名额，唤醒一个等待者自行重试
+            giveBack(std::move(conn));
+            co_return AsyncConnectionLease();
+        }
+
+        // 归还的连接直接交给等待者；拿到空连接表示有名额释放，回到循环开头建连
+        std::unique_ptr<AlipayAsyncConnection> handed;
+        co_await WaitForConnection(*this, handed);
+        if (handed) {
+            co_return AsyncConnectionLease(this, std::move(handed));
+        }
+    }
+}
+
+void AlipayAsyncConnectionPool::giveBack(std::unique_ptr<AlipayAsyncConnection> conn) {
+    if (conn->broken()) {
+        conn.reset();
+        --total_;
+    }
+
+    if (!waiters_.empty()) {
+        Waiter waiter = waiters_.front();
+        waiters_.pop_front();
+        *waiter.slot = std::move(conn);
+        // 经事件循环恢复，避免在归还者的调用栈上嵌套执行
+        loop_.post(waiter.handle);
+        return;
+    }
+
+    if (conn) {
+        idle_.push_front(std::move(conn));
+    }
+}
@@ -0,0 +1,65 @@
+#include "alipay_async_transaction.h"
+#include "alipay_transaction.h"
+#include <mysql/mysqld_error.h>
+#include <mysql/errmsg.h>
+
+namespace {
+
+constexpr const char* kXidPrefix = "TXN";
+
+} // namespace
+
+AlipayAsyncTransaction::AlipayAsyncTransaction(AlipayAsyncConnection& conn) : conn_(conn) {}
+
+AlipayAsyncTransaction::~AlipayAsyncTransaction() {
+    if (active_) {
+        conn_.markBroken();
+    }
+}
+
+AsyncTask<bool> AlipayAsyncTransaction::beginTransaction(std::string xid) {
+    if (active_) co_return false;
+    
+    current_xid_ = xid.empty() ? AlipayTransaction::generateXID(kXidPrefix) : std::move(xid);
+    if (!co_await conn_.execute("XA START '" + current_xid_ + "'")) {
+        current_xid_.clear();
+        co_return false;
+    }
+    active_ = true;
+    co_return true;
+}
+
+AsyncTask<bool> AlipayAsyncTransaction::commitTransaction() {
+    if (!active_) co_return false;
+    
+    std::string xid = "'" + current_xid_ + "'";
+    if (!co_await conn_.execute("XA END " + xid)) co_return false;
+    
+    // 服务端报错时 MySQL 已回滚该分支；客户端错误（连接中断等）时服务端可能已提交，
+    // 事务保持未结束，析构时关闭连接
+    bool result = co_await conn_.execute("XA COMMIT " + xid + " ONE PHASE");
+    unsigned int error = result ? 0 : mysql_errno(conn_.get());
+    if (error >= CR_MIN_ERROR && error <= CR_MAX_ERROR) {
+        outcome_unknown_ = true;
+        co_return false;
+    }
+    active_ = false;
+    current_xid_.clear();
+    co_return result;
+}
+
+AsyncTask<bool> AlipayAsyncTransaction::rollbackTransaction() {
+    if (!active_) co_return true;
+    if (outcome_unknown_) co_return false;
+    
+    std::string xid = "'" + current_xid_ + "'";
+    // XA END 失败（分支已结束）不影响回滚
+    co_await conn_.execute("XA END " + xid);
+    bool result = co_await conn_.execute("XA ROLLBACK " + xid) ||
+                  mysql_errno(conn_.get()) == ER_XAER_NOTA;
+    if (result) {
+        active_ = false;
+        current_xid_.clear();
+    }
+    co_return result;
+}
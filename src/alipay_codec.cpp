@@ -0,0 +1,232 @@
+#include "alipay_codec.h"
+#include <charconv>
+#include <algorithm>
+#include <iterator>
+#include <ctime>
+
+namespace {
+
+constexpr int64_t kSecondsPerDay = 86400;
+constexpr int64_t kTableYearsBack = 30;     // 偏移表覆盖的范围（相对进程启动时刻）
+constexpr int64_t kTableYearsAhead = 20;
+
+inline void writeDigits2(char* out, unsigned value) {
+    out[0] = static_cast<char>('0' + value / 10);
+    out[1] = static_cast<char>('0' + value % 10);
+}
+
+inline bool readDigits(const char* in, size_t count, unsigned& value) {
+    value = 0;
+    for (size_t i = 0; i < count; ++i) {
+        if (in[i] < '0' || in[i] > '9') return false;
+        value = value * 10 + static_cast<unsigned>(in[i] - '0');
+    }
+    return true;
+}
+
+inline bool isLeapYear(int64_t year) {
+    return (year % 4 == 0 && year % 100 != 0) || year % 400 == 0;
+}
+
+unsigned daysInMonth(int64_t year, unsigned month) {
+    static const unsigned kDays[] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
+    return month == 2 && isLeapYear(year) ? 29 : kDays[month - 1];
+}
+
+} // namespace
+
+// 民用历算法见 Howard Hinnant, "chrono-Compatible Low-Level Date Algorithms"
+int64_t daysFromCivil(int64_t year, unsigned month, unsigned day) {
+    year -= month <= 2;
+    const int64_t era = (year >= 0 ? year : year - 399) / 400;
+    const unsigned yoe = static_cast<unsigned>(year - era * 400);
+    const unsigned doy = (153 * (month > 2 ? month - 3 : month + 9) + 2) / 5 + day - 1;
+    const unsigned doe = yoe * 365 + yoe / 4 - yoe / 100 + doy;
+    return era * 146097 + static_cast<int64_t>(doe) - 719468;
+}
+
+void civilFromDays(int64_t days, int64_t& year, unsigned& month, unsigned& day) {
+    days += 719468;
+    const int64_t era = (days >= 0 ? days : days - 146096) / 146097;
+    const unsigned doe = static_cast<unsigned>(days - era * 146097);
+    const unsigned yoe = (doe - doe / 1460 + doe / 36524 - doe / 146096) / 365;
+    const unsigned doy = doe - (365 * yoe + yoe / 4 - yoe / 100);
+    const unsigned mp = (5 * doy + 2) / 153;
+    day = doy - (153 * mp + 2) / 5 + 1;
+    month = mp < 10 ? mp + 3 : mp - 9;
+    year = static_cast<int64_t>(yoe) + era * 400 + (month <= 2);
+}
+
+// AlipayTimeZone 实现
+const AlipayTimeZone& AlipayTimeZone::local() {
+    static const AlipayTimeZone instance;
+    return instance;
+}
+
+int64_t AlipayTimeZone::systemOffsetAt(int64_t utc) {
+    time_t time = static_cast<time_t>(utc);
+    struct tm tm = {};
+    localtime_r(&time, &tm);
+    int64_t local = daysFromCivil(tm.tm_year + 1900, tm.tm_mon + 1, tm.tm_mday) * kSecondsPerDay +
+                    tm.tm_hour * 3600 + tm.tm_min * 60 + tm.tm_sec;
+    return local - utc;
+}
+
+AlipayTimeZone::AlipayTimeZone() {
+    int64_t now = static_cast<int64_t>(time(nullptr));
+    range_begin_ = now - kTableYearsBack * 365 * kSecondsPerDay;
+    range_end_ = now + kTableYearsAhead * 365 * kSecondsPerDay;
+
+    // 按天采样，偏移变化时在当天内二分出精确的切换时刻
+    int64_t previous = systemOffsetAt(range_begin_);
+    transitions_.push_back(Transition{range_begin_, previous});
+
+    for (int64_t day = range_begin_ + kSecondsPerDay; day < range_end_; day += kSecondsPerDay) {
+        int64_t offset = systemOffsetAt(day);
+        if (offset == previous) continue;
+
+        int64_t low = day - kSecondsPerDay;   // 旧偏移
+        int64_t high = day;                   // 新偏移
+        while (high - low > 1) {
+            int64_t middle = low + (high - low) / 2;
+            if (systemOffsetAt(middle) == previous) {
+                low = middle;
+            } else {
+                high = middle;
+            }
+        }
+        transitions_.push_back(Transition{high, offset});
+        previous = offset;
+    }
+}
+
+int64_t AlipayTimeZone::offsetAt(int64_t utc) const {
+    if (utc < range_begin_ || utc >= range_end_) {
+        return systemOffsetAt(utc);
+    }
+
+    auto it = std::upper_bound(transitions_.begin(), transitions_.end(), utc,
+        [](int64_t value, const Transition& transition) { return value < transition.utc; });
+    return std::prev(it)->offset;
+}
+
+int64_t AlipayTimeZone::toUtc(int64_t localSeconds) const {
+    // 偏移相差不超过一天，前后各取一天的偏移即覆盖切换两侧
+    int64_t before = offsetAt(localSeconds - kSecondsPerDay);
+    int64_t after = offsetAt(localSeconds + kSecondsPerDay);
+
+    int64_t best = 0;
+    bool found = false;
+    for (int64_t offset : {before, after}) {
+        int64_t utc = localSeconds - offset;
+        if (offsetAt(utc) == offset && (!found || utc < best)) {
+            best = utc;
+            found = true;
+        }
+    }
+
+    // 夏令时跳过的本地时刻不存在，按切换前的偏移换算
+    return found ? best : localSeconds - before;
+}
+
+// 金额编解码
+size_t formatAmount(char* out, size_t capacity, uint64_t amount) {
+    char* end = out + capacity;
+    auto result = std::to_chars(out, end, amount / 100);
+    if (result.ec != std::errc() || end - result.ptr < 3) return 0;
+
+    char* p = result.ptr;
+    *p++ = '.';
+    writeDigits2(p, static_cast<unsigned>(amount % 100));
+    return static_cast<size_t>(p + 2 - out);
+}
+
+bool parseAmount(std::string_view text, uint64_t& amount) {
+    size_t dot = text.find('.');
+    std::string_view integer = text.substr(0, dot);
+    if (integer.empty()) return false;
+
+    uint64_t yuan = 0;
+    auto result = std::from_chars(integer.data(), integer.data() + integer.size(), yuan);
+    if (result.ec != std::errc() || result.ptr != integer.data() + integer.size()) {
+        return false;
+    }
+    if (yuan > UINT64_MAX / 100) return false;
+
+    unsigned fen = 0;
+    if (dot != std::string_view::npos) {
+        std::string_view fraction = text.substr(dot + 1);
+        for (size_t i = 0; i < fraction.size(); ++i) {
+            char c = fraction[i];
+            if (c < '0' || c > '9') return false;
+            // 超过两位的小数截断
+            if (i == 0) fen += static_cast<unsigned>(c - '0') * 10;
+            if (i == 1) fen += static_cast<unsigned>(c - '0');
+        }
+    }
+
+    if (yuan * 100 > UINT64_MAX - fen) return false;
+    amount = yuan * 100 + fen;
+    return true;
+}
+
+// 时间编解码
+size_t formatTimestamp(char* out, size_t capacity, uint64_t timestamp) {
+    if (capacity < kTimestampBufferSize - 1) return 0;
+
+    int64_t utc = static_cast<int64_t>(timestamp);
+    int64_t local = utc + AlipayTimeZone::local().offsetAt(utc);
+    int64_t days = local / kSecondsPerDay;
+    int64_t seconds = local % kSecondsPerDay;
+    if (seconds < 0) {
+        seconds += kSecondsPerDay;
+        --days;
+    }
+
+    int64_t year;
+    unsigned month, day;
+    civilFromDays(days, year, month, day);
+    if (year < 0 || year > 9999) return 0;
+
+    writeDigits2(out, static_cast<unsigned>(year / 100));
+    writeDigits2(out + 2, static_cast<unsigned>(year % 100));
+    out[4] = '-';
+    writeDigits2(out + 5, month);
+    out[7] = '-';
+    writeDigits2(out + 8, day);
+    out[10] = ' ';
+    writeDigits2(out + 11, static_cast<unsigned>(seconds / 3600));
+    out[13] = ':';
+    writeDigits2(out + 14, static_cast<unsigned>(seconds / 60 % 60));
+    out[16] = ':';
+    writeDigits2(out + 17, static_cast<unsigned>(seconds % 60));
+    return kTimestampBufferSize - 1;
+}
+
+bool parseTimestamp(std::string_view text, uint64_t& timestamp) {
+    if (text.size() != kTimestampBufferSize - 1) return false;
+
+    const char* p = text.data();
+    if (p[4] != '-' || p[7] != '-' || p[10] != ' ' || p[13] != ':' || p[16] != ':') {
+        return false;
+    }
+
+    unsigned year, month, day, hour, minute, second;
+    if (!readDigits(p, 4, year) || !readDigits(p + 5, 2, month) ||
+        !readDigits(p + 8, 2, day) || !readDigits(p + 11, 2, hour) ||
+        !readDigits(p + 14, 2, minute) || !readDigits(p + 17, 2, second)) {
+        return false;
+    }
+    if (month < 1 || month > 12 || day < 1 || day > daysInMonth(year, month) ||
+        hour > 23 || minute > 59 || second > 59) {
+        return false;
+    }
+
+    int64_t local = daysFromCivil(year, month, day) * kSecondsPerDay +
+                    hour * 3600 + minute * 60 + second;
+    int64_t utc = AlipayTimeZone::local().toUtc(local);
+    if (utc < 0) return false;
+
+    timestamp = static_cast<uint64_t>(utc);
+    return true;
+}
@@ -0,0 +1,251 @@
+#include "alipay_connection_pool.h"
+#include <algorithm>
+#include <chrono>
+
+uint64_t steadyNowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+MYSQL* openMysqlConnection(const char* host, const char* user, const char* password,
+                           const char* db, unsigned int port, const char* charset,
+                           unsigned int connectTimeoutSeconds) {
+    MYSQL* conn = mysql_init(nullptr);
+    if (!conn) return nullptr;
+
+    if (connectTimeoutSeconds > 0) {
+        mysql_options(conn, MYSQL_OPT_CONNECT_TIMEOUT, &connectTimeoutSeconds);
+    }
+
+    if (!mysql_real_connect(conn, host, user, password, db, port, nullptr, 0)) {
+        mysql_close(conn);
+        return nullptr;
+    }
+
+    mysql_set_character_set(conn, charset);
+    return conn;
+}
+
+PooledMysql::~PooledMysql() {
+    statements.clear();
+    if (conn) {
+        mysql_close(conn);
+    }
+}
+
+// PooledConnection 实现
+PooledConnection::PooledConnection(AlipayConnectionPool* pool,
+                                   std::unique_ptr<PooledMysql> entry)
+    : pool_(pool), entry_(std::move(entry)) {}
+
+PooledConnection::~PooledConnection() {
+    release();
+}
+
+PooledConnection::PooledConnection(PooledConnection&& other) noexcept
+    : pool_(other.pool_), entry_(std::move(other.entry_)), broken_(other.broken_) {
+    other.pool_ = nullptr;
+    other.broken_ = false;
+}
+
+PooledConnection& PooledConnection::operator=(PooledConnection&& other) noexcept {
+    if (this != &other) {
+        release();
+        pool_ = other.pool_;
+        entry_ = std::move(other.entry_);
+        broken_ = other.broken_;
+        other.pool_ = nullptr;
+        other.broken_ = false;
+    }
+    return *this;
+}
+
+PooledConnection PooledConnection::open(const char* host, const char* user,
+                                        const char* password, const char* db) {
+    MYSQL* conn = openMysqlConnection(host, user, password, db, 0, "utf8mb4", 0);
+    if (!conn) return PooledConnection();
+
+    auto entry = std::make_unique<PooledMysql>();
+    entry->conn = conn;
+    entry->created_ms = entry->last_used_ms = steadyNowMs();
+    return PooledConnection(nullptr, std::move(entry));
+}
+
+void PooledConnection::release() {
+    if (!entry_) return;
+
+    if (pool_) {
+        pool_->giveBack(std::move(entry_), broken_);
+    } else {
+        entry_.reset();
+    }
+    pool_ = nullptr;
+    broken_ = false;
+}
+
+// AlipayConnectionPool 实现
+AlipayConnectionPool& AlipayConnectionPool::getInstance() {
+    static AlipayConnectionPool instance;
+    return instance;
+}
+
+AlipayConnectionPool::~AlipayConnectionPool() {
+    shutdown();
+}
+
+bool AlipayConnectionPool::init(const ConnectionPoolConfig& config) {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (initialized_) return true;
+        if (config.max_size == 0) return false;
+        config_ = config;
+        initialized_ = true;
+    }
+
+    // 预热连接，失败不影响后续按需建连
+    size_t warm = std::min(config.min_idle, config.max_size);
+    for (size_t i = 0; i < warm; ++i) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            ++total_;
+        }
+        auto entry = createConnection();
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!entry) {
+            --total_;
+            break;
+        }
+        idle_.push_back(std::move(entry));
+    }
+    available_.notify_all();
+    return true;
+}
+
+bool AlipayConnectionPool::isInitialized() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return initialized_;
+}
+
+void AlipayConnectionPool::shutdown() {
+    std::deque<std::unique_ptr<PooledMysql>> closing;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closing.swap(idle_);
+        total_ -= closing.size();
+        initialized_ = false;
+    }
+    closing.clear();
+    available_.notify_all();
+}
+
+std::unique_ptr<PooledMysql> AlipayConnectionPool::createConnection() {
+    MYSQL* conn = openMysqlConnection(config_.host.c_str(), config_.user.c_str(),
+                                      config_.password.c_str(), config_.db.c_str(),
+                                      config_.port, config_.charset.c_str(),
+                                      config_.connect_timeout_s);
+    if (!conn) return nullptr;
+
+    auto entry = std::make_unique<PooledMysql>();
+    entry->conn = conn;
+    entry->created_ms = entry->last_used_ms = steadyNowMs();
+    return entry;
+}
+
+bool AlipayConnectionPool::checkHealth(PooledMysql& entry, uint64_t now) {
+    // 最近用过的连接视为健康，避免每次借出都多一次往返
+    if (now - entry.last_used_ms < config_.ping_interval_ms) {
+        return true;
+    }
+    return mysql_ping(entry.conn) == 0;
+}
+
+PooledConnection AlipayConnectionPool::acquire() {
+    auto deadline = std::chrono::steady_clock::now() +
+                    std::chrono::milliseconds(config_.acquire_timeout_ms);
+
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (initialized_) {
+        if (!idle_.empty()) {
+            auto entry = std::move(idle_.front());
+            idle_.pop_front();
+            lock.unlock();
+
+            if (checkHealth(*entry, steadyNowMs())) {
+                return PooledConnection(this, std::move(entry));
+            }
+
+            // 连接已失效，关闭后重新尝试
+            entry.reset();
+            lock.lock();
+            --total_;
+            continue;
+        }
+
+        if (total_ < config_.max_size) {
+            ++total_;
+            lock.unlock();
+
+            auto entry = createConnection();
+            if (entry) {
+                return PooledConnection(this, std::move(entry));
+            }
+
+            lock.lock();
+            --total_;
+            available_.notify_one();
+            return PooledConnection();
+        }
+
+        if (available_.wait_until(lock, deadline) == std::cv_status::timeout) {
+            return PooledConnection();
+        }
+    }
+    return PooledConnection();
+}
+
+void AlipayConnectionPool::giveBack(std::unique_ptr<PooledMysql> entry, bool broken) {
+    std::deque<std::unique_ptr<PooledMysql>> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (broken || !initialized_) {
+            evicted.push_back(std::move(entry));
+            --total_;
+        } else {
+            uint64_t now = steadyNowMs();
+            entry->last_used_ms = now;
+            idle_.push_front(std::move(entry));
+            evictIdleLocked(now, evicted);
+        }
+    }
+    available_.notify_one();
+    // evicted 离开作用域时在锁外关闭连接
+}
+
+void AlipayConnectionPool::evictIdle() {
+    std::deque<std::unique_ptr<PooledMysql>> evicted;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        evictIdleLocked(steadyNowMs(), evicted);
+    }
+}
+
+void AlipayConnectionPool::evictIdleLocked(
+    uint64_t now, std::deque<std::unique_ptr<PooledMysql>>& evicted) {
+    // 队尾是最久未使用的连接
+    while (idle_.size() > config_.min_idle &&
+           now - idle_.back()->last_used_ms >= config_.idle_timeout_ms) {
+        evicted.push_back(std::move(idle_.back()));
+        idle_.pop_back();
+        --total_;
+    }
+}
+
+size_t AlipayConnectionPool::totalConnections() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return total_;
+}
+
+size_t AlipayConnectionPool::idleConnections() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return idle_.size();
+}
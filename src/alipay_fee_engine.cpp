@@ -0,0 +1,116 @@
+#include "alipay_fee_engine.h"
+#include <cmath>
+
+namespace {
+
+// 各舍入方式的批量内核；除以常量 10000 由编译器转为乘法和移位
+template <FeeRounding Mode>
+inline uint64_t roundedFee(uint64_t amount, uint64_t rateBps) {
+    constexpr uint64_t scale = AlipayFeeEngine::kBasisPointScale;
+    uint64_t product = amount * rateBps;
+    if constexpr (Mode == FeeRounding::TRUNCATE) {
+        return product / scale;
+    } else if constexpr (Mode == FeeRounding::HALF_UP) {
+        return (product + scale / 2) / scale;
+    } else if constexpr (Mode == FeeRounding::UP) {
+        return (product + scale - 1) / scale;
+    } else {
+        uint64_t quotient = product / scale;
+        uint64_t remainder = product - quotient * scale;
+        // 余数恰为一半时向偶数舍入，写成无分支形式
+        return quotient + ((remainder > scale / 2) | ((remainder == scale / 2) & (quotient & 1)));
+    }
+}
+
+template <FeeRounding Mode>
+uint64_t batchKernel(const uint64_t* __restrict amounts, size_t count, uint64_t rateBps,
+                     uint64_t* __restrict fees, uint64_t* __restrict settlements) {
+    uint64_t total = 0;
+    for (size_t i = 0; i < count; ++i) {
+        uint64_t fee = roundedFee<Mode>(amounts[i], rateBps);
+        fees[i] = fee;
+        settlements[i] = amounts[i] - fee;
+        total += fee;
+    }
+    return total;
+}
+
+} // namespace
+
+uint64_t AlipayFeeEngine::fee(uint64_t amount, uint32_t rateBps) const {
+    switch (rounding_) {
+        case FeeRounding::HALF_UP:   return roundedFee<FeeRounding::HALF_UP>(amount, rateBps);
+        case FeeRounding::HALF_EVEN: return roundedFee<FeeRounding::HALF_EVEN>(amount, rateBps);
+        case FeeRounding::UP:        return roundedFee<FeeRounding::UP>(amount, rateBps);
+        case FeeRounding::TRUNCATE:  break;
+    }
+    return roundedFee<FeeRounding::TRUNCATE>(amount, rateBps);
+}
+
+uint64_t AlipayFeeEngine::computeBatch(const uint64_t* amounts, size_t count, uint32_t rateBps,
+                                       uint64_t* fees, uint64_t* settlements) const {
+    switch (rounding_) {
+        case FeeRounding::HALF_UP:
+            return batchKernel<FeeRounding::HALF_UP>(amounts, count, rateBps, fees, settlements);
+        case FeeRounding::HALF_EVEN:
+            return batchKernel<FeeRounding::HALF_EVEN>(amounts, count, rateBps, fees, settlements);
+        case FeeRounding::UP:
+            return batchKernel<FeeRounding::UP>(amounts, count, rateBps, fees, settlements);
+        case FeeRounding::TRUNCATE:
+            break;
+    }
+    return batchKernel<FeeRounding::TRUNCATE>(amounts, count, rateBps, fees, settlements);
+}
+
+FeeProfitShare AlipayFeeEngine::profitShare(uint64_t amount, uint32_t subRateBps,
+                                            uint32_t isvRateBps) const {
+    // 两部分都由同一笔手续费拆出，保证 platform_fee + isv_profit == total_fee
+    FeeProfitShare share;
+    share.total_fee = fee(amount, subRateBps);
+    uint64_t platformFee = fee(amount, isvRateBps);
+    share.platform_fee = platformFee < share.total_fee ? platformFee : share.total_fee;
+    share.isv_profit = share.total_fee - share.platform_fee;
+    return share;
+}
+
+bool AlipayFeeEngine::parseRate(std::string_view text, uint32_t& rateBps) {
+    size_t pos = 0;
+    uint32_t integer = 0;
+    bool digits = false;
+    while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+        integer = integer * 10 + (text[pos] - '0');
+        if (integer > 1) return false;
+        ++pos;
+        digits = true;
+    }
+
+    uint32_t fraction = 0;
+    size_t fractionDigits = 0;
+    if (pos < text.size() && text[pos] == '.') {
+        ++pos;
+        while (pos < text.size() && text[pos] >= '0' && text[pos] <= '9') {
+            if (++fractionDigits > 4) {
+                // 超出精度的位只允许为 0（如 DECIMAL 补齐的尾零）
+                if (text[pos] != '0') return false;
+            } else {
+                fraction = fraction * 10 + (text[pos] - '0');
+            }
+            ++pos;
+            digits = true;
+        }
+    }
+    if (!digits || pos != text.size()) return false;
+
+    for (size_t i = fractionDigits; i < 4; ++i) fraction *= 10;
+    uint32_t value = integer * kBasisPointScale + fraction;
+    if (value > kBasisPointScale) return false;
+
+    rateBps = value;
+    return true;
+}
+
+uint32_t AlipayFeeEngine::rateFromDouble(double rate) {
+    if (!(rate > 0)) return 0;
+    if (rate >= 1) return kBasisPointScale;
+    return static_cast<uint32_t>(std::llround(rate * kBasisPointScale));
+}
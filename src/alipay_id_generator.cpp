@@ -0,0 +1,156 @@
+#include "alipay_id_generator.h"
+#include <chrono>
+#include <charconv>
+#include <cstring>
+#include <stdexcept>
+#include <system_error>
+
+namespace {
+
+uint64_t nowMs() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
+// 整段都是十进制数字时解析为 value
+bool parseDigits(std::string_view text, uint64_t& value) {
+    if (text.empty()) return false;
+    auto result = std::from_chars(text.data(), text.data() + text.size(), value);
+    return result.ec == std::errc() && result.ptr == text.data() + text.size();
+}
+
+} // namespace
+
+AlipayIdGenerator& AlipayIdGenerator::getInstance() {
+    static AlipayIdGenerator instance;
+    return instance;
+}
+
+bool AlipayIdGenerator::setNodeId(uint32_t nodeId) {
+    if (nodeId > kMaxNodeId) return false;
+    node_id_.store(nodeId, std::memory_order_relaxed);
+    return true;
+}
+
+uint32_t AlipayIdGenerator::slotForThisThread() {
+    // 线程首次生成 ID 时轮流分配槽位
+    thread_local uint32_t slot = UINT32_MAX;
+    if (slot == UINT32_MAX) {
+        slot = next_slot_.fetch_add(1, std::memory_order_relaxed) & (kSlots - 1);
+    }
+    return slot;
+}
+
+uint64_t AlipayIdGenerator::next() {
+    uint32_t slot = slotForThisThread();
+    std::atomic<uint64_t>& state = slots_[slot].state;
+
+    uint64_t previous = state.load(std::memory_order_relaxed);
+    while (true) {
+        // 先取全局见过的最大时钟再读时钟，now 比更早读到的时钟小才是真正的回拨
+        // （反过来读时，其他线程在两次读取之间推进 seen 会被误记为回拨；借用的未来毫秒不计入 seen）
+        uint64_t seen = max_clock_ms_.load(std::memory_order_relaxed);
+        uint64_t now = nowMs() - kEpochMs;
+        bool regressed = now < seen;
+        if (now > seen) {
+            max_clock_ms_.compare_exchange_weak(seen, now, std::memory_order_relaxed);
+        }
+
+        uint64_t last = previous >> kSequenceBits;
+        uint64_t sequence = previous & kSequenceMask;
+
+        uint64_t timestamp;
+        bool overflowed = false;
+        if (now > last) {
+            timestamp = now;
+            sequence = 0;
+        } else {
+            // 同一毫秒内或时钟回拨：沿用上次的时间戳，序列号用尽时借用下一毫秒
+            if (sequence < kSequenceMask) {
+                timestamp = last;
+                ++sequence;
+            } else {
+                timestamp = last + 1;
+                sequence = 0;
+                overflowed = true;
+            }
+        }
+
+        uint64_t desired = (timestamp << kSequenceBits) | sequence;
+        if (state.compare_exchange_weak(previous, desired, std::memory_order_relaxed)) {
+            if (regressed) clock_regressions_.fetch_add(1, std::memory_order_relaxed);
+            if (overflowed) sequence_overflows_.fetch_add(1, std::memory_order_relaxed);
+
+            return (timestamp << (kNodeBits + kSlotBits + kSequenceBits)) |
+                   (uint64_t(node_id_.load(std::memory_order_relaxed)) << (kSlotBits + kSequenceBits)) |
+                   (uint64_t(slot) << kSequenceBits) |
+                   sequence;
+        }
+    }
+}
+
+size_t AlipayIdGenerator::format(char* out, size_t capacity, std::string_view prefix,
+                                 uint64_t id) {
+    size_t length = prefix.size() + 1 + kDigits;
+    if (length > capacity) return 0;
+
+    memcpy(out, prefix.data(), prefix.size());
+    out[prefix.size()] = '_';
+
+    // 定长补零，字典序与数值序一致
+    char* digits = out + prefix.size() + 1;
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), id);
+    size_t written = static_cast<size_t>(result.ptr - buffer);
+    memset(digits, '0', kDigits - written);
+    memcpy(digits + kDigits - written, buffer, written);
+    return length;
+}
+
+AlipayIdBuffer AlipayIdGenerator::nextId(std::string_view prefix) {
+    if (prefix.size() + 1 + kDigits > AlipayIdBuffer::kCapacity) {
+        throw std::invalid_argument("ID 前缀过长");
+    }
+    AlipayIdBuffer id;
+    id.size = format(id.data, sizeof(id.data), prefix, next());
+    return id;
+}
+
+uint64_t AlipayIdGenerator::timestampOf(uint64_t id) {
+    return (id >> (kNodeBits + kSlotBits + kSequenceBits)) + kEpochMs;
+}
+
+bool AlipayIdGenerator::generatedBefore(std::string_view id, std::string_view cutoff) {
+    size_t separator = cutoff.rfind('_');
+    if (separator == std::string_view::npos || cutoff.size() - separator - 1 != kDigits) {
+        return false;
+    }
+    std::string_view prefix = cutoff.substr(0, separator + 1);
+    if (id.substr(0, prefix.size()) != prefix) return false;
+
+    std::string_view body = id.substr(prefix.size());
+    std::string_view cutoffBody = cutoff.substr(prefix.size());
+    uint64_t value = 0;
+    if (body.size() == kDigits && parseDigits(body, value)) {
+        return body < cutoffBody;
+    }
+
+    // 旧格式：毫秒时间戳 + '_' + 随机数
+    size_t split = body.find('_');
+    uint64_t legacyMs = 0;
+    uint64_t cutoffId = 0;
+    if (split == std::string_view::npos ||
+        !parseDigits(body.substr(0, split), legacyMs) ||
+        !parseDigits(body.substr(split + 1), value) ||
+        !parseDigits(cutoffBody, cutoffId)) {
+        return false;
+    }
+    return legacyMs < timestampOf(cutoffId);
+}
+
+IdGeneratorStats AlipayIdGenerator::stats() const {
+    IdGeneratorStats stats;
+    stats.clock_regressions = clock_regressions_.load(std::memory_order_relaxed);
+    stats.sequence_overflows = sequence_overflows_.load(std::memory_order_relaxed);
+    return stats;
+}
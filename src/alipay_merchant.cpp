@@ -1,27 +1,31 @@
 #include "alipay_merchant.h"
+#include "alipay_schema_manager.h"
+#include "alipay_fee_engine.h"
 #include <sstream>
 #include <chrono>
 #include <stdexcept>
 
-AlipayMerchant::AlipayMerchant() : conn(nullptr), fee_rate_(0.0) {}
+AlipayMerchant::AlipayMerchant() : conn(nullptr), fee_rate_bps_(0) {}
 
 AlipayMerchant::~AlipayMerchant() {
-    if (conn) {
-        mysql_close(conn);
-    }
+    // lease_ 析构时归还连接池或关闭独占连接
 }
 
 bool AlipayMerchant::connectDB(const char* host, const char* user, 
                               const char* password, const char* db) {
-    conn = mysql_init(nullptr);
+    lease_ = PooledConnection::open(host, user, password, db);
+    conn = lease_.get();
     if (!conn) return false;
     
-    if (!mysql_real_connect(conn, host, user, password, db, 0, nullptr, 0)) {
-        return false;
-    }
+    return AlipaySchemaManager::getInstance().ensureSchema(conn);
+}
+
+bool AlipayMerchant::connectDB(AlipayConnectionPool& pool) {
+    lease_ = pool.acquire();
+    conn = lease_.get();
+    if (!conn) return false;
     
-    mysql_set_character_set(conn, "utf8mb4");
-    return createMerchantTable();
+    return AlipaySchemaManager::getInstance().ensureSchema(conn);
 }
 
 bool AlipayMerchant::createMerchant() {
@@ -33,20 +37,17 @@ bool AlipayMerchant::createMerchant() {
             "create_time, update_time, contact_name, contact_phone, contact_email, "
             "bank_account_name, bank_account_no, bank_name, bank_branch, "
             "settlement_type, settlement_cycle, fee_rate"
-            ") VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+            ") VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ? / 10000)";   // 费率以基点绑定，由 MySQL 做精确的十进制除法
             
-        MYSQL_STMT* stmt = mysql_stmt_init(conn);
-        if (!stmt) throw std::runtime_error("mysql_stmt_init failed");
-        
-        if (mysql_stmt_prepare(stmt, query.c_str(), query.length())) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
-        }
+        CachedStatement stmt(lease_, query);
+        if (!stmt) throw std::runtime_error(stmt.error());
         
         // 设置当前时间戳
         create_time_ = update_time_ = std::chrono::system_clock::to_time_t(
             std::chrono::system_clock::now());
         
-        status_ = "ACTIVE"; // 默认状态为激活
+        status_ = MerchantStatus::ACTIVE; // 默认状态为激活
+        uint8_t status_code = statusCode(status_);
         
         MYSQL_BIND bind[16];
         memset(bind, 0, sizeof(bind));
@@ -62,6 +63,10 @@ bool AlipayMerchant::createMerchant() {
         
         // ... 绑定其他必填字段 ...
         
+        bind[3].buffer_type = MYSQL_TYPE_TINY;
+        bind[3].buffer = &status_code;
+        bind[3].is_unsigned = true;
+        
         // 绑定可选字段
         my_bool is_null[1] = {1};
         if (contact_email_) {
@@ -72,19 +77,18 @@ bool AlipayMerchant::createMerchant() {
         }
         bind[8].is_null = &is_null[0];
         
-        // 绑定费率
-        bind[15].buffer_type = MYSQL_TYPE_DOUBLE;
-        bind[15].buffer = &fee_rate_;
+        // 绑定费率（基点）
+        bind[15].buffer_type = MYSQL_TYPE_LONG;
+        bind[15].buffer = &fee_rate_bps_;
+        bind[15].is_unsigned = true;
         
-        if (mysql_stmt_bind_param(stmt, bind)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_bind_param(stmt.get(), bind)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
-        if (mysql_stmt_execute(stmt)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_execute(stmt.get())) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
-        
-        mysql_stmt_close(stmt);
         return true;
     }
     catch (const std::exception& e) {
@@ -96,14 +100,15 @@ bool AlipayMerchant::queryMerchant(const std::string& merchantId) {
     if (!conn) return false;
     
     try {
-        std::string query = "SELECT * FROM alipay_merchants WHERE merchant_id = ?";
-        
-        MYSQL_STMT* stmt = mysql_stmt_init(conn);
-        if (!stmt) throw std::runtime_error("mysql_stmt_init failed");
+        // 列出全部列而不用 SELECT *：迁移替换过的列（如 status）在表中的位置已变化
+        std::string query = "SELECT merchant_id, merchant_name, merchant_type, status, "
+            "create_time, update_time, contact_name, contact_phone, contact_email, "
+            "bank_account_name, bank_account_no, bank_name, bank_branch, "
+            "settlement_type, settlement_cycle, fee_rate "
+            "FROM alipay_merchants WHERE merchant_id = ?";
         
-        if (mysql_stmt_prepare(stmt, query.c_str(), query.length())) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
-        }
+        CachedStatement stmt(lease_, query);
+        if (!stmt) throw std::runtime_error(stmt.error());
         
         MYSQL_BIND bind[1];
         memset(bind, 0, sizeof(bind));
@@ -112,12 +117,12 @@ bool AlipayMerchant::queryMerchant(const std::string& merchantId) {
         bind[0].buffer = (void*)merchantId.c_str();
         bind[0].buffer_length = merchantId.length();
         
-        if (mysql_stmt_bind_param(stmt, bind)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_bind_param(stmt.get(), bind)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
-        if (mysql_stmt_execute(stmt)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_execute(stmt.get())) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
         // 绑定结果集
@@ -128,27 +133,34 @@ bool AlipayMerchant::queryMerchant(const std::string& merchantId) {
         char merchant_id_buf[33];
         char merchant_name_buf[129];
         // ... 其他字段的缓冲区 ...
+        char fee_rate_buf[16];              // DECIMAL(5,4) 以文本读取，不经过 double
+        unsigned long fee_rate_length = 0;
         
         // 绑定结果字段
         result[0].buffer_type = MYSQL_TYPE_STRING;
         result[0].buffer = merchant_id_buf;
         result[0].buffer_length = sizeof(merchant_id_buf);
         // ... 绑定其他字段 ...
+        result[15].buffer_type = MYSQL_TYPE_STRING;
+        result[15].buffer = fee_rate_buf;
+        result[15].buffer_length = sizeof(fee_rate_buf);
+        result[15].length = &fee_rate_length;
         
-        if (mysql_stmt_bind_result(stmt, result)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_bind_result(stmt.get(), result)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
-        if (mysql_stmt_fetch(stmt)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_fetch(stmt.get())) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
         // 设置查询结果到对象属性
         merchant_id_ = std::string(merchant_id_buf);
         merchant_name_ = std::string(merchant_name_buf);
         // ... 设置其他字段 ...
-        
-        mysql_stmt_close(stmt);
+        if (!AlipayFeeEngine::parseRate(std::string_view(fee_rate_buf, fee_rate_length), fee_rate_bps_)) {
+            throw std::runtime_error("费率格式错误");
+        }
         return true;
     }
     catch (const std::exception& e) {
@@ -156,36 +168,6 @@ bool AlipayMerchant::queryMerchant(const std::string& merchantId) {
     }
 }
 
-bool AlipayMerchant::createMerchantTable() {
-    if (!conn) return false;
-    
-    const char* sql = R"SQL(
-        CREATE TABLE IF NOT EXISTS alipay_merchants (
-            merchant_id VARCHAR(32) PRIMARY KEY,
-            merchant_name VARCHAR(128) NOT NULL,
-            merchant_type VARCHAR(32) NOT NULL,
-            status VARCHAR(16) NOT NULL,
-            create_time BIGINT UNSIGNED NOT NULL,
-            update_time BIGINT UNSIGNED NOT NULL,
-            contact_name VARCHAR(64) NOT NULL,
-            contact_phone VARCHAR(32) NOT NULL,
-            contact_email VARCHAR(128),
-            bank_account_name VARCHAR(128) NOT NULL,
-            bank_account_no VARCHAR(32) NOT NULL,
-            bank_name VARCHAR(128) NOT NULL,
-            bank_branch VARCHAR(256) NOT NULL,
-            settlement_type VARCHAR(32) NOT NULL,
-            settlement_cycle VARCHAR(32) NOT NULL,
-            fee_rate DECIMAL(5,4) NOT NULL,
-            INDEX idx_merchant_type (merchant_type),
-            INDEX idx_status (status),
-            INDEX idx_create_time (create_time)
-        ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
-    )SQL";
-    
-    return mysql_query(conn, sql) == 0;
-}
-
 // Setter 实现
 void AlipayMerchant::setMerchantId(const std::string& value) {
     merchant_id_ = value;
@@ -222,13 +204,16 @@ void AlipayMerchant::setSettlementInfo(const std::string& type,
                                       double feeRate) {
     settlement_type_ = type;
     settlement_cycle_ = cycle;
-    fee_rate_ = feeRate;
+    fee_rate_bps_ = AlipayFeeEngine::rateFromDouble(feeRate);
 }
 
 // Getter 实现
 std::string AlipayMerchant::getMerchantId() const { return merchant_id_; }
 std::string AlipayMerchant::getMerchantName() const { return merchant_name_; }
 std::string AlipayMerchant::getMerchantType() const { return merchant_type_; }
-double AlipayMerchant::getFeeRate() const { return fee_rate_; }
+double AlipayMerchant::getFeeRate() const {
+    return static_cast<double>(fee_rate_bps_) / AlipayFeeEngine::kBasisPointScale;
+}
+uint32_t AlipayMerchant::getFeeRateBps() const { return fee_rate_bps_; }
 std::string AlipayMerchant::getSettlementCycle() const { return settlement_cycle_; }
 std::string AlipayMerchant::getBankAccountNo() const { return bank_account_no_; } 
\ No newline at end of file
@@ -1,82 +1,100 @@
 #include "alipay_order.h"
+#include "alipay_schema_manager.h"
+#include "alipay_sql_builder.h"
+#include "alipay_order_expiry.h"
+#include "alipay_outbox.h"
+#include "alipay_payment.h"
+#include "alipay_codec.h"
+#include <mysql/mysqld_error.h>
 #include <cstdlib>
+#include <cstdio>
 #include <ctime>
-#include <sstream>
-#include <iomanip>
 #include <stdexcept>
 #include <chrono>
+#include <string_view>
+#include <unordered_set>
+#include <memory>
 
-AlipayOrder::AlipayOrder() : conn(nullptr), total_amount_(0) {
+namespace {
+
+// 追加 JSON 字符串字面量（含两侧引号）
+void appendJsonString(std::string& out, std::string_view value) {
+    out += '"';
+    for (char c : value) {
+        switch (c) {
+            case '"':  out += "\\\""; break;
+            case '\\': out += "\\\\"; break;
+            case '\n': out += "\\n"; break;
+            case '\r': out += "\\r"; break;
+            case '\t': out += "\\t"; break;
+            default:
+                if (static_cast<unsigned char>(c) < 0x20) {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+                    out += escaped;
+                } else {
+                    out += c;
+                }
+        }
+    }
+    out += '"';
+}
+
+} // namespace
+
+AlipayOrder::AlipayOrder() : conn(nullptr), total_amount_(0), goods_loaded_(true), extend_loaded_(true) {
     product_code_ = "FAST_INSTANT_TRADE_PAY"; // 默认产品码
 }
 
 AlipayOrder::~AlipayOrder() {
-    if (conn) {
-        mysql_close(conn);
-    }
+    // lease_ 析构时归还连接池或关闭独占连接
 }
 
 // 时间戳转换工具方法实现
 std::string AlipayOrder::timestampToString(uint64_t timestamp) {
-    time_t time = static_cast<time_t>(timestamp);
-    struct tm* timeinfo = localtime(&time);
-    char buffer[80];
-    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", timeinfo);
-    return std::string(buffer);
+    char buffer[kTimestampBufferSize];
+    return std::string(buffer, formatTimestamp(buffer, sizeof(buffer), timestamp));
 }
 
 uint64_t AlipayOrder::stringToTimestamp(const std::string& timeStr) {
-    struct tm tm = {};
-    std::istringstream ss(timeStr);
-    ss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
-    if (ss.fail()) {
+    uint64_t timestamp = 0;
+    if (!parseTimestamp(timeStr, timestamp)) {
         throw std::invalid_argument("Invalid time format. Expected: YYYY-MM-DD HH:MM:SS");
     }
-    return static_cast<uint64_t>(mktime(&tm));
+    return timestamp;
 }
 
 // 金额转换工具方法
 std::string AlipayOrder::amountToString(uint64_t amount) {
-    std::stringstream ss;
-    ss << amount / 100 << "." << std::setw(2) << std::setfill('0') << amount % 100;
-    return ss.str();
+    char buffer[kAmountBufferSize];
+    return std::string(buffer, formatAmount(buffer, sizeof(buffer), amount));
 }
 
 uint64_t AlipayOrder::stringToAmount(const std::string& amountStr) {
-    size_t dotPos = amountStr.find('.');
-    if (dotPos == std::string::npos) {
-        return std::stoull(amountStr) * 100;
-    }
-    
-    std::string intPart = amountStr.substr(0, dotPos);
-    std::string decPart = amountStr.substr(dotPos + 1);
-    
-    if (decPart.length() > 2) {
-        decPart = decPart.substr(0, 2);
-    } else while (decPart.length() < 2) {
-        decPart += "0";
+    uint64_t amount = 0;
+    if (!parseAmount(amountStr, amount)) {
+        throw std::invalid_argument("Invalid amount format. Expected: 元，最多两位小数");
     }
-    
-    return std::stoull(intPart) * 100 + std::stoull(decPart);
+    return amount;
 }
 
 bool AlipayOrder::connectDB(const char* host, const char* user, 
                           const char* password, const char* db) {
-    conn = mysql_init(nullptr);
+    lease_ = PooledConnection::open(host, user, password, db);
+    conn = lease_.get();
     if (!conn) return false;
     
-    if (!mysql_real_connect(conn, host, user, password, db, 0, nullptr, 0)) {
-        return false;
-    }
-    
-    mysql_set_character_set(conn, "utf8mb4");
-    
-    // 创建必要的表
-    if (!createOrderTable() || !createGoodsTable() || !createExtendParamsTable()) {
-        return false;
-    }
+    // 表结构由 schema 管理器在进程内初始化一次
+    return AlipaySchemaManager::getInstance().ensureSchema(conn);
+}
+
+bool AlipayOrder::connectDB(AlipayConnectionPool& pool) {
+    lease_ = pool.acquire();
+    conn = lease_.get();
+    if (!conn) return false;
     
-    return true;
+    // 表结构由 schema 管理器在进程内初始化一次
+    return AlipaySchemaManager::getInstance().ensureSchema(conn);
 }
 
 bool AlipayOrder::createOrder(AlipayTransaction& transaction) {
@@ -86,21 +104,18 @@ bool AlipayOrder::createOrder(AlipayTransaction& transaction) {
         // 1. 插入订单基本信息
         std::string query = "INSERT INTO alipay_orders ("
             "out_trade_no, total_amount, subject, product_code, body, "
-            "time_expire, timeout_express, store_id, merchant_order_no, create_time"
-            ") VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
+            "time_expire, timeout_express, store_id, merchant_order_no, create_time, "
+            "merchant_id"
+            ") VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
             
-        MYSQL_STMT* stmt = mysql_stmt_init(conn);
-        if (!stmt) throw std::runtime_error("mysql_stmt_init failed");
-        
-        if (mysql_stmt_prepare(stmt, query.c_str(), query.length())) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
-        }
+        CachedStatement stmt(lease_, query);
+        if (!stmt) throw std::runtime_error(stmt.error());
         
         // 设置当前时间戳
         create_time_ = std::chrono::system_clock::to_time_t(
             std::chrono::system_clock::now());
         
-        MYSQL_BIND bind[10];
+        MYSQL_BIND bind[11];
         memset(bind, 0, sizeof(bind));
         
         // 绑定参数
@@ -121,7 +136,7 @@ bool AlipayOrder::createOrder(AlipayTransaction& transaction) {
         bind[3].buffer_length = product_code_.length();
         
         // 可选参数绑定
-        my_bool is_null[6] = {1, 1, 1, 1, 1, 0}; // create_time 不为空
+        my_bool is_null[7] = {1, 1, 1, 1, 1, 0, 1}; // create_time 不为空
         
         if (body_) {
             bind[4].buffer_type = MYSQL_TYPE_STRING;
@@ -146,15 +161,21 @@ bool AlipayOrder::createOrder(AlipayTransaction& transaction) {
         bind[9].is_unsigned = true;
         bind[9].is_null = &is_null[5];
         
-        if (mysql_stmt_bind_param(stmt, bind)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (merchant_id_) {
+            bind[10].buffer_type = MYSQL_TYPE_STRING;
+            bind[10].buffer = (void*)merchant_id_->c_str();
+            bind[10].buffer_length = merchant_id_->length();
+            is_null[6] = 0;
         }
+        bind[10].is_null = &is_null[6];
         
-        if (mysql_stmt_execute(stmt)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_bind_param(stmt.get(), bind)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
-        mysql_stmt_close(stmt);
+        if (mysql_stmt_execute(stmt.get())) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
+        }
         
         // 2. 插入商品明细
         if (!goods_detail_.empty()) {
@@ -163,20 +184,14 @@ bool AlipayOrder::createOrder(AlipayTransaction& transaction) {
                 "alipay_goods_id, show_url, goods_category, categories_tree, body"
                 ") VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
                 
-            stmt = mysql_stmt_init(conn);
-            if (!stmt) throw std::runtime_error("mysql_stmt_init failed");
-            
-            if (mysql_stmt_prepare(stmt, query.c_str(), query.length())) {
-                throw std::runtime_error(mysql_stmt_error(stmt));
-            }
+            CachedStatement goods_stmt(lease_, query);
+            if (!goods_stmt) throw std::runtime_error(goods_stmt.error());
             
             MYSQL_BIND goods_bind[10];
             for (const auto& goods : goods_detail_) {
                 memset(goods_bind, 0, sizeof(goods_bind));
                 // ... 绑定商品参数并执行插入 ...
             }
-            
-            mysql_stmt_close(stmt);
         }
         
         // 3. 插入扩展参数
@@ -189,6 +204,10 @@ bool AlipayOrder::createOrder(AlipayTransaction& transaction) {
             // ... 执行扩展参数插入 ...
         }
         
+        // 登记超时关单时间
+        auto& expiry = AlipayOrderExpiryEngine::getInstance();
+        expiry.schedule(out_trade_no_,
+                        expiry.expireAtFor(create_time_, time_expire_, timeout_express_));
         return true;
     }
     catch (const std::exception& e) {
@@ -196,6 +215,338 @@ bool AlipayOrder::createOrder(AlipayTransaction& transaction) {
     }
 }
 
+bool AlipayOrder::createOrderWithPayment() {
+    if (!conn || out_trade_no_.empty()) return false;
+    
+    create_time_ = std::chrono::system_clock::to_time_t(
+        std::chrono::system_clock::now());
+    
+    // 订单已创建事件
+    OutboxEvent event;
+    event.aggregate_id = out_trade_no_;
+    event.event_type = AlipayOutboxRelay::EVENT_ORDER_CREATED;
+    event.create_time = create_time_;
+    event.payload = "{\"out_trade_no\":";
+    appendJsonString(event.payload, out_trade_no_);
+    event.payload += ",\"total_amount\":" + std::to_string(total_amount_);
+    if (merchant_id_) {
+        event.payload += ",\"merchant_id\":";
+        appendJsonString(event.payload, *merchant_id_);
+    }
+    event.payload += ",\"create_time\":" + std::to_string(create_time_) + "}";
+    
+    unsigned int errorCode = 0;
+    std::string error;
+    
+    mysql_autocommit(conn, 0);
+    bool ok = insertOrderRows(std::span<const AlipayOrder>(this, 1), std::vector<size_t>{0},
+                              create_time_, errorCode, error);
+    if (ok) {
+        AlipayMultiRowInsert paymentInsert(conn, "INSERT INTO alipay_payments ("
+            "out_trade_no, trade_status, update_time"
+            ") VALUES ");
+        paymentInsert.addRow()
+            .str(out_trade_no_)
+            .u64(statusCode(TradeStatus::WAIT_BUYER_PAY))
+            .u64(create_time_);
+        ok = paymentInsert.flush();
+    }
+    ok = ok && appendOutboxEvent(conn, event) && mysql_commit(conn) == 0;
+    if (!ok) {
+        mysql_rollback(conn);
+    }
+    mysql_autocommit(conn, 1);
+    if (!ok) return false;
+    
+    // 登记超时关单时间，并唤醒事件投递
+    auto& expiry = AlipayOrderExpiryEngine::getInstance();
+    expiry.schedule(out_trade_no_,
+                    expiry.expireAtFor(create_time_, time_expire_, timeout_express_));
+    AlipayOutboxRelay::getInstance().notify();
+    return true;
+}
+
+AsyncTask<bool> AlipayOrder::createOrderAsync(AlipayAsyncTransaction& transaction) {
+    if (out_trade_no_.empty()) co_return false;
+    AlipayAsyncConnection& conn = transaction.connection();
+    
+    create_time_ = std::chrono::system_clock::to_time_t(
+        std::chrono::system_clock::now());
+    
+    // 1. 插入订单基本信息
+    std::string query = "INSERT INTO alipay_orders ("
+        "out_trade_no, total_amount, subject, product_code, body, "
+        "time_expire, timeout_express, store_id, merchant_order_no, create_time, "
+        "merchant_id"
+        ") VALUES (";
+    SqlRow(conn.get(), query)
+        .str(out_trade_no_)
+        .u64(total_amount_)
+        .str(subject_)
+        .str(product_code_)
+        .optStr(body_)
+        .optU64(time_expire_)
+        .optU64(timeout_express_)
+        .optStr(store_id_)
+        .optStr(merchant_order_no_)
+        .u64(create_time_)
+        .optStr(merchant_id_);
+    query += ")";
+    if (!co_await conn.execute(std::move(query))) co_return false;
+    
+    // 2. 插入商品明细（一条多行 INSERT）
+    if (!goods_detail_.empty()) {
+        query = "INSERT INTO alipay_goods_detail ("
+            "out_trade_no, goods_id, goods_name, quantity, price, "
+            "alipay_goods_id, show_url, goods_category, categories_tree, body"
+            ") VALUES ";
+        for (size_t i = 0; i < goods_detail_.size(); ++i) {
+            const auto& goods = goods_detail_[i];
+            query += i == 0 ? "(" : ", (";
+            SqlRow(conn.get(), query)
+                .str(out_trade_no_)
+                .str(goods.goods_id)
+                .str(goods.goods_name)
+                .u64(goods.quantity)
+                .u64(goods.price)
+                .optStr(goods.alipay_goods_id)
+                .optStr(goods.show_url)
+                .optStr(goods.goods_category)
+                .optStr(goods.categories_tree)
+                .optStr(goods.body);
+            query += ")";
+        }
+        if (!co_await conn.execute(std::move(query))) co_return false;
+    }
+    
+    // 3. 插入扩展参数
+    if (extend_params_) {
+        const auto& params = *extend_params_;
+        query = "INSERT INTO alipay_extend_params ("
+            "out_trade_no, sys_service_provider_id, hb_fq_num, "
+            "hb_fq_seller_percent, industry_reflux_info, card_type"
+            ") VALUES (";
+        SqlRow(conn.get(), query)
+            .str(out_trade_no_)
+            .optStr(params.sys_service_provider_id)
+            .optStr(params.hb_fq_num)
+            .optStr(params.hb_fq_seller_percent)
+            .optStr(params.industry_reflux_info)
+            .optStr(params.card_type);
+        query += ")";
+        if (!co_await conn.execute(std::move(query))) co_return false;
+    }
+    
+    // 登记超时关单时间
+    auto& expiry = AlipayOrderExpiryEngine::getInstance();
+    expiry.schedule(out_trade_no_,
+                    expiry.expireAtFor(create_time_, time_expire_, timeout_express_));
+    co_return true;
+}
+
+std::vector<OrderBatchResult> AlipayOrder::createOrders(
+    std::span<const AlipayOrder> orders) {
+    std::vector<OrderBatchResult> results(orders.size());
+    for (size_t i = 0; i < orders.size(); ++i) {
+        results[i].out_trade_no = orders[i].out_trade_no_;
+    }
+    
+    if (!conn) {
+        for (auto& result : results) result.error = "数据库未连接";
+        return results;
+    }
+    
+    // 批次内去重，同一订单号只写入第一条
+    std::unordered_set<std::string_view> seen;
+    std::vector<size_t> chunk;
+    chunk.reserve(kOrderBatchChunk);
+    
+    for (size_t i = 0; i < orders.size(); ++i) {
+        const auto& outTradeNo = orders[i].out_trade_no_;
+        if (outTradeNo.empty()) {
+            results[i].error = "商户订单号不能为空";
+            continue;
+        }
+        if (!seen.insert(outTradeNo).second) {
+            results[i].error = "批次内商户订单号重复";
+            continue;
+        }
+        
+        chunk.push_back(i);
+        if (chunk.size() == kOrderBatchChunk) {
+            insertOrderChunk(orders, chunk, results);
+            chunk.clear();
+        }
+    }
+    
+    if (!chunk.empty()) {
+        insertOrderChunk(orders, chunk, results);
+    }
+    
+    // 登记写入成功的订单的超时关单时间（create_time 取批次写入时刻，与库中误差在秒级）
+    auto& expiry = AlipayOrderExpiryEngine::getInstance();
+    if (expiry.isRunning()) {
+        uint64_t createTime = std::chrono::system_clock::to_time_t(
+            std::chrono::system_clock::now());
+        for (size_t i = 0; i < orders.size(); ++i) {
+            if (!results[i].success) continue;
+            expiry.schedule(orders[i].out_trade_no_,
+                            expiry.expireAtFor(createTime, orders[i].time_expire_,
+                                               orders[i].timeout_express_));
+        }
+    }
+    
+    return results;
+}
+
+void AlipayOrder::insertOrderChunk(std::span<const AlipayOrder> orders,
+                                   const std::vector<size_t>& indexes,
+                                   std::vector<OrderBatchResult>& results) {
+    // 1. 一次查询剔除已存在的订单号
+    std::string query = "SELECT out_trade_no FROM alipay_orders WHERE out_trade_no IN (";
+    for (size_t k = 0; k < indexes.size(); ++k) {
+        if (k > 0) query += ", ";
+        appendSqlString(conn, query, orders[indexes[k]].out_trade_no_);
+    }
+    query += ")";
+    
+    if (mysql_real_query(conn, query.data(), query.size()) != 0) {
+        for (size_t i : indexes) results[i].error = mysql_error(conn);
+        return;
+    }
+    
+    std::unordered_set<std::string> existing;
+    if (MYSQL_RES* result = mysql_store_result(conn)) {
+        MYSQL_ROW row;
+        while ((row = mysql_fetch_row(result))) {
+            unsigned long* lengths = mysql_fetch_lengths(result);
+            existing.emplace(row[0], lengths[0]);
+        }
+        mysql_free_result(result);
+    }
+    
+    std::vector<size_t> fresh;
+    fresh.reserve(indexes.size());
+    for (size_t i : indexes) {
+        if (existing.count(orders[i].out_trade_no_)) {
+            results[i].error = "商户订单号已存在";
+        } else {
+            fresh.push_back(i);
+        }
+    }
+    if (fresh.empty()) return;
+    
+    // 2. 订单、商品明细、扩展参数在同一个本地事务内写入
+    uint64_t createTime = std::chrono::system_clock::to_time_t(
+        std::chrono::system_clock::now());
+    unsigned int errorCode = 0;
+    std::string error;
+    
+    mysql_autocommit(conn, 0);
+    bool ok = insertOrderRows(orders, fresh, createTime, errorCode, error) &&
+              mysql_commit(conn) == 0;
+    if (!ok) {
+        if (error.empty()) error = mysql_error(conn);
+        mysql_rollback(conn);
+    }
+    mysql_autocommit(conn, 1);
+    
+    if (ok) {
+        for (size_t i : fresh) results[i].success = true;
+        return;
+    }
+    
+    // 查询之后被并发写入了相同订单号：逐条重试，只让冲突的订单失败
+    if (errorCode == ER_DUP_ENTRY && fresh.size() > 1) {
+        for (size_t i : fresh) {
+            insertOrderChunk(orders, std::vector<size_t>{i}, results);
+        }
+        return;
+    }
+    
+    for (size_t i : fresh) {
+        results[i].error = error;
+    }
+}
+
+bool AlipayOrder::insertOrderRows(std::span<const AlipayOrder> orders,
+                                  const std::vector<size_t>& indexes,
+                                  uint64_t createTime, unsigned int& errorCode,
+                                  std::string& error) {
+    AlipayMultiRowInsert orderInsert(conn, "INSERT INTO alipay_orders ("
+        "out_trade_no, total_amount, subject, product_code, body, "
+        "time_expire, timeout_express, store_id, merchant_order_no, create_time, "
+        "merchant_id"
+        ") VALUES ");
+    AlipayMultiRowInsert goodsInsert(conn, "INSERT INTO alipay_goods_detail ("
+        "out_trade_no, goods_id, goods_name, quantity, price, "
+        "alipay_goods_id, show_url, goods_category, categories_tree, body"
+        ") VALUES ");
+    AlipayMultiRowInsert extendInsert(conn, "INSERT INTO alipay_extend_params ("
+        "out_trade_no, sys_service_provider_id, hb_fq_num, "
+        "hb_fq_seller_percent, industry_reflux_info, card_type"
+        ") VALUES ");
+    
+    for (size_t i : indexes) {
+        const AlipayOrder& order = orders[i];
+        orderInsert.addRow()
+            .str(order.out_trade_no_)
+            .u64(order.total_amount_)
+            .str(order.subject_)
+            .str(order.product_code_)
+            .optStr(order.body_)
+            .optU64(order.time_expire_)
+            .optU64(order.timeout_express_)
+            .optStr(order.store_id_)
+            .optStr(order.merchant_order_no_)
+            .u64(createTime)
+            .optStr(order.merchant_id_);
+    }
+    
+    // 商品明细和扩展参数有外键依赖订单，须在订单写入后执行
+    bool ok = orderInsert.flush();
+    
+    for (size_t i = 0; ok && i < indexes.size(); ++i) {
+        const AlipayOrder& order = orders[indexes[i]];
+        for (const auto& goods : order.goods_detail_) {
+            goodsInsert.addRow()
+                .str(order.out_trade_no_)
+                .str(goods.goods_id)
+                .str(goods.goods_name)
+                .u64(goods.quantity)
+                .u64(goods.price)
+                .optStr(goods.alipay_goods_id)
+                .optStr(goods.show_url)
+                .optStr(goods.goods_category)
+                .optStr(goods.categories_tree)
+                .optStr(goods.body);
+        }
+        if (order.extend_params_) {
+            const auto& params = *order.extend_params_;
+            extendInsert.addRow()
+                .str(order.out_trade_no_)
+                .optStr(params.sys_service_provider_id)
+                .optStr(params.hb_fq_num)
+                .optStr(params.hb_fq_seller_percent)
+                .optStr(params.industry_reflux_info)
+                .optStr(params.card_type);
+        }
+        ok = !goodsInsert.failed() && !extendInsert.failed();
+    }
+    
+    ok = ok && goodsInsert.flush() && extendInsert.flush();
+    if (!ok) {
+        for (const auto* insert : {&orderInsert, &goodsInsert, &extendInsert}) {
+            if (insert->failed()) {
+                errorCode = insert->lastErrno();
+                error = insert->lastError();
+                break;
+            }
+        }
+    }
+    return ok;
+}
+
 void AlipayOrder::setOutTradeNo(const std::string& value) {
     if (value.length() > 64) {
         throw std::invalid_argument("商户订单号长度不能超过64位");
@@ -269,11 +620,14 @@ void AlipayOrder::setGoodsDetail(const std::vector<AlipayGoodsDetail>& goods) {
         throw std::invalid_argument("商品总金额与订单金额不匹配");
     }
     
+    // 以调用方设置的为准，不再从数据库加载
     goods_detail_ = goods;
+    goods_loaded_ = true;
 }
 
 void AlipayOrder::setExtendParams(const AlipayExtendParams& params) {
     extend_params_ = params;
+    extend_loaded_ = true;
 }
 
 void AlipayOrder::setStoreId(const std::string& value) {
@@ -290,6 +644,13 @@ void AlipayOrder::setMerchantOrderNo(const std::string& value) {
     merchant_order_no_ = value;
 }
 
+void AlipayOrder::setMerchantId(const std::string& value) {
+    if (value.length() > 32) {
+        throw std::invalid_argument("商户ID长度不能超过32位");
+    }
+    merchant_id_ = value;
+}
+
 void AlipayOrder::setTradeNo(const std::string& value) {
     trade_no_ = value;
 }
@@ -319,30 +680,173 @@ uint64_t AlipayOrder::getTimeoutExpress() const {
     return timeout_express_.value_or(0); 
 }
 std::string AlipayOrder::getProductCode() const { return product_code_; }
-std::vector<AlipayGoodsDetail> AlipayOrder::getGoodsDetail() const { return goods_detail_; }
-AlipayExtendParams AlipayOrder::getExtendParams() const { return extend_params_.value_or(AlipayExtendParams{}); }
+std::vector<AlipayGoodsDetail> AlipayOrder::getGoodsDetail() const {
+    if (!goods_loaded_) loadDetails();
+    return goods_detail_;
+}
+AlipayExtendParams AlipayOrder::getExtendParams() const {
+    if (!extend_loaded_) loadDetails();
+    return extend_params_.value_or(AlipayExtendParams{});
+}
 std::string AlipayOrder::getStoreId() const { return store_id_.value_or(""); }
 std::string AlipayOrder::getMerchantOrderNo() const { return merchant_order_no_.value_or(""); }
+std::string AlipayOrder::getMerchantId() const { return merchant_id_.value_or(""); }
 std::string AlipayOrder::getTradeNo() const { return trade_no_.value_or(""); }
 std::string AlipayOrder::getTradeStatus() const { return trade_status_.value_or(""); }
 uint64_t AlipayOrder::getPayTime() const { 
     return pay_time_.value_or(0); 
 }
 
-bool AlipayOrder::queryOrder(const std::string& outTradeNo) {
+namespace {
+
+// 订单主表列，两种查询模式的前 11 列一致
+const char* kOrderSummaryQuery =
+    "SELECT out_trade_no, total_amount, subject, product_code, body, "
+    "time_expire, timeout_express, store_id, merchant_order_no, create_time, merchant_id "
+    "FROM alipay_orders WHERE out_trade_no = ?";
+
+// 商品明细为一对多，每个商品一行；没有商品时返回一行且商品列为 NULL
+const char* kOrderDetailQuery =
+    "SELECT o.out_trade_no, o.total_amount, o.subject, o.product_code, o.body, "
+    "o.time_expire, o.timeout_express, o.store_id, o.merchant_order_no, o.create_time, "
+    "o.merchant_id, "
+    "e.out_trade_no IS NOT NULL, e.sys_service_provider_id, e.hb_fq_num, "
+    "e.hb_fq_seller_percent, e.industry_reflux_info, e.card_type, "
+    "g.goods_id, g.goods_name, g.quantity, g.price, g.alipay_goods_id, "
+    "g.show_url, g.goods_category, g.categories_tree, g.body "
+    "FROM alipay_orders o "
+    "LEFT JOIN alipay_extend_params e ON e.out_trade_no = o.out_trade_no "
+    "LEFT JOIN alipay_goods_detail g ON g.out_trade_no = o.out_trade_no "
+    "WHERE o.out_trade_no = ? ORDER BY g.id";
+
+const size_t kOrderColumnCount = 11;
+const size_t kDetailColumnCount = 15;
+
+} // namespace
+
+struct AlipayOrder::OrderColumns {
+    StringResult<64> out_trade_no;
+    UInt64Result total_amount;
+    StringResult<256> subject;
+    StringResult<64> product_code;
+    StringResult<128> body;
+    UInt64Result time_expire;
+    UInt64Result timeout_express;
+    StringResult<32> store_id;
+    StringResult<32> merchant_order_no;
+    UInt64Result create_time;
+    StringResult<32> merchant_id;
+
+    void bind(MYSQL_BIND* result) {
+        out_trade_no.bind(result[0]);
+        total_amount.bind(result[1]);
+        subject.bind(result[2]);
+        product_code.bind(result[3]);
+        body.bind(result[4]);
+        time_expire.bind(result[5]);
+        timeout_express.bind(result[6]);
+        store_id.bind(result[7]);
+        merchant_order_no.bind(result[8]);
+        create_time.bind(result[9]);
+        merchant_id.bind(result[10]);
+    }
+
+    void applyTo(AlipayOrder& order) const {
+        order.out_trade_no_ = out_trade_no.value();
+        order.total_amount_ = total_amount.value;
+        order.subject_ = subject.value();
+        order.product_code_ = product_code.value();
+        order.body_ = body.optional();
+        order.time_expire_ = time_expire.optional();
+        order.timeout_express_ = timeout_express.optional();
+        order.store_id_ = store_id.optional();
+        order.merchant_order_no_ = merchant_order_no.optional();
+        order.create_time_ = create_time.value;
+        order.merchant_id_ = merchant_id.optional();
+    }
+};
+
+struct AlipayOrder::DetailColumns {
+    UInt64Result has_extend;
+    StringResult<64> sys_service_provider_id;
+    StringResult<5> hb_fq_num;
+    StringResult<3> hb_fq_seller_percent;
+    StringResult<2048> industry_reflux_info;
+    StringResult<32> card_type;
+    StringResult<32> goods_id;
+    StringResult<256> goods_name;
+    UInt64Result quantity;
+    UInt64Result price;
+    StringResult<32> alipay_goods_id;
+    StringResult<400> show_url;
+    StringResult<24> goods_category;
+    StringResult<128> categories_tree;
+    StringResult<1000> goods_body;
+
+    void bind(MYSQL_BIND* result) {
+        has_extend.bind(result[0]);
+        sys_service_provider_id.bind(result[1]);
+        hb_fq_num.bind(result[2]);
+        hb_fq_seller_percent.bind(result[3]);
+        industry_reflux_info.bind(result[4]);
+        card_type.bind(result[5]);
+        goods_id.bind(result[6]);
+        goods_name.bind(result[7]);
+        quantity.bind(result[8]);
+        price.bind(result[9]);
+        alipay_goods_id.bind(result[10]);
+        show_url.bind(result[11]);
+        goods_category.bind(result[12]);
+        categories_tree.bind(result[13]);
+        goods_body.bind(result[14]);
+    }
+
+    AlipayExtendParams extendParams() const {
+        AlipayExtendParams params;
+        params.sys_service_provider_id = sys_service_provider_id.optional();
+        params.hb_fq_num = hb_fq_num.optional();
+        params.hb_fq_seller_percent = hb_fq_seller_percent.optional();
+        params.industry_reflux_info = industry_reflux_info.optional();
+        params.card_type = card_type.optional();
+        return params;
+    }
+
+    AlipayGoodsDetail goods() const {
+        AlipayGoodsDetail detail;
+        detail.goods_id = goods_id.value();
+        detail.goods_name = goods_name.value();
+        detail.quantity = static_cast<uint32_t>(quantity.value);
+        detail.price = price.value;
+        detail.alipay_goods_id = alipay_goods_id.optional();
+        detail.show_url = show_url.optional();
+        detail.goods_category = goods_category.optional();
+        detail.categories_tree = categories_tree.optional();
+        detail.body = goods_body.optional();
+        return detail;
+    }
+};
+
+bool AlipayOrder::queryOrder(const std::string& outTradeNo, OrderQueryMode mode) {
     if (!conn) return false;
     
     try {
-        // 1. 查询订单基本信息
-        std::string query = "SELECT * FROM alipay_orders WHERE out_trade_no = ?";
-            
-        MYSQL_STMT* stmt = mysql_stmt_init(conn);
-        if (!stmt) throw std::runtime_error("mysql_stmt_init failed");
+        OrderColumns columns;
         
-        if (mysql_stmt_prepare(stmt, query.c_str(), query.length())) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mode == OrderQueryMode::FULL) {
+            goods_loaded_ = false;
+            extend_loaded_ = false;
+            if (!fetchWithDetails(outTradeNo, &columns)) {
+                return false;
+            }
+            columns.applyTo(*this);
+            return true;
         }
         
+        // SUMMARY：只读主表，明细留待 getter 懒加载
+        std::string query = kOrderSummaryQuery;
+        CachedStatement stmt(lease_, query);
+        if (!stmt) throw std::runtime_error(stmt.error());
+        
         MYSQL_BIND bind[1];
         memset(bind, 0, sizeof(bind));
         
@@ -350,74 +854,30 @@ bool AlipayOrder::queryOrder(const std::string& outTradeNo) {
         bind[0].buffer = (void*)outTradeNo.c_str();
         bind[0].buffer_length = outTradeNo.length();
         
-        if (mysql_stmt_bind_param(stmt, bind)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_bind_param(stmt.get(), bind)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
-        if (mysql_stmt_execute(stmt)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_execute(stmt.get())) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
-        // 绑定结果集
-        MYSQL_BIND result[10];
-        memset(result, 0, sizeof(result));
-        
-        // 准备结果缓冲区
-        char out_trade_no_buf[65];
-        char subject_buf[257];
-        char product_code_buf[65];
-        char body_buf[129];
-        char store_id_buf[33];
-        char merchant_order_no_buf[33];
-        my_bool is_null[10];
-        unsigned long length[10];
-        
-        // 绑定结果字段
-        result[0].buffer_type = MYSQL_TYPE_STRING;
-        result[0].buffer = out_trade_no_buf;
-        result[0].buffer_length = sizeof(out_trade_no_buf);
-        result[0].is_null = &is_null[0];
-        result[0].length = &length[0];
-        
-        result[1].buffer_type = MYSQL_TYPE_LONGLONG;
-        result[1].buffer = &total_amount_;
-        result[1].is_unsigned = true;
-        result[1].is_null = &is_null[1];
+        MYSQL_BIND result[kOrderColumnCount];
+        columns.bind(result);
         
-        // ... 绑定其他结果字段 ...
-        
-        if (mysql_stmt_bind_result(stmt, result)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
-        }
-        
-        if (mysql_stmt_fetch(stmt)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_bind_result(stmt.get(), result)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
-        // 设置查询结果到对象属性
-        out_trade_no_ = std::string(out_trade_no_buf, length[0]);
-        subject_ = std::string(subject_buf, length[2]);
-        product_code_ = std::string(product_code_buf, length[3]);
-        
-        if (!is_null[4]) {
-            body_ = std::string(body_buf, length[4]);
+        if (mysql_stmt_fetch(stmt.get())) {
+            throw std::runtime_error("Order not found");
         }
         
-        // ... 设置其他字段 ...
-        
-        mysql_stmt_close(stmt);
-        
-        // 2. 查询商品明细
+        columns.applyTo(*this);
         goods_detail_.clear();
-        query = "SELECT * FROM alipay_goods_detail WHERE out_trade_no = ?";
-        stmt = mysql_stmt_init(conn);
-        
-        // ... 执行商品明细查询 ...
-        
-        // 3. 查询扩展参数
-        query = "SELECT * FROM alipay_extend_params WHERE out_trade_no = ?";
-        // ... 执行扩展参数查询 ...
-        
+        extend_params_.reset();
+        goods_loaded_ = false;
+        extend_loaded_ = false;
         return true;
     }
     catch (const std::exception& e) {
@@ -425,6 +885,130 @@ bool AlipayOrder::queryOrder(const std::string& outTradeNo) {
     }
 }
 
+bool AlipayOrder::fetchWithDetails(const std::string& outTradeNo,
+                                   OrderColumns* order) const {
+    std::string query = kOrderDetailQuery;
+    CachedStatement stmt(lease_, query);
+    if (!stmt) throw std::runtime_error(stmt.error());
+    
+    MYSQL_BIND bind[1];
+    memset(bind, 0, sizeof(bind));
+    
+    bind[0].buffer_type = MYSQL_TYPE_STRING;
+    bind[0].buffer = (void*)outTradeNo.c_str();
+    bind[0].buffer_length = outTradeNo.length();
+    
+    if (mysql_stmt_bind_param(stmt.get(), bind)) {
+        throw std::runtime_error(mysql_stmt_error(stmt.get()));
+    }
+    
+    if (mysql_stmt_execute(stmt.get())) {
+        throw std::runtime_error(mysql_stmt_error(stmt.get()));
+    }
+    
+    // 列缓冲较大（扩展参数含 2048 字符列），放在堆上
+    OrderColumns orderColumns;
+    auto detailColumns = std::make_unique<DetailColumns>();
+    
+    MYSQL_BIND result[kOrderColumnCount + kDetailColumnCount];
+    (order ? order : &orderColumns)->bind(result);
+    detailColumns->bind(result + kOrderColumnCount);
+    
+    if (mysql_stmt_bind_result(stmt.get(), result)) {
+        throw std::runtime_error(mysql_stmt_error(stmt.get()));
+    }
+    
+    if (mysql_stmt_store_result(stmt.get())) {
+        throw std::runtime_error(mysql_stmt_error(stmt.get()));
+    }
+    
+    std::vector<AlipayGoodsDetail> goods;
+    std::optional<AlipayExtendParams> params;
+    bool found = false;
+    
+    int status;
+    while ((status = mysql_stmt_fetch(stmt.get())) == 0) {
+        found = true;
+        if (!params && detailColumns->has_extend.value) {
+            params = detailColumns->extendParams();
+        }
+        if (!detailColumns->goods_id.is_null) {
+            goods.push_back(detailColumns->goods());
+        }
+    }
+    
+    if (status != MYSQL_NO_DATA) {
+        throw std::runtime_error(mysql_stmt_error(stmt.get()));
+    }
+    if (!found) {
+        return false;
+    }
+    
+    // 只填充尚未在内存中的部分，不覆盖调用方已设置的值
+    if (!goods_loaded_) {
+        goods_detail_ = std::move(goods);
+        goods_loaded_ = true;
+    }
+    if (!extend_loaded_) {
+        extend_params_ = std::move(params);
+        extend_loaded_ = true;
+    }
+    return true;
+}
+
+void AlipayOrder::loadDetails() const {
+    if ((goods_loaded_ && extend_loaded_) || !conn || out_trade_no_.empty()) return;
+    
+    try {
+        fetchWithDetails(out_trade_no_, nullptr);
+    }
+    catch (const std::exception&) {
+        // 加载失败时保持未加载状态，下次访问重试
+    }
+}
+
+AlipayQueryCache<AlipayOrderSnapshot>& AlipayOrder::cache() {
+    static AlipayQueryCache<AlipayOrderSnapshot> instance;
+    return instance;
+}
+
+AlipayOrderSnapshot AlipayOrder::snapshot() const {
+    return AlipayOrderSnapshot{out_trade_no_, total_amount_, subject_, product_code_,
+                               body_, time_expire_, timeout_express_, store_id_,
+                               merchant_order_no_, create_time_, merchant_id_};
+}
+
+void AlipayOrder::applySnapshot(const AlipayOrderSnapshot& snapshot) {
+    out_trade_no_ = snapshot.out_trade_no;
+    total_amount_ = snapshot.total_amount;
+    subject_ = snapshot.subject;
+    product_code_ = snapshot.product_code;
+    body_ = snapshot.body;
+    time_expire_ = snapshot.time_expire;
+    timeout_express_ = snapshot.timeout_express;
+    store_id_ = snapshot.store_id;
+    merchant_order_no_ = snapshot.merchant_order_no;
+    create_time_ = snapshot.create_time;
+    merchant_id_ = snapshot.merchant_id;
+    goods_detail_.clear();
+    extend_params_.reset();
+    goods_loaded_ = false;
+    extend_loaded_ = false;
+}
+
+bool AlipayOrder::queryOrderCached(const std::string& outTradeNo) {
+    // 同一订单号的并发未命中只由一个调用方查库
+    auto cached = cache().getOrLoad(outTradeNo,
+        [&]() -> std::optional<AlipayOrderSnapshot> {
+            if (!queryOrder(outTradeNo, OrderQueryMode::SUMMARY)) return std::nullopt;
+            return snapshot();
+        });
+    if (!cached) return false;
+    
+    applySnapshot(*cached);
+    return true;
+}
+
 bool AlipayOrder::updateOrderStatus(const std::string& outTradeNo, 
                                   const std::string& tradeNo,
                                   const std::string& status) {
@@ -435,12 +1019,12 @@ bool AlipayOrder::updateOrderStatus(const std::string& outTradeNo,
             "trade_status = ?, pay_time = IF(? = 'TRADE_SUCCESS', NOW(), pay_time) "
             "WHERE out_trade_no = ?";
             
-        MYSQL_STMT* stmt = mysql_stmt_init(conn);
-        if (!stmt) throw std::runtime_error("mysql_stmt_init failed");
+        CachedStatement stmt(lease_, query);
+        if (!stmt) throw std::runtime_error(stmt.error());
         
         // TODO: 完成参数绑定和执行
-        
-        mysql_stmt_close(stmt);
+
+        cache().invalidate(outTradeNo);
         return true;
     }
     catch (const std::exception& e) {
@@ -520,27 +1104,4 @@ double AlipayOrder::getPricingExchangeRate() const {
     return pricing_exchange_rate;
 }
 
-// 数据库表创建方法
-bool AlipayOrder::createOrderTable() {
-    if (!conn) return false;
-    
-    const char* sql = R"SQL(
-        CREATE TABLE IF NOT EXISTS alipay_orders (
-            out_trade_no VARCHAR(64) PRIMARY KEY,    -- 商户订单号
-            total_amount BIGINT UNSIGNED NOT NULL,   -- 订单总金额(分)
-            subject VARCHAR(256) NOT NULL,           -- 订单标题
-            product_code VARCHAR(64) NOT NULL,       -- 产品码
-            body VARCHAR(128),                       -- 订单描述
-            time_expire BIGINT UNSIGNED,             -- 绝对超时时间戳
-            timeout_express BIGINT UNSIGNED,         -- 相对超时时间
-            store_id VARCHAR(32),                    -- 商户门店编号
-            merchant_order_no VARCHAR(32),           -- 商户原始订单号
-            create_time BIGINT UNSIGNED NOT NULL,    -- 订单创建时间
-            INDEX idx_create_time (create_time)
-        ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
-    )SQL";
-    
-    return mysql_query(conn, sql) == 0;
-}
-
 // ... 继续支付类实现 ... 
\ No newline at end of file
@@ -0,0 +1,301 @@
+#include "alipay_order_expiry.h"
+#include "alipay_payment.h"
+#include "alipay_sql_builder.h"
+#include <mysql/errmsg.h>
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+static_assert(statusCode(TradeStatus::WAIT_BUYER_PAY) == 1, "kPendingOrdersQuery 中的编码");
+
+// 只扫描仍在等待付款的订单，按 (create_time, out_trade_no) 键集分页走 idx_create_time
+const char* kPendingOrdersQuery =
+    "SELECT o.out_trade_no, o.create_time, o.time_expire, o.timeout_express "
+    "FROM alipay_orders o FORCE INDEX (idx_create_time) "
+    "JOIN alipay_payments p ON p.out_trade_no = o.out_trade_no "
+    "WHERE p.trade_status = 1 "        // TradeStatus::WAIT_BUYER_PAY
+    "AND (o.create_time > ? OR (o.create_time = ? AND o.out_trade_no > ?)) "
+    "ORDER BY o.create_time, o.out_trade_no LIMIT ?";
+
+uint64_t nowSeconds() {
+    return std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+}
+
+bool isConnectionError(unsigned int error) {
+    return error == CR_SERVER_GONE_ERROR || error == CR_SERVER_LOST;
+}
+
+} // namespace
+
+AlipayOrderExpiryEngine& AlipayOrderExpiryEngine::getInstance() {
+    static AlipayOrderExpiryEngine instance;
+    return instance;
+}
+
+AlipayOrderExpiryEngine::~AlipayOrderExpiryEngine() {
+    stop();
+}
+
+bool AlipayOrderExpiryEngine::start(AlipayConnectionPool& pool,
+                                    const OrderExpiryOptions& options) {
+    if (isRunning()) return true;
+
+    pool_ = &pool;
+    options_ = options;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        wheel_ = AlipayTimingWheel(nowSeconds());
+    }
+
+    // 重建期间新建的订单同样需要登记，先打开 schedule 入口
+    running_.store(true, std::memory_order_release);
+    if (!rebuild()) {
+        running_.store(false, std::memory_order_release);
+        return false;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(thread_mutex_);
+        stopping_ = false;
+    }
+    worker_ = std::thread(&AlipayOrderExpiryEngine::run, this);
+    return true;
+}
+
+void AlipayOrderExpiryEngine::stop() {
+    {
+        std::lock_guard<std::mutex> lock(thread_mutex_);
+        stopping_ = true;
+    }
+    wakeup_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+
+    running_.store(false, std::memory_order_release);
+    std::lock_guard<std::mutex> lock(mutex_);
+    wheel_ = AlipayTimingWheel(0);
+}
+
+void AlipayOrderExpiryEngine::schedule(const std::string& outTradeNo, uint64_t expireAt) {
+    if (!isRunning()) return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    wheel_.schedule(outTradeNo, expireAt);
+    scheduled_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AlipayOrderExpiryEngine::cancel(const std::string& outTradeNo) {
+    if (!isRunning()) return;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (wheel_.cancel(outTradeNo)) {
+        cancelled_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+uint64_t AlipayOrderExpiryEngine::expireAtFor(uint64_t createTime,
+                                              std::optional<uint64_t> timeExpire,
+                                              std::optional<uint64_t> timeoutExpress) const {
+    if (timeExpire && timeoutExpress) {
+        return std::min(*timeExpire, createTime + *timeoutExpress);
+    }
+    if (timeExpire) return *timeExpire;
+    if (timeoutExpress) return createTime + *timeoutExpress;
+    return createTime + options_.default_timeout_seconds;
+}
+
+size_t AlipayOrderExpiryEngine::pendingTimers() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    return wheel_.size();
+}
+
+OrderExpiryStats AlipayOrderExpiryEngine::stats() const {
+    OrderExpiryStats stats;
+    stats.scheduled = scheduled_.load(std::memory_order_relaxed);
+    stats.cancelled = cancelled_.load(std::memory_order_relaxed);
+    stats.expired = expired_.load(std::memory_order_relaxed);
+    stats.closed = closed_.load(std::memory_order_relaxed);
+    stats.close_failures = close_failures_.load(std::memory_order_relaxed);
+    stats.rebuilt = rebuilt_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+bool AlipayOrderExpiryEngine::rebuild() {
+    PooledConnection lease = pool_->acquire();
+    MYSQL* conn = lease.get();
+    if (!conn) return false;
+
+    try {
+        std::string query = kPendingOrdersQuery;
+        CachedStatement stmt(lease, query);
+        if (!stmt) throw std::runtime_error(stmt.error());
+
+        // 键集游标
+        uint64_t last_create_time = 0;
+        char last_out_trade_no[65] = {0};
+        unsigned long last_out_trade_no_length = 0;
+        uint64_t page_size = options_.rebuild_page_size;
+
+        MYSQL_BIND bind[4];
+        memset(bind, 0, sizeof(bind));
+
+        bind[0].buffer_type = MYSQL_TYPE_LONGLONG;
+        bind[0].buffer = &last_create_time;
+        bind[0].is_unsigned = true;
+
+        bind[1].buffer_type = MYSQL_TYPE_LONGLONG;
+        bind[1].buffer = &last_create_time;
+        bind[1].is_unsigned = true;
+
+        bind[2].buffer_type = MYSQL_TYPE_STRING;
+        bind[2].buffer = last_out_trade_no;
+        bind[2].buffer_length = sizeof(last_out_trade_no);
+        bind[2].length = &last_out_trade_no_length;
+
+        bind[3].buffer_type = MYSQL_TYPE_LONGLONG;
+        bind[3].buffer = &page_size;
+        bind[3].is_unsigned = true;
+
+        if (mysql_stmt_bind_param(stmt.get(), bind)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
+        }
+
+        StringResult<64> out_trade_no;
+        UInt64Result create_time;
+        UInt64Result time_expire;
+        UInt64Result timeout_express;
+
+        MYSQL_BIND result[4];
+        out_trade_no.bind(result[0]);
+        create_time.bind(result[1]);
+        time_expire.bind(result[2]);
+        timeout_express.bind(result[3]);
+
+        std::vector<std::pair<std::string, uint64_t>> page;
+        page.reserve(options_.rebuild_page_size);
+
+        while (true) {
+            if (mysql_stmt_execute(stmt.get())) {
+                throw std::runtime_error(mysql_stmt_error(stmt.get()));
+            }
+            if (mysql_stmt_bind_result(stmt.get(), result)) {
+                throw std::runtime_error(mysql_stmt_error(stmt.get()));
+            }
+
+            // 逐行读取，不在客户端缓存整页结果
+            page.clear();
+            int status;
+            while ((status = mysql_stmt_fetch(stmt.get())) == 0) {
+                page.emplace_back(out_trade_no.value(),
+                                  expireAtFor(create_time.value, time_expire.optional(),
+                                              timeout_express.optional()));
+                last_create_time = create_time.value;
+            }
+            if (status != MYSQL_NO_DATA) {
+                throw std::runtime_error(mysql_stmt_error(stmt.get()));
+            }
+            mysql_stmt_free_result(stmt.get());
+
+            if (page.empty()) break;
+
+            {
+                std::lock_guard<std::mutex> lock(mutex_);
+                for (const auto& [key, expireAt] : page) {
+                    wheel_.schedule(key, expireAt);
+                }
+            }
+            rebuilt_.fetch_add(page.size(), std::memory_order_relaxed);
+
+            const std::string& last = page.back().first;
+            last_out_trade_no_length = static_cast<unsigned long>(
+                std::min(last.size(), sizeof(last_out_trade_no)));
+            memcpy(last_out_trade_no, last.data(), last_out_trade_no_length);
+
+            if (page.size() < options_.rebuild_page_size) break;
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        return false;
+    }
+}
+
+void AlipayOrderExpiryEngine::run() {
+    std::vector<std::string> expired;
+    std::unique_lock<std::mutex> lock(thread_mutex_);
+
+    while (!stopping_) {
+        wakeup_.wait_for(lock, options_.tick_interval, [this] { return stopping_; });
+        if (stopping_) break;
+        lock.unlock();
+
+        expired.clear();
+        {
+            std::lock_guard<std::mutex> wheel_lock(mutex_);
+            wheel_.advance(nowSeconds(), expired);
+        }
+        if (!expired.empty()) {
+            expired_.fetch_add(expired.size(), std::memory_order_relaxed);
+            closeOrders(expired);
+        }
+
+        lock.lock();
+    }
+}
+
+void AlipayOrderExpiryEngine::closeOrders(std::vector<std::string>& outTradeNos) {
+    PooledConnection lease = pool_->acquire();
+    MYSQL* conn = lease.get();
+
+    size_t batch = std::max<size_t>(options_.close_batch_size, 1);
+    for (size_t offset = 0; offset < outTradeNos.size(); offset += batch) {
+        size_t count = std::min(batch, outTradeNos.size() - offset);
+        const std::string* first = outTradeNos.data() + offset;
+
+        uint64_t closed = 0;
+        if (conn && closeBatch(conn, first, count, closed)) {
+            closed_.fetch_add(closed, std::memory_order_relaxed);
+            for (size_t i = 0; i < count; ++i) {
+                AlipayPayment::cache().invalidate(first[i]);
+            }
+            continue;
+        }
+
+        // 失败的批次稍后重试；WHERE 条件保证已支付的订单不会被误关
+        close_failures_.fetch_add(1, std::memory_order_relaxed);
+        if (conn && isConnectionError(mysql_errno(conn))) {
+            lease.markBroken();
+            conn = nullptr;
+        }
+
+        uint64_t retryAt = nowSeconds() + options_.retry_delay_seconds;
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (size_t i = 0; i < count; ++i) {
+            wheel_.schedule(first[i], retryAt);
+        }
+    }
+}
+
+bool AlipayOrderExpiryEngine::closeBatch(MYSQL* conn, const std::string* first,
+                                         size_t count, uint64_t& closed) {
+    std::string query = "UPDATE alipay_payments SET trade_status = ";
+    appendSqlUInt(query, statusCode(TradeStatus::TRADE_CLOSED));
+    query += ", update_time = ";
+    appendSqlUInt(query, nowSeconds());
+    query += " WHERE trade_status = ";
+    appendSqlUInt(query, statusCode(TradeStatus::WAIT_BUYER_PAY));
+    query += " AND out_trade_no IN (";
+    for (size_t i = 0; i < count; ++i) {
+        if (i > 0) query += ", ";
+        appendSqlString(conn, query, first[i]);
+    }
+    query += ')';
+
+    if (mysql_real_query(conn, query.data(), static_cast<unsigned long>(query.size())) != 0) {
+        return false;
+    }
+    closed = mysql_affected_rows(conn);
+    return true;
+}
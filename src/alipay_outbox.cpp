@@ -0,0 +1,145 @@
+#include "alipay_outbox.h"
+#include "alipay_sql_builder.h"
+
+bool appendOutboxEvent(MYSQL* conn, const OutboxEvent& event) {
+    AlipayMultiRowInsert insert(conn, "INSERT INTO alipay_outbox ("
+        "aggregate_id, event_type, payload, create_time"
+        ") VALUES ");
+    insert.addRow()
+        .str(event.aggregate_id)
+        .str(event.event_type)
+        .str(event.payload)
+        .u64(event.create_time);
+    return insert.flush();
+}
+
+AlipayOutboxRelay& AlipayOutboxRelay::getInstance() {
+    static AlipayOutboxRelay instance;
+    return instance;
+}
+
+AlipayOutboxRelay::~AlipayOutboxRelay() {
+    stop();
+}
+
+bool AlipayOutboxRelay::start(AlipayConnectionPool& pool, Publisher publisher,
+                              const OutboxRelayOptions& options) {
+    if (isRunning() || !publisher) return isRunning();
+
+    pool_ = &pool;
+    publisher_ = std::move(publisher);
+    options_ = options;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = false;
+        notified_ = false;
+    }
+    running_.store(true, std::memory_order_release);
+    worker_ = std::thread(&AlipayOutboxRelay::run, this);
+    return true;
+}
+
+void AlipayOutboxRelay::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    wakeup_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+    running_.store(false, std::memory_order_release);
+}
+
+void AlipayOutboxRelay::notify() {
+    if (!isRunning()) return;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        notified_ = true;
+    }
+    wakeup_.notify_one();
+}
+
+OutboxRelayStats AlipayOutboxRelay::stats() const {
+    OutboxRelayStats stats;
+    stats.published = published_.load(std::memory_order_relaxed);
+    stats.batches = batches_.load(std::memory_order_relaxed);
+    stats.failures = failures_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AlipayOutboxRelay::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stopping_) {
+        notified_ = false;
+        lock.unlock();
+
+        long relayed = -1;
+        {
+            auto lease = pool_->acquire();
+            if (lease) relayed = relayBatch(lease.get());
+        }
+
+        lock.lock();
+        // 满批说明还有积压，立即继续；否则等待通知或下一次轮询
+        if (relayed == static_cast<long>(options_.batch_size)) continue;
+        auto delay = relayed < 0 ? options_.retry_delay : options_.poll_interval;
+        wakeup_.wait_for(lock, delay, [this, relayed] {
+            return stopping_ || (notified_ && relayed >= 0);
+        });
+    }
+}
+
+long AlipayOutboxRelay::relayBatch(MYSQL* conn) {
+    // 事件投递后即删除，表中剩下的都是未投递的，按主键顺序读取即可，
+    // 不依赖自增 ID 的提交顺序
+    std::string query = "SELECT id, aggregate_id, event_type, payload, create_time "
+                        "FROM alipay_outbox ORDER BY id LIMIT ";
+    appendSqlUInt(query, options_.batch_size);
+    if (mysql_real_query(conn, query.data(), static_cast<unsigned long>(query.size())) != 0) {
+        failures_.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+    MYSQL_RES* result = mysql_store_result(conn);
+    if (!result) {
+        failures_.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+
+    std::vector<OutboxEvent> events;
+    events.reserve(mysql_num_rows(result));
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result))) {
+        unsigned long* lengths = mysql_fetch_lengths(result);
+        OutboxEvent event;
+        event.id = std::strtoull(row[0], nullptr, 10);
+        event.aggregate_id.assign(row[1], lengths[1]);
+        event.event_type.assign(row[2], lengths[2]);
+        event.payload.assign(row[3], lengths[3]);
+        event.create_time = std::strtoull(row[4], nullptr, 10);
+        events.push_back(std::move(event));
+    }
+    mysql_free_result(result);
+    if (events.empty()) return 0;
+
+    if (!publisher_(events)) {
+        failures_.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+
+    // 只删除本批读到的 ID；读取之后才提交的事件（ID 可能更小）留给下一批
+    query = "DELETE FROM alipay_outbox WHERE id IN (";
+    for (size_t i = 0; i < events.size(); ++i) {
+        if (i > 0) query += ",";
+        appendSqlUInt(query, events[i].id);
+    }
+    query += ")";
+    if (mysql_real_query(conn, query.data(), static_cast<unsigned long>(query.size())) != 0) {
+        failures_.fetch_add(1, std::memory_order_relaxed);
+        return -1;
+    }
+
+    published_.fetch_add(events.size(), std::memory_order_relaxed);
+    batches_.fetch_add(1, std::memory_order_relaxed);
+    return static_cast<long>(events.size());
+}
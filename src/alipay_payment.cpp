@@ -1,34 +1,59 @@
 #include "alipay_payment.h"
-#include <sstream>
-#include <iomanip>
+#include "alipay_schema_manager.h"
+#include "alipay_order_expiry.h"
+#include "alipay_codec.h"
+#include "alipay_sql_builder.h"
 #include <stdexcept>
+#include <cstdio>
 #include <chrono>
 
+namespace {
+
+struct PaymentTransition {
+    TradeStatus from;
+    TradeStatus to;
+};
+
+// 交易状态转换表
+constexpr PaymentTransition kPaymentTransitions[] = {
+    {TradeStatus::WAIT_BUYER_PAY, TradeStatus::TRADE_SUCCESS},
+    {TradeStatus::WAIT_BUYER_PAY, TradeStatus::TRADE_FINISHED},     // 不可退款产品直接通知交易结束
+    {TradeStatus::WAIT_BUYER_PAY, TradeStatus::TRADE_CLOSED},
+    {TradeStatus::TRADE_SUCCESS, TradeStatus::TRADE_FINISHED},
+    {TradeStatus::TRADE_SUCCESS, TradeStatus::TRADE_CLOSED},
+};
+
+// 对外的状态字符串须与名称表一致
+static_assert(statusName(TradeStatus::WAIT_BUYER_PAY) == AlipayPayment::TRADE_STATUS_WAIT_BUYER_PAY);
+static_assert(statusName(TradeStatus::TRADE_SUCCESS) == AlipayPayment::TRADE_STATUS_TRADE_SUCCESS);
+static_assert(statusName(TradeStatus::TRADE_FINISHED) == AlipayPayment::TRADE_STATUS_TRADE_FINISHED);
+static_assert(statusName(TradeStatus::TRADE_CLOSED) == AlipayPayment::TRADE_STATUS_TRADE_CLOSED);
+
+} // namespace
+
 AlipayPayment::AlipayPayment() : conn(nullptr) {}
 
 AlipayPayment::~AlipayPayment() {
-    if (conn) {
-        mysql_close(conn);
-    }
+    // lease_ 析构时归还连接池或关闭独占连接
 }
 
 bool AlipayPayment::connectDB(const char* host, const char* user, 
                             const char* password, const char* db) {
-    conn = mysql_init(nullptr);
+    lease_ = PooledConnection::open(host, user, password, db);
+    conn = lease_.get();
     if (!conn) return false;
     
-    if (!mysql_real_connect(conn, host, user, password, db, 0, nullptr, 0)) {
-        return false;
-    }
-    
-    mysql_set_character_set(conn, "utf8mb4");
-    
-    // 创建支付表
-    if (!createPaymentTable()) {
-        return false;
-    }
+    // 表结构由 schema 管理器在进程内初始化一次
+    return AlipaySchemaManager::getInstance().ensureSchema(conn);
+}
+
+bool AlipayPayment::connectDB(AlipayConnectionPool& pool) {
+    lease_ = pool.acquire();
+    conn = lease_.get();
+    if (!conn) return false;
     
-    return true;
+    // 表结构由 schema 管理器在进程内初始化一次
+    return AlipaySchemaManager::getInstance().ensureSchema(conn);
 }
 
 bool AlipayPayment::createPayment(const std::string& outTradeNo, 
@@ -40,12 +65,8 @@ bool AlipayPayment::createPayment(const std::string& outTradeNo,
             "out_trade_no, trade_status, update_time"
             ") VALUES (?, ?, ?)";
             
-        MYSQL_STMT* stmt = mysql_stmt_init(conn);
-        if (!stmt) throw std::runtime_error("mysql_stmt_init failed");
-        
-        if (mysql_stmt_prepare(stmt, query.c_str(), query.length())) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
-        }
+        CachedStatement stmt(lease_, query);
+        if (!stmt) throw std::runtime_error(stmt.error());
         
         // 设置当前时间戳
         update_time_ = std::chrono::system_clock::to_time_t(
@@ -56,29 +77,27 @@ bool AlipayPayment::createPayment(const std::string& outTradeNo,
         
         // 绑定参数
         out_trade_no_ = outTradeNo;
-        std::string initial_status = TRADE_STATUS_WAIT_BUYER_PAY;
+        uint8_t initial_status = statusCode(TradeStatus::WAIT_BUYER_PAY);
         
         bind[0].buffer_type = MYSQL_TYPE_STRING;
         bind[0].buffer = (void*)out_trade_no_.c_str();
         bind[0].buffer_length = out_trade_no_.length();
         
-        bind[1].buffer_type = MYSQL_TYPE_STRING;
-        bind[1].buffer = (void*)initial_status.c_str();
-        bind[1].buffer_length = initial_status.length();
+        bind[1].buffer_type = MYSQL_TYPE_TINY;
+        bind[1].buffer = &initial_status;
+        bind[1].is_unsigned = true;
         
         bind[2].buffer_type = MYSQL_TYPE_LONGLONG;
         bind[2].buffer = &update_time_;
         bind[2].is_unsigned = true;
         
-        if (mysql_stmt_bind_param(stmt, bind)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_bind_param(stmt.get(), bind)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
-        if (mysql_stmt_execute(stmt)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_execute(stmt.get())) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
-        
-        mysql_stmt_close(stmt);
         return true;
     }
     catch (const std::exception& e) {
@@ -90,14 +109,12 @@ bool AlipayPayment::queryPayment(const std::string& outTradeNo) {
     if (!conn) return false;
     
     try {
-        std::string query = "SELECT * FROM alipay_payments WHERE out_trade_no = ?";
-            
-        MYSQL_STMT* stmt = mysql_stmt_init(conn);
-        if (!stmt) throw std::runtime_error("mysql_stmt_init failed");
+        // 列出全部列而不用 SELECT *：迁移替换过的 trade_status 已移到表的最后一列
+        std::string query = "SELECT out_trade_no, trade_no, trade_status, pay_time, update_time "
+            "FROM alipay_payments WHERE out_trade_no = ?";
         
-        if (mysql_stmt_prepare(stmt, query.c_str(), query.length())) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
-        }
+        CachedStatement stmt(lease_, query);
+        if (!stmt) throw std::runtime_error(stmt.error());
         
         MYSQL_BIND bind[1];
         memset(bind, 0, sizeof(bind));
@@ -106,12 +123,12 @@ bool AlipayPayment::queryPayment(const std::string& outTradeNo) {
         bind[0].buffer = (void*)outTradeNo.c_str();
         bind[0].buffer_length = outTradeNo.length();
         
-        if (mysql_stmt_bind_param(stmt, bind)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_bind_param(stmt.get(), bind)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
-        if (mysql_stmt_execute(stmt)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_execute(stmt.get())) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
         // 绑定结果集
@@ -121,7 +138,7 @@ bool AlipayPayment::queryPayment(const std::string& outTradeNo) {
         // 准备结果缓冲区
         char out_trade_no_buf[65];
         char trade_no_buf[65];
-        char trade_status_buf[33];
+        uint8_t trade_status_val;
         my_bool is_null[5];
         unsigned long length[5];
         
@@ -138,11 +155,10 @@ bool AlipayPayment::queryPayment(const std::string& outTradeNo) {
         result[1].is_null = &is_null[1];
         result[1].length = &length[1];
         
-        result[2].buffer_type = MYSQL_TYPE_STRING;
-        result[2].buffer = trade_status_buf;
-        result[2].buffer_length = sizeof(trade_status_buf);
+        result[2].buffer_type = MYSQL_TYPE_TINY;
+        result[2].buffer = &trade_status_val;
+        result[2].is_unsigned = true;
         result[2].is_null = &is_null[2];
-        result[2].length = &length[2];
         
         uint64_t pay_time_val;
         result[3].buffer_type = MYSQL_TYPE_LONGLONG;
@@ -155,30 +171,31 @@ bool AlipayPayment::queryPayment(const std::string& outTradeNo) {
         result[4].is_unsigned = true;
         result[4].is_null = &is_null[4];
         
-        if (mysql_stmt_bind_result(stmt, result)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_bind_result(stmt.get(), result)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
-        if (mysql_stmt_fetch(stmt)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_fetch(stmt.get())) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
         // 设置查询结果到对象属性
         out_trade_no_ = std::string(out_trade_no_buf, length[0]);
+        trade_no_.reset();
+        trade_status_.reset();
+        pay_time_.reset();
         
         if (!is_null[1]) {
             trade_no_ = std::string(trade_no_buf, length[1]);
         }
         
         if (!is_null[2]) {
-            trade_status_ = std::string(trade_status_buf, length[2]);
+            trade_status_ = statusFromCode<TradeStatus>(trade_status_val);
         }
         
         if (!is_null[3]) {
             pay_time_ = pay_time_val;
         }
-        
-        mysql_stmt_close(stmt);
         return true;
     }
     catch (const std::exception& e) {
@@ -186,27 +203,52 @@ bool AlipayPayment::queryPayment(const std::string& outTradeNo) {
     }
 }
 
+AlipayQueryCache<AlipayPaymentSnapshot>& AlipayPayment::cache() {
+    static AlipayQueryCache<AlipayPaymentSnapshot> instance;
+    return instance;
+}
+
+bool AlipayPayment::queryPaymentCached(const std::string& outTradeNo) {
+    // 同一订单号的并发未命中只由一个调用方查库
+    auto snapshot = cache().getOrLoad(outTradeNo,
+        [&]() -> std::optional<AlipayPaymentSnapshot> {
+            if (!queryPayment(outTradeNo)) return std::nullopt;
+            return AlipayPaymentSnapshot{out_trade_no_, trade_no_, trade_status_,
+                                         pay_time_, update_time_};
+        });
+    if (!snapshot) return false;
+    
+    out_trade_no_ = snapshot->out_trade_no;
+    trade_no_ = snapshot->trade_no;
+    trade_status_ = snapshot->trade_status;
+    pay_time_ = snapshot->pay_time;
+    update_time_ = snapshot->update_time;
+    return true;
+}
+
 bool AlipayPayment::updatePaymentStatus(const std::string& outTradeNo, 
                                       const std::string& tradeNo,
                                       const std::string& status) {
     if (!conn) return false;
     
     try {
+        std::optional<TradeStatus> parsed = statusFromName<TradeStatus>(status);
+        if (!parsed) throw std::runtime_error("未知交易状态: " + status);
+        TradeStatus tradeStatus = *parsed;
+        uint8_t code = statusCode(tradeStatus);
+        
         update_time_ = std::chrono::system_clock::to_time_t(
             std::chrono::system_clock::now());
             
+        static_assert(statusCode(TradeStatus::TRADE_SUCCESS) == 2, "pay_time 条件中的编码");
         std::string query = "UPDATE alipay_payments SET "
             "trade_no = ?, trade_status = ?, "
-            "pay_time = IF(? = 'TRADE_SUCCESS', ?, pay_time), "
+            "pay_time = IF(? = 2, ?, pay_time), "       // TradeStatus::TRADE_SUCCESS
             "update_time = ? "
             "WHERE out_trade_no = ?";
             
-        MYSQL_STMT* stmt = mysql_stmt_init(conn);
-        if (!stmt) throw std::runtime_error("mysql_stmt_init failed");
-        
-        if (mysql_stmt_prepare(stmt, query.c_str(), query.length())) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
-        }
+        CachedStatement stmt(lease_, query);
+        if (!stmt) throw std::runtime_error(stmt.error());
         
         MYSQL_BIND bind[6];
         memset(bind, 0, sizeof(bind));
@@ -215,13 +257,13 @@ bool AlipayPayment::updatePaymentStatus(const std::string& outTradeNo,
         bind[0].buffer = (void*)tradeNo.c_str();
         bind[0].buffer_length = tradeNo.length();
         
-        bind[1].buffer_type = MYSQL_TYPE_STRING;
-        bind[1].buffer = (void*)status.c_str();
-        bind[1].buffer_length = status.length();
+        bind[1].buffer_type = MYSQL_TYPE_TINY;
+        bind[1].buffer = &code;
+        bind[1].is_unsigned = true;
         
-        bind[2].buffer_type = MYSQL_TYPE_STRING;
-        bind[2].buffer = (void*)status.c_str();
-        bind[2].buffer_length = status.length();
+        bind[2].buffer_type = MYSQL_TYPE_TINY;
+        bind[2].buffer = &code;
+        bind[2].is_unsigned = true;
         
         bind[3].buffer_type = MYSQL_TYPE_LONGLONG;
         bind[3].buffer = &update_time_;
@@ -235,24 +277,17 @@ bool AlipayPayment::updatePaymentStatus(const std::string& outTradeNo,
         bind[5].buffer = (void*)outTradeNo.c_str();
         bind[5].buffer_length = outTradeNo.length();
         
-        if (mysql_stmt_bind_param(stmt, bind)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_bind_param(stmt.get(), bind)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
-        if (mysql_stmt_execute(stmt)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
-        }
-        
-        mysql_stmt_close(stmt);
-        
-        // 更新本地状态
-        out_trade_no_ = outTradeNo;
-        trade_no_ = tradeNo;
-        trade_status_ = status;
-        if (status == TRADE_STATUS_TRADE_SUCCESS) {
-            pay_time_ = update_time_;
+        bool executed = mysql_stmt_execute(stmt.get()) == 0;
+        finishStatusWrite(outTradeNo, tradeStatus, executed);
+        if (!executed) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
+        applyStatusLocally(outTradeNo, tradeNo, tradeStatus, update_time_);
         return true;
     }
     catch (const std::exception& e) {
@@ -260,48 +295,181 @@ bool AlipayPayment::updatePaymentStatus(const std::string& outTradeNo,
     }
 }
 
-bool AlipayPayment::createPaymentTable() {
-    if (!conn) return false;
+void AlipayPayment::finishStatusWrite(const std::string& outTradeNo, TradeStatus status,
+                                      bool written) {
+    // 写库之后再失效缓存；执行报错时结果未知，同样失效
+    cache().invalidate(outTradeNo);
     
-    const char* sql = R"SQL(
-        CREATE TABLE IF NOT EXISTS alipay_payments (
-            out_trade_no VARCHAR(64) PRIMARY KEY,    -- 商户订单号
-            trade_no VARCHAR(64),                    -- 支付宝交易号
-            trade_status VARCHAR(32) NOT NULL,       -- 交易状态
-            pay_time BIGINT UNSIGNED,                -- 支付时间戳
-            update_time BIGINT UNSIGNED NOT NULL,    -- 状态更新时间
-            FOREIGN KEY (out_trade_no) REFERENCES alipay_orders(out_trade_no),
-            INDEX idx_trade_no (trade_no),
-            INDEX idx_trade_status (trade_status),
-            INDEX idx_update_time (update_time)
-        ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
-    )SQL";
+    // 离开等待付款状态后不再需要超时关单
+    if (written && status != TradeStatus::WAIT_BUYER_PAY) {
+        AlipayOrderExpiryEngine::getInstance().cancel(outTradeNo);
+    }
+}
+
+void AlipayPayment::applyStatusLocally(const std::string& outTradeNo, const std::string& tradeNo,
+                                       TradeStatus status, uint64_t updateTime) {
+    out_trade_no_ = outTradeNo;
+    trade_no_ = tradeNo;
+    trade_status_ = status;
+    update_time_ = updateTime;
+    if (status == TradeStatus::TRADE_SUCCESS) {
+        pay_time_ = updateTime;
+    }
+}
+
+bool AlipayPayment::canTransition(TradeStatus from, TradeStatus to) {
+    for (const auto& transition : kPaymentTransitions) {
+        if (from == transition.from && to == transition.to) return true;
+    }
+    return false;
+}
+
+std::vector<TradeStatus> AlipayPayment::predecessorsOf(TradeStatus to) {
+    std::vector<TradeStatus> predecessors;
+    for (const auto& transition : kPaymentTransitions) {
+        if (to == transition.to) predecessors.push_back(transition.from);
+    }
+    return predecessors;
+}
+
+PaymentTransitionResult AlipayPayment::transitionPaymentStatus(const std::string& outTradeNo,
+                                                               const std::string& tradeNo,
+                                                               const std::string& status) {
+    std::optional<TradeStatus> parsed = statusFromName<TradeStatus>(status);
+    if (!parsed) return PaymentTransitionResult::ILLEGAL;
+    return transitionPaymentStatus(outTradeNo, tradeNo, *parsed);
+}
+
+PaymentTransitionResult AlipayPayment::transitionPaymentStatus(const std::string& outTradeNo,
+                                                               const std::string& tradeNo,
+                                                               TradeStatus status) {
+    if (!conn) return PaymentTransitionResult::FAILED;
+    
+    std::vector<TradeStatus> predecessors = predecessorsOf(status);
+    if (predecessors.empty()) return PaymentTransitionResult::ILLEGAL;
+    
+    uint64_t updateTime = std::chrono::system_clock::to_time_t(
+        std::chrono::system_clock::now());
+    
+    // 已处于目标状态的行也参与匹配，但各列保持原值：匹配而未变更即为重复通知。
+    // 赋值按从左到右执行，trade_status 须放在最后，前面的 IF 读到的才是原状态
+    std::string target = std::to_string(statusCode(status));
+    std::string query = "UPDATE alipay_payments SET trade_no = IF(trade_status = " + target +
+                        ", trade_no, ";
+    appendSqlString(conn, query, tradeNo);
+    query += ")";
+    // 进入已付款状态（含直接 TRADE_FINISHED）时记录首次付款时间
+    if (status == TradeStatus::TRADE_SUCCESS || status == TradeStatus::TRADE_FINISHED) {
+        query += ", pay_time = IF(trade_status = " + target + ", pay_time, IFNULL(pay_time, ";
+        appendSqlUInt(query, updateTime);
+        query += "))";
+    }
+    query += ", update_time = IF(trade_status = " + target + ", update_time, ";
+    appendSqlUInt(query, updateTime);
+    query += "), trade_status = " + target + " WHERE out_trade_no = ";
+    appendSqlString(conn, query, outTradeNo);
+    query += " AND trade_status IN (";
+    for (TradeStatus predecessor : predecessors) {
+        appendSqlUInt(query, statusCode(predecessor));
+        query += ", ";
+    }
+    query += target + ")";
     
-    return mysql_query(conn, sql) == 0;
+    PaymentTransitionResult result = PaymentTransitionResult::FAILED;
+    if (mysql_real_query(conn, query.data(), static_cast<unsigned long>(query.size())) == 0) {
+        // 受影响行数只计变更的行，匹配行数从 mysql_info 读取
+        unsigned long matched = 0;
+        unsigned long changed = 0;
+        const char* info = mysql_info(conn);
+        if (info && sscanf(info, "Rows matched: %lu Changed: %lu", &matched, &changed) == 2) {
+            result = matched == 0 ? PaymentTransitionResult::ILLEGAL
+                   : changed == 0 ? PaymentTransitionResult::ALREADY_APPLIED
+                   : PaymentTransitionResult::APPLIED;
+        }
+    }
+    
+    bool applied = result == PaymentTransitionResult::APPLIED;
+    finishStatusWrite(outTradeNo, status, applied);
+    if (applied) {
+        applyStatusLocally(outTradeNo, tradeNo, status, updateTime);
+    }
+    return result;
+}
+
+AsyncTask<bool> AlipayPayment::createPaymentAsync(AlipayAsyncTransaction& transaction,
+                                                  std::string outTradeNo) {
+    AlipayAsyncConnection& conn = transaction.connection();
+    
+    update_time_ = std::chrono::system_clock::to_time_t(
+        std::chrono::system_clock::now());
+    out_trade_no_ = outTradeNo;
+    
+    std::string query = "INSERT INTO alipay_payments ("
+        "out_trade_no, trade_status, update_time"
+        ") VALUES (";
+    SqlRow(conn.get(), query)
+        .str(out_trade_no_)
+        .u64(statusCode(TradeStatus::WAIT_BUYER_PAY))
+        .u64(update_time_);
+    query += ")";
+    
+    co_return co_await conn.execute(std::move(query));
+}
+
+AsyncTask<bool> AlipayPayment::updatePaymentStatusAsync(AlipayAsyncConnection& conn,
+                                                        std::string outTradeNo,
+                                                        std::string tradeNo,
+                                                        std::string status) {
+    std::optional<TradeStatus> parsed = statusFromName<TradeStatus>(status);
+    if (!parsed) co_return false;
+    TradeStatus tradeStatus = *parsed;
+    
+    uint64_t updateTime = std::chrono::system_clock::to_time_t(
+        std::chrono::system_clock::now());
+    
+    std::string query = "UPDATE alipay_payments SET trade_no = ";
+    appendSqlString(conn.get(), query, tradeNo);
+    query += ", trade_status = ";
+    appendSqlUInt(query, statusCode(tradeStatus));
+    if (tradeStatus == TradeStatus::TRADE_SUCCESS) {
+        query += ", pay_time = ";
+        appendSqlUInt(query, updateTime);
+    }
+    query += ", update_time = ";
+    appendSqlUInt(query, updateTime);
+    query += " WHERE out_trade_no = ";
+    appendSqlString(conn.get(), query, outTradeNo);
+    
+    bool executed = co_await conn.execute(std::move(query));
+    finishStatusWrite(outTradeNo, tradeStatus, executed);
+    if (!executed) co_return false;
+    
+    applyStatusLocally(outTradeNo, tradeNo, tradeStatus, updateTime);
+    co_return true;
 }
 
 // Getter 实现
 std::string AlipayPayment::getOutTradeNo() const { return out_trade_no_; }
 std::string AlipayPayment::getTradeNo() const { return trade_no_.value_or(""); }
-std::string AlipayPayment::getTradeStatus() const { return trade_status_.value_or(""); }
+std::string AlipayPayment::getTradeStatus() const {
+    return trade_status_ ? std::string(statusName(*trade_status_)) : std::string();
+}
+TradeStatus AlipayPayment::getTradeStatusCode() const {
+    return trade_status_.value_or(TradeStatus::UNKNOWN);
+}
 uint64_t AlipayPayment::getPayTime() const { return pay_time_.value_or(0); }
 uint64_t AlipayPayment::getUpdateTime() const { return update_time_; }
 
 // 时间工具方法实现
 std::string AlipayPayment::timestampToString(uint64_t timestamp) {
-    time_t time = static_cast<time_t>(timestamp);
-    struct tm* timeinfo = localtime(&time);
-    char buffer[80];
-    strftime(buffer, sizeof(buffer), "%Y-%m-%d %H:%M:%S", timeinfo);
-    return std::string(buffer);
+    char buffer[kTimestampBufferSize];
+    return std::string(buffer, formatTimestamp(buffer, sizeof(buffer), timestamp));
 }
 
 uint64_t AlipayPayment::stringToTimestamp(const std::string& timeStr) {
-    struct tm tm = {};
-    std::istringstream ss(timeStr);
-    ss >> std::get_time(&tm, "%Y-%m-%d %H:%M:%S");
-    if (ss.fail()) {
+    uint64_t timestamp = 0;
+    if (!parseTimestamp(timeStr, timestamp)) {
         throw std::invalid_argument("Invalid time format. Expected: YYYY-MM-DD HH:MM:SS");
     }
-    return static_cast<uint64_t>(mktime(&tm));
+    return timestamp;
 } 
\ No newline at end of file
@@ -0,0 +1,256 @@
+#include "alipay_payment_notify.h"
+#include "alipay_payment.h"
+#include "alipay_sql_builder.h"
+#include <unordered_map>
+#include <algorithm>
+
+namespace {
+
+// 允许变更到 status 的库中状态：转换表中的前驱加上目标状态本身（重复通知补齐交易号），形如 "(1, 2)"
+std::string allowedStatusList(TradeStatus status) {
+    std::string list = "(";
+    for (TradeStatus predecessor : AlipayPayment::predecessorsOf(status)) {
+        appendSqlUInt(list, statusCode(predecessor));
+        list += ", ";
+    }
+    appendSqlUInt(list, statusCode(status));
+    list += ")";
+    return list;
+}
+
+} // namespace
+
+AlipayPaymentNotifyPipeline& AlipayPaymentNotifyPipeline::getInstance() {
+    static AlipayPaymentNotifyPipeline instance;
+    return instance;
+}
+
+AlipayPaymentNotifyPipeline::~AlipayPaymentNotifyPipeline() {
+    stop();
+}
+
+int AlipayPaymentNotifyPipeline::statusRank(TradeStatus status) {
+    switch (status) {
+        case TradeStatus::TRADE_SUCCESS:  return 1;
+        case TradeStatus::TRADE_FINISHED:
+        case TradeStatus::TRADE_CLOSED:   return 2;
+        default:                          return 0;
+    }
+}
+
+bool AlipayPaymentNotifyPipeline::start(AlipayConnectionPool& pool,
+                                        const PaymentNotifyOptions& options) {
+    if (isRunning()) return true;
+
+    pool_ = &pool;
+    options_ = options;
+    if (options_.max_batch == 0) options_.max_batch = 1;
+    if (options_.queue_capacity < options_.max_batch) options_.queue_capacity = options_.max_batch;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = false;
+    }
+    running_.store(true, std::memory_order_release);
+    worker_ = std::thread(&AlipayPaymentNotifyPipeline::run, this);
+    return true;
+}
+
+void AlipayPaymentNotifyPipeline::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    not_empty_.notify_all();
+    not_full_.notify_all();
+    if (worker_.joinable()) {
+        worker_.join();
+    }
+    running_.store(false, std::memory_order_release);
+}
+
+std::future<bool> AlipayPaymentNotifyPipeline::submit(PaymentNotification notification) {
+    Pending pending{std::move(notification), {}};
+    std::future<bool> done = pending.ack.get_future();
+    if (!isRunning()) {
+        pending.ack.set_value(false);
+        return done;
+    }
+
+    {
+        std::unique_lock<std::mutex> lock(mutex_);
+        not_full_.wait(lock, [this] {
+            return stopping_ || queue_.size() < options_.queue_capacity;
+        });
+        if (stopping_) {
+            pending.ack.set_value(false);
+            return done;
+        }
+        queue_.push_back(std::move(pending));
+    }
+    received_.fetch_add(1, std::memory_order_relaxed);
+    not_empty_.notify_one();
+    return done;
+}
+
+PaymentNotifyStats AlipayPaymentNotifyPipeline::stats() const {
+    PaymentNotifyStats stats;
+    stats.received = received_.load(std::memory_order_relaxed);
+    stats.coalesced = coalesced_.load(std::memory_order_relaxed);
+    stats.rows = rows_.load(std::memory_order_relaxed);
+    stats.statements = statements_.load(std::memory_order_relaxed);
+    stats.failures = failures_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AlipayPaymentNotifyPipeline::run() {
+    std::vector<Pending> batch;
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        not_empty_.wait(lock, [this] { return stopping_ || !queue_.empty(); });
+        if (queue_.empty()) break; // 已停止且队列已写完
+
+        // 不足一批时稍等，让突发的通知攒到同一批
+        if (queue_.size() < options_.max_batch && !stopping_) {
+            not_empty_.wait_for(lock, options_.max_wait, [this] {
+                return stopping_ || queue_.size() >= options_.max_batch;
+            });
+        }
+
+        batch.clear();
+        batch.reserve(queue_.size());
+        for (auto& pending : queue_) {
+            batch.push_back(std::move(pending));
+        }
+        queue_.clear();
+        lock.unlock();
+        not_full_.notify_all();
+
+        flush(batch);
+        lock.lock();
+    }
+}
+
+void AlipayPaymentNotifyPipeline::flush(std::vector<Pending>& pending) {
+    // 同一订单合并为一条，保留最靠后的状态；同级状态保留先到的
+    std::vector<Merged> merged;
+    merged.reserve(pending.size());
+    std::unordered_map<std::string, size_t> index;
+    for (auto& item : pending) {
+        std::optional<TradeStatus> status =
+            statusFromName<TradeStatus>(item.notification.trade_status);
+        if (!status) {
+            item.ack.set_value(false); // 未知状态
+            continue;
+        }
+        int rank = statusRank(*status);
+
+        auto [it, inserted] = index.emplace(item.notification.out_trade_no, merged.size());
+        if (inserted) {
+            merged.push_back(Merged{std::move(item.notification), *status, false, false, {}});
+        } else {
+            coalesced_.fetch_add(1, std::memory_order_relaxed);
+            if (rank > statusRank(merged[it->second].status)) {
+                merged[it->second].notification = std::move(item.notification);
+                merged[it->second].status = *status;
+            }
+        }
+        Merged& target = merged[it->second];
+        target.paid = target.paid || *status == TradeStatus::TRADE_SUCCESS ||
+                      *status == TradeStatus::TRADE_FINISHED;
+        target.acks.push_back(std::move(item.ack));
+    }
+    if (merged.empty()) return;
+
+    uint64_t now = std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+    auto lease = pool_->acquire();
+
+    std::vector<Merged*> chunk;
+    chunk.reserve(options_.max_batch);
+    for (size_t start = 0; start < merged.size(); start += options_.max_batch) {
+        chunk.clear();
+        size_t end = std::min(merged.size(), start + options_.max_batch);
+        for (size_t i = start; i < end; ++i) chunk.push_back(&merged[i]);
+
+        bool ok = lease && writeChunk(lease.get(), chunk, now);
+        if (ok) {
+            statements_.fetch_add(1, std::memory_order_relaxed);
+            rows_.fetch_add(chunk.size(), std::memory_order_relaxed);
+        } else {
+            failures_.fetch_add(1, std::memory_order_relaxed);
+        }
+
+        for (Merged* item : chunk) {
+            // 转换被拒绝（非法转换或订单不存在）时订单仍可能待付款，不能取消超时关单
+            AlipayPayment::finishStatusWrite(item->notification.out_trade_no, item->status,
+                                             ok && item->applied);
+            for (auto& ack : item->acks) ack.set_value(ok);
+        }
+    }
+}
+
+bool AlipayPaymentNotifyPipeline::writeChunk(MYSQL* conn, const std::vector<Merged*>& chunk,
+                                             uint64_t now) {
+    // 每列一个 CASE out_trade_no 表达式，一条语句更新整批订单
+    std::string tradeNo = "CASE out_trade_no";
+    std::string status = "CASE out_trade_no";
+    std::string allowed = "CASE out_trade_no";
+    std::string payTime = "CASE out_trade_no";
+    std::string keys;
+    bool anyPaid = false;
+    for (const Merged* item : chunk) {
+        const auto& notification = item->notification;
+        std::string key;
+        appendSqlString(conn, key, notification.out_trade_no);
+
+        tradeNo += " WHEN " + key + " THEN ";
+        appendSqlString(conn, tradeNo, notification.trade_no);
+        status += " WHEN " + key + " THEN ";
+        appendSqlUInt(status, statusCode(item->status));
+        allowed += " WHEN " + key + " THEN trade_status IN " + allowedStatusList(item->status);
+        if (item->paid) {
+            payTime += " WHEN " + key + " THEN IFNULL(pay_time, ";
+            appendSqlUInt(payTime, now);
+            payTime += ")";
+            anyPaid = true;
+        }
+
+        if (!keys.empty()) keys += ",";
+        keys += key;
+    }
+    tradeNo += " END";
+    status += " END";
+    allowed += " END";
+    payTime += " ELSE pay_time END";
+
+    // 只按状态转换表推进（与 transitionPaymentStatus 同一张表）；同一状态重复写入（补齐交易号）不算倒退
+    std::string query = "UPDATE alipay_payments SET trade_no = " + tradeNo +
+                        ", trade_status = " + status;
+    if (anyPaid) query += ", pay_time = " + payTime;
+    query += ", update_time = ";
+    appendSqlUInt(query, now);
+    query += " WHERE out_trade_no IN (" + keys + ") AND " + allowed;
+
+    if (mysql_real_query(conn, query.data(), static_cast<unsigned long>(query.size())) != 0) {
+        return false;
+    }
+
+    // 受影响行数是整批合计，回查哪些订单已处于目标状态；回查失败时只是不取消超时关单，
+    // 关单本身按状态转换表执行，不会关闭已付款的订单
+    std::string check = "SELECT out_trade_no FROM alipay_payments WHERE out_trade_no IN (" +
+                        keys + ") AND trade_status = " + status;
+    if (mysql_real_query(conn, check.data(), static_cast<unsigned long>(check.size())) != 0) {
+        return true;
+    }
+    MYSQL_RES* result = mysql_store_result(conn);
+    if (!result) return true;
+
+    std::unordered_map<std::string_view, Merged*> byKey;
+    for (Merged* item : chunk) byKey.emplace(item->notification.out_trade_no, item);
+    while (MYSQL_ROW row = mysql_fetch_row(result)) {
+        unsigned long* lengths = mysql_fetch_lengths(result);
+        auto it = byKey.find(std::string_view(row[0], lengths[0]));
+        if (it != byKey.end()) it->second->applied = true;
+    }
+    mysql_free_result(result);
+    return true;
+}
@@ -0,0 +1,495 @@
+#include "alipay_reconciliation.h"
+#include "alipay_sql_builder.h"
+#include "alipay_work_stealing_pool.h"
+#include "alipay_codec.h"
+#include "alipay_status.h"
+#include <algorithm>
+#include <unordered_map>
+#include <queue>
+#include <chrono>
+#include <cstring>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+namespace {
+
+using StatementRecord = AlipayReconciliation::StatementRecord;
+
+// 按字节序排列，与 ORDER BY ... COLLATE utf8mb4_bin 一致
+const char* kPaymentsStreamQuery =
+    "SELECT p.out_trade_no, p.trade_no, p.trade_status, o.total_amount "
+    "FROM alipay_payments p FORCE INDEX (idx_pay_time) "
+    "JOIN alipay_orders o ON o.out_trade_no = p.out_trade_no "
+    "WHERE p.pay_time >= %llu AND p.pay_time < %llu "
+    "ORDER BY p.out_trade_no COLLATE utf8mb4_bin";
+
+const size_t kRunBufferSize = 256 << 10;   // 每个有序段文件的 stdio 缓冲
+
+// 库中存储编码，对账单和差异表使用状态名称
+std::string dbTradeStatus(const char* field) {
+    return std::string(statusName(statusFromField<TradeStatus>(field).value_or(TradeStatus::UNKNOWN)));
+}
+
+uint64_t nowSeconds() {
+    return std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+}
+
+std::string_view trim(std::string_view field) {
+    // 支付宝对账单的数值列常带制表符前缀，部分导出带引号
+    const char* blanks = " \t\r\"";
+    size_t first = field.find_first_not_of(blanks);
+    if (first == std::string_view::npos) return {};
+    size_t last = field.find_last_not_of(blanks);
+    return field.substr(first, last - first + 1);
+}
+
+template <size_t N>
+bool copyField(std::string_view value, char (&out)[N], uint8_t& length) {
+    if (value.size() > N) return false;
+    memcpy(out, value.data(), value.size());
+    length = static_cast<uint8_t>(value.size());
+    return true;
+}
+
+bool keyLess(const StatementRecord& a, const StatementRecord& b) {
+    return a.key() < b.key();
+}
+
+// 有序段的顺序读取器
+struct RunReader {
+    FILE* file = nullptr;
+    StatementRecord current;
+
+    bool next() { return fread(&current, sizeof(current), 1, file) == 1; }
+};
+
+} // namespace
+
+// 差异记录按批写入报告表
+class AlipayReconciliation::DiffWriter {
+public:
+    DiffWriter(MYSQL* conn, const std::string& batchKey, size_t batchSize)
+        : insert_(conn, "INSERT INTO alipay_reconciliation_diffs ("
+              "batch_key, out_trade_no, diff_type, trade_no, statement_amount, db_amount, "
+              "statement_status, db_status, create_time) VALUES ",
+              " ON DUPLICATE KEY UPDATE trade_no = VALUES(trade_no), "
+              "statement_amount = VALUES(statement_amount), db_amount = VALUES(db_amount), "
+              "statement_status = VALUES(statement_status), db_status = VALUES(db_status), "
+              "create_time = VALUES(create_time)"),
+          batch_key_(batchKey), batch_size_(batchSize > 0 ? batchSize : 1), now_(nowSeconds()) {}
+
+    bool add(std::string_view outTradeNo, const char* diffType, std::string_view tradeNo,
+             const std::optional<uint64_t>& statementAmount,
+             const std::optional<uint64_t>& dbAmount,
+             std::string_view statementStatus, std::string_view dbStatus) {
+        SqlRow row = insert_.addRow();
+        row.str(batch_key_).str(outTradeNo).str(diffType).str(tradeNo)
+           .optU64(statementAmount).optU64(dbAmount);
+        if (statementStatus.empty()) row.null(); else row.str(statementStatus);
+        if (dbStatus.empty()) row.null(); else row.str(dbStatus);
+        row.u64(now_);
+
+        if (insert_.pendingRows() >= batch_size_) return insert_.flush();
+        return !insert_.failed();
+    }
+
+    bool flush() { return insert_.flush(); }
+    const std::string& lastError() const { return insert_.lastError(); }
+
+private:
+    AlipayMultiRowInsert insert_;
+    std::string batch_key_;
+    size_t batch_size_;
+    uint64_t now_;
+};
+
+AlipayReconciliation::AlipayReconciliation(AlipayConnectionPool& pool,
+                                           const ReconciliationOptions& options)
+    : pool_(pool), options_(options) {}
+
+ReconciliationResult AlipayReconciliation::run(const std::string& statementPath,
+                                               const std::string& batchKey,
+                                               uint64_t windowStart, uint64_t windowEnd) {
+    auto started = std::chrono::steady_clock::now();
+    ReconciliationResult result;
+    result.batch_key = batchKey;
+
+    // 1. 对账单 -> 有序段
+    std::vector<FILE*> runs;
+    bool ok = buildRuns(statementPath, runs, result);
+
+    // 2. 有序段归并 + 数据库流式读取，两路归并连接
+    if (ok) {
+        PooledConnection streamLease = pool_.acquire();
+        PooledConnection writeLease = pool_.acquire();
+        if (!streamLease || !writeLease) {
+            result.error = "获取数据库连接失败";
+            ok = false;
+        } else {
+            ok = mergeJoin(runs, streamLease, writeLease, batchKey, windowStart, windowEnd,
+                           result);
+        }
+    }
+
+    for (FILE* run : runs) {
+        if (run) fclose(run);
+    }
+
+    result.elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    result.success = ok;
+    return result;
+}
+
+bool AlipayReconciliation::buildRuns(const std::string& path, std::vector<FILE*>& runs,
+                                     ReconciliationResult& result) {
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        result.error = "无法打开对账单: " + path;
+        return false;
+    }
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        result.error = "无法读取对账单: " + path;
+        return false;
+    }
+    size_t size = static_cast<size_t>(st.st_size);
+    if (size == 0) {
+        close(fd);
+        return true;
+    }
+
+    void* mapped = mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapped == MAP_FAILED) {
+        result.error = "映射对账单失败: " + path;
+        return false;
+    }
+    madvise(mapped, size, MADV_SEQUENTIAL);
+
+    // 按 chunk_bytes 切块，块边界顺延到下一个换行之后
+    const char* data = static_cast<const char*>(mapped);
+    const char* fileEnd = data + size;
+    size_t chunkBytes = options_.chunk_bytes > 0 ? options_.chunk_bytes : 1;
+    std::vector<std::pair<const char*, const char*>> chunks;
+    for (const char* begin = data; begin < fileEnd;) {
+        const char* end = begin + std::min(chunkBytes, static_cast<size_t>(fileEnd - begin));
+        if (end < fileEnd) {
+            const void* newline = memchr(end, '\n', fileEnd - end);
+            end = newline ? static_cast<const char*>(newline) + 1 : fileEnd;
+        }
+        chunks.emplace_back(begin, end);
+        begin = end;
+    }
+
+    runs.assign(chunks.size(), nullptr);
+    std::vector<uint64_t> lines(chunks.size(), 0);
+    std::vector<uint64_t> invalid(chunks.size(), 0);
+    std::vector<std::string> errors(chunks.size());
+    {
+        // 同时解析的块数不超过工作线程数，内存占用与文件大小无关
+        AlipayWorkStealingPool workers(options_.workers);
+        for (size_t i = 0; i < chunks.size(); ++i) {
+            workers.submit([&, i](size_t) {
+                parseChunk(chunks[i].first, chunks[i].second, i == 0 && options_.has_header,
+                           runs[i], lines[i], invalid[i], errors[i]);
+
+                // 已解析的页交还内核
+                long pageSize = sysconf(_SC_PAGESIZE);
+                uintptr_t first = (reinterpret_cast<uintptr_t>(chunks[i].first) + pageSize - 1)
+                                  & ~static_cast<uintptr_t>(pageSize - 1);
+                uintptr_t last = reinterpret_cast<uintptr_t>(chunks[i].second)
+                                 & ~static_cast<uintptr_t>(pageSize - 1);
+                if (last > first) {
+                    madvise(reinterpret_cast<void*>(first), last - first, MADV_DONTNEED);
+                }
+            });
+        }
+        workers.wait();
+    }
+    munmap(mapped, size);
+
+    for (size_t i = 0; i < chunks.size(); ++i) {
+        result.statement_lines += lines[i];
+        result.invalid_lines += invalid[i];
+        if (!errors[i].empty() && result.error.empty()) {
+            result.error = errors[i];
+        }
+    }
+    return result.error.empty();
+}
+
+bool AlipayReconciliation::parseChunk(const char* begin, const char* end, bool skipHeader,
+                                      FILE*& run, uint64_t& lines, uint64_t& invalid,
+                                      std::string& error) const {
+    std::vector<StatementRecord> records;
+    records.reserve((end - begin) / 128);
+
+    for (const char* cursor = begin; cursor < end;) {
+        const char* newline = static_cast<const char*>(memchr(cursor, '\n', end - cursor));
+        const char* lineEnd = newline ? newline : end;
+        std::string_view line(cursor, lineEnd - cursor);
+        cursor = newline ? newline + 1 : end;
+
+        if (!line.empty() && line.back() == '\r') line.remove_suffix(1);
+        if (trim(line).empty() || line.front() == '#') continue;
+        if (skipHeader) {
+            skipHeader = false;
+            continue;
+        }
+
+        ++lines;
+        StatementRecord record;
+        if (parseLine(line, record)) {
+            records.push_back(record);
+        } else {
+            ++invalid;
+        }
+    }
+
+    std::sort(records.begin(), records.end(), keyLess);
+
+    run = tmpfile();
+    if (!run) {
+        error = "创建临时文件失败";
+        return false;
+    }
+    setvbuf(run, nullptr, _IOFBF, kRunBufferSize);
+    if (!records.empty() &&
+        fwrite(records.data(), sizeof(StatementRecord), records.size(), run) != records.size()) {
+        error = "写入临时文件失败";
+        return false;
+    }
+    if (fflush(run) != 0) {
+        error = "写入临时文件失败";
+        return false;
+    }
+    rewind(run);
+    return true;
+}
+
+bool AlipayReconciliation::parseLine(std::string_view line, StatementRecord& record) const {
+    size_t maxColumn = std::max({options_.out_trade_no_column, options_.trade_no_column,
+                                 options_.trade_status_column, options_.amount_column,
+                                 options_.pay_time_column});
+    std::string_view fields[32];
+    if (maxColumn >= 32) return false;
+
+    size_t count = 0;
+    while (count <= maxColumn) {
+        size_t pos = line.find(options_.delimiter);
+        fields[count++] = trim(line.substr(0, pos));
+        if (pos == std::string_view::npos) break;
+        line.remove_prefix(pos + 1);
+    }
+    if (count <= maxColumn) return false;
+
+    memset(&record, 0, sizeof(record));
+    std::string_view key = fields[options_.out_trade_no_column];
+    if (key.empty()) return false;
+    if (!copyField(key, record.out_trade_no, record.out_trade_no_length)) return false;
+    if (!copyField(fields[options_.trade_no_column], record.trade_no, record.trade_no_length)) {
+        return false;
+    }
+    if (!copyField(fields[options_.trade_status_column], record.trade_status,
+                   record.trade_status_length)) {
+        return false;
+    }
+    if (!parseAmount(fields[options_.amount_column], record.amount)) return false;
+
+    std::string_view payTime = fields[options_.pay_time_column];
+    return payTime.empty() || parseTimestamp(payTime, record.pay_time);
+}
+
+bool AlipayReconciliation::mergeJoin(std::vector<FILE*>& runs, PooledConnection& streamLease,
+                                     PooledConnection& writeLease, const std::string& batchKey,
+                                     uint64_t windowStart, uint64_t windowEnd,
+                                     ReconciliationResult& result) {
+    MYSQL* writeConn = writeLease.get();
+    MYSQL* streamConn = streamLease.get();
+
+    // 重跑时清除该批次的旧差异
+    std::string cleanup = "DELETE FROM alipay_reconciliation_diffs WHERE batch_key = ";
+    appendSqlString(writeConn, cleanup, batchKey);
+    if (mysql_real_query(writeConn, cleanup.data(), static_cast<unsigned long>(cleanup.size()))) {
+        result.error = mysql_error(writeConn);
+        return false;
+    }
+
+    // 对账单侧：各有序段多路归并
+    std::vector<RunReader> readers;
+    for (FILE* run : runs) {
+        RunReader reader;
+        reader.file = run;
+        if (reader.next()) readers.push_back(reader);
+    }
+    auto greater = [&readers](size_t a, size_t b) {
+        return readers[b].current.key() < readers[a].current.key();
+    };
+    std::priority_queue<size_t, std::vector<size_t>, decltype(greater)> heap(greater);
+    for (size_t i = 0; i < readers.size(); ++i) heap.push(i);
+
+    auto nextStatement = [&](StatementRecord& record) {
+        if (heap.empty()) return false;
+        size_t index = heap.top();
+        heap.pop();
+        record = readers[index].current;
+        if (readers[index].next()) heap.push(index);
+        return true;
+    };
+
+    // 数据库侧：按相同顺序流式读取，不在客户端缓存结果集
+    char query[512];
+    snprintf(query, sizeof(query), kPaymentsStreamQuery,
+             static_cast<unsigned long long>(windowStart),
+             static_cast<unsigned long long>(windowEnd));
+    if (mysql_real_query(streamConn, query, static_cast<unsigned long>(strlen(query)))) {
+        result.error = mysql_error(streamConn);
+        return false;
+    }
+    MYSQL_RES* stream = mysql_use_result(streamConn);
+    if (!stream) {
+        result.error = mysql_error(streamConn);
+        return false;
+    }
+
+    DbRow row;
+    auto nextRow = [&]() {
+        MYSQL_ROW fields = mysql_fetch_row(stream);
+        if (!fields) return false;
+        unsigned long* lengths = mysql_fetch_lengths(stream);
+        row.out_trade_no.assign(fields[0], lengths[0]);
+        row.trade_no.assign(fields[1] ? fields[1] : "", fields[1] ? lengths[1] : 0);
+        row.trade_status = dbTradeStatus(fields[2]);
+        row.amount = std::strtoull(fields[3], nullptr, 10);
+        ++result.db_rows;
+        return true;
+    };
+
+    DiffWriter writer(writeConn, batchKey, options_.report_batch_size);
+    std::vector<StatementRecord> pending;
+    pending.reserve(options_.lookup_batch_size);
+
+    StatementRecord record;
+    bool hasRecord = nextStatement(record);
+    bool hasRow = nextRow();
+    bool rowMatched = false;   // 当前数据库行是否已与对账单记录比对过（对账单可能有重复行）
+    bool ok = true;
+
+    while (ok && (hasRecord || hasRow)) {
+        if (hasRow && (!hasRecord || std::string_view(row.out_trade_no) < record.key())) {
+            if (!rowMatched) {
+                ++result.missing_in_statement;
+                ok = writer.add(row.out_trade_no, DIFF_MISSING_IN_STATEMENT, row.trade_no,
+                                std::nullopt, row.amount, {}, row.trade_status);
+            }
+            hasRow = nextRow();
+            rowMatched = false;
+        } else if (hasRecord && (!hasRow || record.key() < std::string_view(row.out_trade_no))) {
+            pending.push_back(record);
+            if (pending.size() >= options_.lookup_batch_size) {
+                ok = resolveUnmatched(writeLease, pending, writer, result);
+            }
+            hasRecord = nextStatement(record);
+        } else {
+            ok = compare(record, row, writer, result);
+            rowMatched = true;
+            hasRecord = nextStatement(record);
+        }
+    }
+
+    // 提前退出时仍须读完结果集，连接才能继续使用
+    if (!ok) {
+        while (mysql_fetch_row(stream)) {}
+    } else if (mysql_errno(streamConn)) {
+        result.error = mysql_error(streamConn);
+        ok = false;
+    }
+    mysql_free_result(stream);
+
+    if (ok && !pending.empty()) {
+        ok = resolveUnmatched(writeLease, pending, writer, result);
+    }
+    if (ok && !writer.flush()) ok = false;
+    if (!ok && result.error.empty()) {
+        result.error = writer.lastError();
+    }
+    return ok;
+}
+
+bool AlipayReconciliation::resolveUnmatched(PooledConnection& lease,
+                                            std::vector<StatementRecord>& pending,
+                                            DiffWriter& writer, ReconciliationResult& result) {
+    MYSQL* conn = lease.get();
+
+    std::string query =
+        "SELECT p.out_trade_no, p.trade_no, p.trade_status, o.total_amount "
+        "FROM alipay_payments p JOIN alipay_orders o ON o.out_trade_no = p.out_trade_no "
+        "WHERE p.out_trade_no IN (";
+    for (size_t i = 0; i < pending.size(); ++i) {
+        if (i > 0) query += ", ";
+        appendSqlString(conn, query, pending[i].key());
+    }
+    query += ")";
+
+    if (mysql_real_query(conn, query.data(), static_cast<unsigned long>(query.size()))) {
+        result.error = mysql_error(conn);
+        return false;
+    }
+    MYSQL_RES* rows = mysql_store_result(conn);
+    if (!rows) {
+        result.error = mysql_error(conn);
+        return false;
+    }
+
+    std::unordered_map<std::string, DbRow> found;
+    while (MYSQL_ROW fields = mysql_fetch_row(rows)) {
+        unsigned long* lengths = mysql_fetch_lengths(rows);
+        DbRow& row = found[std::string(fields[0], lengths[0])];
+        row.out_trade_no.assign(fields[0], lengths[0]);
+        row.trade_no.assign(fields[1] ? fields[1] : "", fields[1] ? lengths[1] : 0);
+        row.trade_status = dbTradeStatus(fields[2]);
+        row.amount = std::strtoull(fields[3], nullptr, 10);
+    }
+    mysql_free_result(rows);
+
+    bool ok = true;
+    for (const auto& record : pending) {
+        auto it = found.find(std::string(record.key()));
+        if (it != found.end()) {
+            // 支付时间不在账期内（如跨日），仍按内容比对
+            ok = compare(record, it->second, writer, result) && ok;
+        } else {
+            ++result.missing_in_db;
+            ok = writer.add(record.key(), DIFF_MISSING_IN_DB, record.tradeNo(), record.amount,
+                            std::nullopt, record.status(), {}) && ok;
+        }
+    }
+    pending.clear();
+    if (!ok) result.error = writer.lastError();
+    return ok;
+}
+
+bool AlipayReconciliation::compare(const StatementRecord& record, const DbRow& row,
+                                   DiffWriter& writer, ReconciliationResult& result) {
+    bool same = true;
+    bool ok = true;
+    if (record.amount != row.amount) {
+        same = false;
+        ++result.amount_mismatches;
+        ok = writer.add(record.key(), DIFF_AMOUNT, record.tradeNo(), record.amount, row.amount,
+                        record.status(), row.trade_status);
+    }
+    if (record.status() != std::string_view(row.trade_status)) {
+        same = false;
+        ++result.status_mismatches;
+        ok = writer.add(record.key(), DIFF_STATUS, record.tradeNo(), record.amount, row.amount,
+                        record.status(), row.trade_status) && ok;
+    }
+    if (same) ++result.matched;
+    return ok;
+}
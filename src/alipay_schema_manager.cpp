@@ -0,0 +1,477 @@
+#include "alipay_schema_manager.h"
+#include "alipay_sql_builder.h"
+#include "alipay_status.h"
+#include "alipay_transaction_record.h"
+#include <mysql/mysqld_error.h>
+#include <chrono>
+#include <string>
+#include <cstdlib>
+#include <utility>
+
+namespace {
+
+// 跨进程迁移锁，避免多实例同时启动时重复执行 DDL
+const char* kMigrationLockName = "alipay_schema_migration";
+const int kMigrationLockTimeoutSeconds = 30;
+
+// 编码列回填时每条 UPDATE 处理的行数，控制单个事务的锁范围和 undo 量
+const int kRecodeChunkRows = 5000;
+
+// 按版本号升序排列，只允许追加，不允许修改已发布的迁移
+const std::vector<SchemaMigration>& migrations() {
+    static const std::vector<SchemaMigration> list = {
+        {1, "baseline tables", {
+            R"SQL(
+            CREATE TABLE IF NOT EXISTS alipay_merchants (
+                merchant_id VARCHAR(32) PRIMARY KEY,
+                merchant_name VARCHAR(128) NOT NULL,
+                merchant_type VARCHAR(32) NOT NULL,
+                status VARCHAR(16) NOT NULL,
+                create_time BIGINT UNSIGNED NOT NULL,
+                update_time BIGINT UNSIGNED NOT NULL,
+                contact_name VARCHAR(64) NOT NULL,
+                contact_phone VARCHAR(32) NOT NULL,
+                contact_email VARCHAR(128),
+                bank_account_name VARCHAR(128) NOT NULL,
+                bank_account_no VARCHAR(32) NOT NULL,
+                bank_name VARCHAR(128) NOT NULL,
+                bank_branch VARCHAR(256) NOT NULL,
+                settlement_type VARCHAR(32) NOT NULL,
+                settlement_cycle VARCHAR(32) NOT NULL,
+                fee_rate DECIMAL(5,4) NOT NULL,
+                INDEX idx_merchant_type (merchant_type),
+                INDEX idx_status (status),
+                INDEX idx_create_time (create_time)
+            ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+            )SQL",
+            R"SQL(
+            CREATE TABLE IF NOT EXISTS alipay_orders (
+                out_trade_no VARCHAR(64) PRIMARY KEY,    -- 商户订单号
+                total_amount BIGINT UNSIGNED NOT NULL,   -- 订单总金额(分)
+                subject VARCHAR(256) NOT NULL,           -- 订单标题
+                product_code VARCHAR(64) NOT NULL,       -- 产品码
+                body VARCHAR(128),                       -- 订单描述
+                time_expire BIGINT UNSIGNED,             -- 绝对超时时间戳
+                timeout_express BIGINT UNSIGNED,         -- 相对超时时间
+                store_id VARCHAR(32),                    -- 商户门店编号
+                merchant_order_no VARCHAR(32),           -- 商户原始订单号
+                create_time BIGINT UNSIGNED NOT NULL,    -- 订单创建时间
+                INDEX idx_create_time (create_time)
+            ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+            )SQL",
+            R"SQL(
+            CREATE TABLE IF NOT EXISTS alipay_goods_detail (
+                id BIGINT UNSIGNED AUTO_INCREMENT PRIMARY KEY,
+                out_trade_no VARCHAR(64) NOT NULL,       -- 商户订单号
+                goods_id VARCHAR(32) NOT NULL,           -- 商品编号
+                goods_name VARCHAR(256) NOT NULL,        -- 商品名称
+                quantity INT UNSIGNED NOT NULL,          -- 商品数量
+                price BIGINT UNSIGNED NOT NULL,          -- 商品单价(分)
+                alipay_goods_id VARCHAR(32),             -- 支付宝统一商品编号
+                show_url VARCHAR(400),                   -- 商品展示地址
+                goods_category VARCHAR(24),              -- 商品类目
+                categories_tree VARCHAR(128),            -- 商品类目树
+                body VARCHAR(1000),                      -- 商品描述
+                FOREIGN KEY (out_trade_no) REFERENCES alipay_orders(out_trade_no),
+                INDEX idx_out_trade_no (out_trade_no),
+                INDEX idx_goods_id (goods_id)
+            ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+            )SQL",
+            R"SQL(
+            CREATE TABLE IF NOT EXISTS alipay_extend_params (
+                out_trade_no VARCHAR(64) PRIMARY KEY,    -- 商户订单号
+                sys_service_provider_id VARCHAR(64),     -- 系统商编号
+                hb_fq_num VARCHAR(5),                    -- 花呗分期数
+                hb_fq_seller_percent VARCHAR(3),         -- 卖家承担收费比例
+                industry_reflux_info VARCHAR(2048),      -- 行业数据回流信息
+                card_type VARCHAR(32),                   -- 卡类型
+                FOREIGN KEY (out_trade_no) REFERENCES alipay_orders(out_trade_no)
+            ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+            )SQL",
+            R"SQL(
+            CREATE TABLE IF NOT EXISTS alipay_payments (
+                out_trade_no VARCHAR(64) PRIMARY KEY,    -- 商户订单号
+                trade_no VARCHAR(64),                    -- 支付宝交易号
+                trade_status VARCHAR(32) NOT NULL,       -- 交易状态
+                pay_time BIGINT UNSIGNED,                -- 支付时间戳
+                update_time BIGINT UNSIGNED NOT NULL,    -- 状态更新时间
+                FOREIGN KEY (out_trade_no) REFERENCES alipay_orders(out_trade_no),
+                INDEX idx_trade_no (trade_no),
+                INDEX idx_trade_status (trade_status),
+                INDEX idx_update_time (update_time)
+            ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+            )SQL",
+            R"SQL(
+            CREATE TABLE IF NOT EXISTS alipay_settlements (
+                settlement_id VARCHAR(64) PRIMARY KEY,
+                merchant_id VARCHAR(32) NOT NULL,
+                out_trade_no VARCHAR(64) NOT NULL,
+                settlement_amount BIGINT UNSIGNED NOT NULL,
+                fee_amount BIGINT UNSIGNED NOT NULL,
+                status VARCHAR(32) NOT NULL,
+                settle_time BIGINT UNSIGNED,
+                create_time BIGINT UNSIGNED NOT NULL,
+                update_time BIGINT UNSIGNED NOT NULL,
+                bank_account_no VARCHAR(32) NOT NULL,
+                bank_name VARCHAR(128) NOT NULL,
+                remark VARCHAR(256),
+                INDEX idx_merchant_id (merchant_id),
+                INDEX idx_out_trade_no (out_trade_no),
+                INDEX idx_create_time (create_time),
+                INDEX idx_status (status),
+                FOREIGN KEY (merchant_id) REFERENCES alipay_merchants(merchant_id),
+                FOREIGN KEY (out_trade_no) REFERENCES alipay_orders(out_trade_no)
+            ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+            )SQL",
+            R"SQL(
+            CREATE TABLE IF NOT EXISTS alipay_transactions (
+                xid VARCHAR(128) PRIMARY KEY,
+                status VARCHAR(32) NOT NULL,
+                create_time BIGINT UNSIGNED NOT NULL,
+                update_time BIGINT UNSIGNED NOT NULL,
+                order_no VARCHAR(64) NOT NULL,
+                participants TEXT,
+                INDEX idx_status (status),
+                INDEX idx_create_time (create_time),
+                INDEX idx_order_no (order_no)
+            ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+            )SQL",
+        }},
+        {2, "order merchant and batch settlement", {
+            "ALTER TABLE alipay_orders ADD COLUMN merchant_id VARCHAR(32) NULL",
+            "ALTER TABLE alipay_orders ADD INDEX idx_merchant_create_time (merchant_id, create_time)",
+            "ALTER TABLE alipay_merchants ADD INDEX idx_settlement_cycle (settlement_cycle, merchant_id)",
+            "ALTER TABLE alipay_settlements ADD UNIQUE INDEX uk_out_trade_no (out_trade_no)",
+            R"SQL(
+            CREATE TABLE IF NOT EXISTS alipay_settlement_checkpoints (
+                run_key VARCHAR(64) NOT NULL,            -- 结算批次，如 T+1:2024-03-20
+                merchant_id VARCHAR(32) NOT NULL,
+                status VARCHAR(16) NOT NULL,             -- RUNNING / DONE
+                last_create_time BIGINT UNSIGNED NOT NULL, -- 键集游标
+                last_out_trade_no VARCHAR(64) NOT NULL,
+                settled_count BIGINT UNSIGNED NOT NULL,
+                settlement_amount BIGINT UNSIGNED NOT NULL,
+                fee_amount BIGINT UNSIGNED NOT NULL,
+                update_time BIGINT UNSIGNED NOT NULL,
+                PRIMARY KEY (run_key, merchant_id)
+            ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+            )SQL",
+        }},
+        {3, "payment pay_time index and reconciliation diffs", {
+            "ALTER TABLE alipay_payments ADD INDEX idx_pay_time (pay_time)",
+            R"SQL(
+            CREATE TABLE IF NOT EXISTS alipay_reconciliation_diffs (
+                batch_key VARCHAR(64) NOT NULL,          -- 对账批次，如 2024-03-20
+                out_trade_no VARCHAR(64) NOT NULL,       -- 商户订单号
+                diff_type VARCHAR(32) NOT NULL,          -- 差异类型
+                trade_no VARCHAR(64),                    -- 支付宝交易号
+                statement_amount BIGINT UNSIGNED,        -- 对账单金额(分)
+                db_amount BIGINT UNSIGNED,               -- 订单金额(分)
+                statement_status VARCHAR(32),            -- 对账单交易状态
+                db_status VARCHAR(32),                   -- 支付表交易状态
+                create_time BIGINT UNSIGNED NOT NULL,
+                PRIMARY KEY (batch_key, out_trade_no, diff_type)
+            ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+            )SQL",
+        }},
+        {4, "transactional outbox", {
+            R"SQL(
+            CREATE TABLE IF NOT EXISTS alipay_outbox (
+                id BIGINT UNSIGNED AUTO_INCREMENT PRIMARY KEY, -- 事件 ID
+                aggregate_id VARCHAR(64) NOT NULL,       -- 业务主键，如商户订单号
+                event_type VARCHAR(32) NOT NULL,         -- 事件类型
+                payload TEXT NOT NULL,                   -- 事件内容（JSON）
+                create_time BIGINT UNSIGNED NOT NULL
+            ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+            )SQL",
+        }},
+        {5, "compact status columns", {}, {
+            {"alipay_payments", "out_trade_no", "trade_status", "idx_trade_status",
+             [](std::string_view column) { return statusCodeCaseSql<TradeStatus>(column); }},
+            {"alipay_settlements", "settlement_id", "status", "idx_status",
+             [](std::string_view column) { return statusCodeCaseSql<SettlementStatus>(column); }},
+            {"alipay_merchants", "merchant_id", "status", "idx_status",
+             [](std::string_view column) { return statusCodeCaseSql<MerchantStatus>(column); }},
+            // TransactionStatus 的 0 是 INIT，未知值用名称表之外的编码
+            {"alipay_transactions", "xid", "status", "idx_status",
+             [](std::string_view column) {
+                 return statusCodeCaseSql<TransactionStatus>(column, 255);
+             }},
+        }},
+    };
+    return list;
+}
+
+uint64_t nowSeconds() {
+    return std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+}
+
+// 执行只返回单个整数的查询，NULL 视为 0
+bool queryScalar(MYSQL* conn, const std::string& sql, long long& value) {
+    if (mysql_query(conn, sql.c_str()) != 0) return false;
+
+    MYSQL_RES* result = mysql_store_result(conn);
+    if (!result) return false;
+
+    MYSQL_ROW row = mysql_fetch_row(result);
+    value = (row && row[0]) ? std::strtoll(row[0], nullptr, 10) : 0;
+    mysql_free_result(result);
+    return true;
+}
+
+// 执行只返回单个字符串的查询，无结果行时 found 为 false
+bool queryString(MYSQL* conn, const std::string& sql, std::string& value, bool& found) {
+    if (mysql_query(conn, sql.c_str()) != 0) return false;
+
+    MYSQL_RES* result = mysql_store_result(conn);
+    if (!result) return false;
+
+    MYSQL_ROW row = mysql_fetch_row(result);
+    found = row && row[0];
+    if (found) {
+        unsigned long* lengths = mysql_fetch_lengths(result);
+        value.assign(row[0], lengths[0]);
+    }
+    mysql_free_result(result);
+    return true;
+}
+
+// 查询列的完整类型（如 varchar(32)），列不存在时 found 为 false
+bool queryColumnType(MYSQL* conn, const std::string& table, const std::string& column,
+                     std::string& type, bool& found) {
+    std::string sql = "SELECT COLUMN_TYPE FROM information_schema.COLUMNS "
+                      "WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = ";
+    appendSqlString(conn, sql, table);
+    sql += " AND COLUMN_NAME = ";
+    appendSqlString(conn, sql, column);
+    return queryString(conn, sql, type, found);
+}
+
+bool queryIndexExists(MYSQL* conn, const std::string& table, const std::string& index,
+                      bool& found) {
+    std::string sql = "SELECT INDEX_NAME FROM information_schema.STATISTICS "
+                      "WHERE TABLE_SCHEMA = DATABASE() AND TABLE_NAME = ";
+    appendSqlString(conn, sql, table);
+    sql += " AND INDEX_NAME = ";
+    appendSqlString(conn, sql, index);
+    sql += " LIMIT 1";
+    std::string name;
+    return queryString(conn, sql, name, found);
+}
+
+} // namespace
+
+AlipaySchemaManager& AlipaySchemaManager::getInstance() {
+    static AlipaySchemaManager instance;
+    return instance;
+}
+
+uint32_t AlipaySchemaManager::latestVersion() {
+    return migrations().empty() ? 0 : migrations().back().version;
+}
+
+bool AlipaySchemaManager::ensureSchema(MYSQL* conn) {
+    if (ready_.load(std::memory_order_acquire)) return true;
+    if (!conn) return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (ready_.load(std::memory_order_relaxed)) return true;
+
+    // 失败时不置位，下次连接时重试
+    if (!migrate(conn)) return false;
+
+    ready_.store(true, std::memory_order_release);
+    return true;
+}
+
+bool AlipaySchemaManager::migrate(MYSQL* conn) {
+    const char* version_table = R"SQL(
+        CREATE TABLE IF NOT EXISTS schema_version (
+            version INT UNSIGNED PRIMARY KEY,        -- schema 版本号
+            description VARCHAR(256) NOT NULL,       -- 变更说明
+            applied_time BIGINT UNSIGNED NOT NULL    -- 应用时间
+        ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
+    )SQL";
+
+    // 先读一次版本：已是最新时无需申请迁移锁
+    uint32_t version = 0;
+    if (mysql_query(conn, version_table) != 0 || !readVersion(conn, version)) {
+        return false;
+    }
+    if (version >= latestVersion()) {
+        current_version_ = version;
+        return true;
+    }
+
+    long long locked = 0;
+    std::string lock_sql = std::string("SELECT GET_LOCK('") + kMigrationLockName +
+                           "', " + std::to_string(kMigrationLockTimeoutSeconds) + ")";
+    if (!queryScalar(conn, lock_sql, locked) || locked != 1) {
+        return false;
+    }
+
+    // 持锁后重新读取版本，其他实例可能已完成迁移
+    bool ok = readVersion(conn, version);
+    for (const auto& migration : migrations()) {
+        if (!ok) break;
+        if (migration.version <= version) continue;
+        ok = applyMigration(conn, migration);
+        if (ok) version = migration.version;
+    }
+
+    long long released = 0;
+    queryScalar(conn, std::string("SELECT RELEASE_LOCK('") + kMigrationLockName + "')",
+                released);
+
+    current_version_ = version;
+    return ok;
+}
+
+bool AlipaySchemaManager::readVersion(MYSQL* conn, uint32_t& version) {
+    long long value = 0;
+    if (!queryScalar(conn, "SELECT MAX(version) FROM schema_version", value)) {
+        return false;
+    }
+    version = static_cast<uint32_t>(value);
+    return true;
+}
+
+bool AlipaySchemaManager::applyMigration(MYSQL* conn, const SchemaMigration& migration) {
+    // MySQL 的 DDL 会隐式提交，迁移中途失败后会整体重跑：
+    // 建表用 IF NOT EXISTS，ALTER 重跑时忽略列/索引已存在的错误
+    for (const char* sql : migration.statements) {
+        if (mysql_query(conn, sql) != 0) {
+            unsigned int error = mysql_errno(conn);
+            if (error != ER_DUP_FIELDNAME && error != ER_DUP_KEYNAME) {
+                return false;
+            }
+        }
+    }
+
+    for (const auto& recode : migration.recodes) {
+        if (!recodeColumn(conn, recode)) return false;
+    }
+
+    std::string record = "INSERT INTO schema_version (version, description, applied_time) "
+                         "VALUES (" + std::to_string(migration.version) + ", '" +
+                         migration.description + "', " + std::to_string(nowSeconds()) + ")";
+    return mysql_query(conn, record.c_str()) == 0;
+}
+
+bool AlipaySchemaManager::recodeColumn(MYSQL* conn, const SchemaColumnRecode& recode) {
+    std::string table = recode.table;
+    std::string key = recode.key;
+    std::string column = recode.column;
+    std::string code_column = column + "_code";
+    std::string old_column = column + "_old";
+    std::string code_index = std::string(recode.index) + "_code";
+    std::string insert_trigger = table + "_" + code_column + "_bi";
+    std::string update_trigger = table + "_" + code_column + "_bu";
+
+    // 每一步都可重跑：按列类型、旧列和临时索引是否存在判断中途失败时停在哪一步
+    std::string column_type;
+    bool found = false;
+    if (!queryColumnType(conn, table, column, column_type, found)) return false;
+    if (!found) return false;
+
+    if (column_type.rfind("tinyint", 0) != 0) {
+        // 旧列改为可空，替换后新版本写入时不再给它赋值
+        std::string add_sql = "ALTER TABLE " + table + " ADD COLUMN " + code_column +
+                              " TINYINT UNSIGNED NULL, ALGORITHM=INPLACE, LOCK=NONE";
+        if (mysql_query(conn, add_sql.c_str()) != 0 && mysql_errno(conn) != ER_DUP_FIELDNAME) {
+            return false;
+        }
+        std::string nullable_sql = "ALTER TABLE " + table + " MODIFY COLUMN " + column + " " +
+                                   column_type + " NULL, ALGORITHM=INPLACE, LOCK=NONE";
+        if (mysql_query(conn, nullable_sql.c_str()) != 0) return false;
+
+        // 触发器在回填开始前建好：旧版本进程的写入由触发器同步编码列，
+        // 回填只需处理建触发器之前已存在的行
+        std::string new_code_sql = recode.code_sql("NEW." + column);
+        const std::pair<const std::string*, const char*> triggers[] = {
+            {&insert_trigger, "INSERT"},
+            {&update_trigger, "UPDATE"},
+        };
+        for (const auto& [name, event] : triggers) {
+            std::string drop_sql = "DROP TRIGGER IF EXISTS " + *name;
+            std::string create_sql = "CREATE TRIGGER " + *name + " BEFORE " + event +
+                                     " ON " + table + " FOR EACH ROW SET NEW." +
+                                     code_column + " = " + new_code_sql;
+            if (mysql_query(conn, drop_sql.c_str()) != 0 ||
+                mysql_query(conn, create_sql.c_str()) != 0) {
+                return false;
+            }
+        }
+
+        // 按主键分块回填，每条 UPDATE 自动提交；已回填的行不再改写，重跑时只处理剩余部分
+        std::string code_sql = recode.code_sql(column);
+        std::string last;
+        while (true) {
+            std::string bound_sql = "SELECT " + key + " FROM " + table + " WHERE " + key + " > ";
+            appendSqlString(conn, bound_sql, last);
+            bound_sql += " ORDER BY " + key + " LIMIT 1 OFFSET " +
+                         std::to_string(kRecodeChunkRows - 1);
+            std::string upper;
+            bool has_upper = false;
+            if (!queryString(conn, bound_sql, upper, has_upper)) return false;
+
+            std::string update_sql = "UPDATE " + table + " SET " + code_column + " = " +
+                                     code_sql + " WHERE " + key + " > ";
+            appendSqlString(conn, update_sql, last);
+            if (has_upper) {
+                update_sql += " AND " + key + " <= ";
+                appendSqlString(conn, update_sql, upper);
+            }
+            update_sql += " AND NOT (" + code_column + " <=> " + code_sql + ")";
+            if (mysql_query(conn, update_sql.c_str()) != 0) return false;
+
+            if (!has_upper) break;
+            last = upper;
+        }
+
+        // 新列上的索引在替换前在线建好，替换时不再重建
+        std::string index_sql = "ALTER TABLE " + table + " ADD INDEX " + code_index +
+                                " (" + code_column + "), ALGORITHM=INPLACE, LOCK=NONE";
+        if (mysql_query(conn, index_sql.c_str()) != 0 && mysql_errno(conn) != ER_DUP_KEYNAME) {
+            return false;
+        }
+
+        // 删触发器和换列名在同一个表写锁内完成，中间没有不经触发器的写入；
+        // 两步都只改元数据，写锁只持有很短时间
+        std::string lock_sql = "LOCK TABLES " + table + " WRITE";
+        if (mysql_query(conn, lock_sql.c_str()) != 0) return false;
+        std::string drop_insert_sql = "DROP TRIGGER IF EXISTS " + insert_trigger;
+        std::string drop_update_sql = "DROP TRIGGER IF EXISTS " + update_trigger;
+        std::string swap_sql = "ALTER TABLE " + table +
+                               " RENAME COLUMN " + column + " TO " + old_column +
+                               ", RENAME COLUMN " + code_column + " TO " + column +
+                               ", ALGORITHM=INPLACE";
+        bool swapped = mysql_query(conn, drop_insert_sql.c_str()) == 0 &&
+                       mysql_query(conn, drop_update_sql.c_str()) == 0 &&
+                       mysql_query(conn, swap_sql.c_str()) == 0;
+        mysql_query(conn, "UNLOCK TABLES");
+        if (!swapped) return false;
+    }
+
+    // 替换后在线删除旧列和旧索引，新列改为 NOT NULL
+    bool has_old = false;
+    std::string old_type;
+    if (!queryColumnType(conn, table, old_column, old_type, has_old)) return false;
+    if (has_old) {
+        std::string drop_sql = "ALTER TABLE " + table +
+                               " DROP INDEX " + recode.index +
+                               ", DROP COLUMN " + old_column +
+                               ", MODIFY COLUMN " + column + " TINYINT UNSIGNED NOT NULL" +
+                               ", ALGORITHM=INPLACE, LOCK=NONE";
+        if (mysql_query(conn, drop_sql.c_str()) != 0) return false;
+    }
+
+    bool has_code_index = false;
+    if (!queryIndexExists(conn, table, code_index, has_code_index)) return false;
+    if (has_code_index) {
+        std::string rename_sql = "ALTER TABLE " + table + " RENAME INDEX " + code_index +
+                                 " TO " + recode.index + ", ALGORITHM=INPLACE, LOCK=NONE";
+        if (mysql_query(conn, rename_sql.c_str()) != 0) return false;
+    }
+    return true;
+}
@@ -1,4 +1,6 @@
 #include "alipay_settlement.h"
+#include "alipay_schema_manager.h"
+#include "alipay_id_generator.h"
 #include <sstream>
 #include <chrono>
 #include <stdexcept>
@@ -6,23 +8,29 @@
 AlipaySettlement::AlipaySettlement() : conn(nullptr), 
     settlement_amount_(0), fee_amount_(0) {}
 
+void AlipaySettlement::setFeeRounding(FeeRounding rounding) {
+    fee_engine_ = AlipayFeeEngine(rounding);
+}
+
 AlipaySettlement::~AlipaySettlement() {
-    if (conn) {
-        mysql_close(conn);
-    }
+    // lease_ 析构时归还连接池或关闭独占连接
 }
 
 bool AlipaySettlement::connectDB(const char* host, const char* user, 
                                 const char* password, const char* db) {
-    conn = mysql_init(nullptr);
+    lease_ = PooledConnection::open(host, user, password, db);
+    conn = lease_.get();
     if (!conn) return false;
     
-    if (!mysql_real_connect(conn, host, user, password, db, 0, nullptr, 0)) {
-        return false;
-    }
+    return AlipaySchemaManager::getInstance().ensureSchema(conn);
+}
+
+bool AlipaySettlement::connectDB(AlipayConnectionPool& pool) {
+    lease_ = pool.acquire();
+    conn = lease_.get();
+    if (!conn) return false;
     
-    mysql_set_character_set(conn, "utf8mb4");
-    return createSettlementTable();
+    return AlipaySchemaManager::getInstance().ensureSchema(conn);
 }
 
 bool AlipaySettlement::createSettlement(const std::string& outTradeNo,
@@ -31,18 +39,15 @@ bool AlipaySettlement::createSettlement(const std::string& outTradeNo,
     
     try {
         // 首先查询订单和商户信息
-        std::string query = "SELECT o.total_amount, m.fee_rate, "
+        // 费率按基点取出，避免 double 截断误差
+        std::string query = "SELECT o.total_amount, CAST(ROUND(m.fee_rate * 10000) AS UNSIGNED), "
             "m.bank_account_no, m.bank_name "
             "FROM alipay_orders o "
             "JOIN alipay_merchants m ON o.merchant_id = m.merchant_id "
             "WHERE o.out_trade_no = ? AND m.merchant_id = ?";
             
-        MYSQL_STMT* stmt = mysql_stmt_init(conn);
-        if (!stmt) throw std::runtime_error("mysql_stmt_init failed");
-        
-        if (mysql_stmt_prepare(stmt, query.c_str(), query.length())) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
-        }
+        CachedStatement stmt(lease_, query);
+        if (!stmt) throw std::runtime_error(stmt.error());
         
         MYSQL_BIND bind[2];
         memset(bind, 0, sizeof(bind));
@@ -55,12 +60,12 @@ bool AlipaySettlement::createSettlement(const std::string& outTradeNo,
         bind[1].buffer = (void*)merchantId.c_str();
         bind[1].buffer_length = merchantId.length();
         
-        if (mysql_stmt_bind_param(stmt, bind)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_bind_param(stmt.get(), bind)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
-        if (mysql_stmt_execute(stmt)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_execute(stmt.get())) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
         // 绑定结果
@@ -68,7 +73,7 @@ bool AlipaySettlement::createSettlement(const std::string& outTradeNo,
         memset(result, 0, sizeof(result));
         
         uint64_t total_amount;
-        double fee_rate;
+        uint64_t fee_rate_bps;
         char bank_account_no[33];
         char bank_name[129];
         unsigned long bank_account_no_length;
@@ -78,8 +83,9 @@ bool AlipaySettlement::createSettlement(const std::string& outTradeNo,
         result[0].buffer = &total_amount;
         result[0].is_unsigned = true;
         
-        result[1].buffer_type = MYSQL_TYPE_DOUBLE;
-        result[1].buffer = &fee_rate;
+        result[1].buffer_type = MYSQL_TYPE_LONGLONG;
+        result[1].buffer = &fee_rate_bps;
+        result[1].is_unsigned = true;
         
         result[2].buffer_type = MYSQL_TYPE_STRING;
         result[2].buffer = bank_account_no;
@@ -91,27 +97,27 @@ bool AlipaySettlement::createSettlement(const std::string& outTradeNo,
         result[3].buffer_length = sizeof(bank_name);
         result[3].length = &bank_name_length;
         
-        if (mysql_stmt_bind_result(stmt, result)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_bind_result(stmt.get(), result)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
-        if (mysql_stmt_fetch(stmt)) {
+        if (mysql_stmt_fetch(stmt.get())) {
             throw std::runtime_error("Order or merchant not found");
         }
         
-        mysql_stmt_close(stmt);
+        mysql_stmt_free_result(stmt.get());
         
         // 计算手续费和结算金额
-        fee_amount_ = static_cast<uint64_t>(total_amount * fee_rate);
+        fee_amount_ = fee_engine_.fee(total_amount, static_cast<uint32_t>(fee_rate_bps));
         settlement_amount_ = total_amount - fee_amount_;
         
         // 生成结算单号
-        settlement_id_ = "SETTLE_" + outTradeNo;
+        settlement_id_ = AlipayIdGenerator::getInstance().nextString("SETTLE");
         merchant_id_ = merchantId;
         out_trade_no_ = outTradeNo;
         bank_account_no_ = std::string(bank_account_no, bank_account_no_length);
         bank_name_ = std::string(bank_name, bank_name_length);
-        status_ = STATUS_PENDING;
+        status_ = SettlementStatus::PENDING;
         
         // 获取当前时间
         create_time_ = update_time_ = std::chrono::system_clock::to_time_t(
@@ -124,12 +130,8 @@ bool AlipaySettlement::createSettlement(const std::string& outTradeNo,
             "bank_account_no, bank_name"
             ") VALUES (?, ?, ?, ?, ?, ?, ?, ?, ?, ?)";
             
-        stmt = mysql_stmt_init(conn);
-        if (!stmt) throw std::runtime_error("mysql_stmt_init failed");
-        
-        if (mysql_stmt_prepare(stmt, query.c_str(), query.length())) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
-        }
+        CachedStatement insert_stmt(lease_, query);
+        if (!insert_stmt) throw std::runtime_error(insert_stmt.error());
         
         MYSQL_BIND insert_bind[10];
         memset(insert_bind, 0, sizeof(insert_bind));
@@ -141,15 +143,14 @@ bool AlipaySettlement::createSettlement(const std::string& outTradeNo,
         
         // ... 绑定其他参数 ...
         
-        if (mysql_stmt_bind_param(stmt, insert_bind)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_bind_param(insert_stmt.get(), insert_bind)) {
+            throw std::runtime_error(mysql_stmt_error(insert_stmt.get()));
         }
         
-        if (mysql_stmt_execute(stmt)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_execute(stmt.get())) {
+            throw std::runtime_error(mysql_stmt_error(insert_stmt.get()));
         }
-        
-        mysql_stmt_close(stmt);
+
         return true;
     }
     catch (const std::exception& e) {
@@ -161,17 +162,18 @@ bool AlipaySettlement::updateSettlementStatus(const std::string& status) {
     if (!conn || settlement_id_.empty()) return false;
     
     try {
+        std::optional<SettlementStatus> parsed = statusFromName<SettlementStatus>(status);
+        if (!parsed) throw std::runtime_error("未知结算状态: " + status);
+        uint8_t code = statusCode(*parsed);
+        
+        static_assert(statusCode(SettlementStatus::SUCCESS) == 3, "settle_time 条件中的编码");
         std::string query = "UPDATE alipay_settlements SET "
             "status = ?, update_time = ?, "
-            "settle_time = IF(? = 'SUCCESS', ?, settle_time) "
+            "settle_time = IF(? = 3, ?, settle_time) "      // SettlementStatus::SUCCESS
             "WHERE settlement_id = ?";
             
-        MYSQL_STMT* stmt = mysql_stmt_init(conn);
-        if (!stmt) throw std::runtime_error("mysql_stmt_init failed");
-        
-        if (mysql_stmt_prepare(stmt, query.c_str(), query.length())) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
-        }
+        CachedStatement stmt(lease_, query);
+        if (!stmt) throw std::runtime_error(stmt.error());
         
         update_time_ = std::chrono::system_clock::to_time_t(
             std::chrono::system_clock::now());
@@ -179,17 +181,17 @@ bool AlipaySettlement::updateSettlementStatus(const std::string& status) {
         MYSQL_BIND bind[5];
         memset(bind, 0, sizeof(bind));
         
-        bind[0].buffer_type = MYSQL_TYPE_STRING;
-        bind[0].buffer = (void*)status.c_str();
-        bind[0].buffer_length = status.length();
+        bind[0].buffer_type = MYSQL_TYPE_TINY;
+        bind[0].buffer = &code;
+        bind[0].is_unsigned = true;
         
         bind[1].buffer_type = MYSQL_TYPE_LONGLONG;
         bind[1].buffer = &update_time_;
         bind[1].is_unsigned = true;
         
-        bind[2].buffer_type = MYSQL_TYPE_STRING;
-        bind[2].buffer = (void*)status.c_str();
-        bind[2].buffer_length = status.length();
+        bind[2].buffer_type = MYSQL_TYPE_TINY;
+        bind[2].buffer = &code;
+        bind[2].is_unsigned = true;
         
         bind[3].buffer_type = MYSQL_TYPE_LONGLONG;
         bind[3].buffer = &update_time_;
@@ -199,18 +201,16 @@ bool AlipaySettlement::updateSettlementStatus(const std::string& status) {
         bind[4].buffer = (void*)settlement_id_.c_str();
         bind[4].buffer_length = settlement_id_.length();
         
-        if (mysql_stmt_bind_param(stmt, bind)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_bind_param(stmt.get(), bind)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
-        if (mysql_stmt_execute(stmt)) {
-            throw std::runtime_error(mysql_stmt_error(stmt));
+        if (mysql_stmt_execute(stmt.get())) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
         }
         
-        mysql_stmt_close(stmt);
-        
-        status_ = status;
-        if (status == STATUS_SUCCESS) {
+        status_ = *parsed;
+        if (status_ == SettlementStatus::SUCCESS) {
             settle_time_ = update_time_;
         }
         
@@ -221,40 +221,12 @@ bool AlipaySettlement::updateSettlementStatus(const std::string& status) {
     }
 }
 
-bool AlipaySettlement::createSettlementTable() {
-    if (!conn) return false;
-    
-    const char* sql = R"SQL(
-        CREATE TABLE IF NOT EXISTS alipay_settlements (
-            settlement_id VARCHAR(64) PRIMARY KEY,
-            merchant_id VARCHAR(32) NOT NULL,
-            out_trade_no VARCHAR(64) NOT NULL,
-            settlement_amount BIGINT UNSIGNED NOT NULL,
-            fee_amount BIGINT UNSIGNED NOT NULL,
-            status VARCHAR(32) NOT NULL,
-            settle_time BIGINT UNSIGNED,
-            create_time BIGINT UNSIGNED NOT NULL,
-            update_time BIGINT UNSIGNED NOT NULL,
-            bank_account_no VARCHAR(32) NOT NULL,
-            bank_name VARCHAR(128) NOT NULL,
-            remark VARCHAR(256),
-            INDEX idx_merchant_id (merchant_id),
-            INDEX idx_out_trade_no (out_trade_no),
-            INDEX idx_create_time (create_time),
-            INDEX idx_status (status),
-            FOREIGN KEY (merchant_id) REFERENCES alipay_merchants(merchant_id),
-            FOREIGN KEY (out_trade_no) REFERENCES alipay_orders(out_trade_no)
-        ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
-    )SQL";
-    
-    return mysql_query(conn, sql) == 0;
-}
-
 // Getter 实现
 std::string AlipaySettlement::getSettlementId() const { return settlement_id_; }
 std::string AlipaySettlement::getMerchantId() const { return merchant_id_; }
 std::string AlipaySettlement::getOutTradeNo() const { return out_trade_no_; }
 uint64_t AlipaySettlement::getSettlementAmount() const { return settlement_amount_; }
 uint64_t AlipaySettlement::getFeeAmount() const { return fee_amount_; }
-std::string AlipaySettlement::getStatus() const { return status_; }
+std::string AlipaySettlement::getStatus() const { return std::string(statusName(status_)); }
+SettlementStatus AlipaySettlement::getStatusCode() const { return status_; }
 uint64_t AlipaySettlement::getSettleTime() const { return settle_time_.value_or(0); } 
\ No newline at end of file
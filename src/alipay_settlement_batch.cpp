@@ -0,0 +1,600 @@
+#include "alipay_settlement_batch.h"
+#include "alipay_settlement.h"
+#include "alipay_sql_builder.h"
+#include "alipay_id_generator.h"
+#include "alipay_codec.h"
+#include "alipay_status.h"
+#include <chrono>
+#include <algorithm>
+#include <unordered_map>
+#include <string_view>
+#include <cstring>
+#include <stdexcept>
+
+namespace {
+
+static_assert(statusCode(MerchantStatus::ACTIVE) == 1, "kMerchantsQuery 中的编码");
+static_assert(statusCode(TradeStatus::TRADE_SUCCESS) == 2 &&
+              statusCode(TradeStatus::TRADE_FINISHED) == 3, "kEligiblePaymentsQuery 中的编码");
+
+const char* kMerchantsQuery =
+    "SELECT merchant_id, CAST(ROUND(fee_rate * 10000) AS UNSIGNED), bank_account_no, bank_name "
+    "FROM alipay_merchants "
+    "WHERE settlement_cycle = ? AND status = 1 AND merchant_id > ? "    // MerchantStatus::ACTIVE
+    "ORDER BY merchant_id LIMIT ?";
+
+const char* kCheckpointsQuery =
+    "SELECT merchant_id, status, last_create_time, last_out_trade_no "
+    "FROM alipay_settlement_checkpoints WHERE run_key = ?";
+
+// 走 idx_merchant_create_time，按 (create_time, out_trade_no) 键集分页；
+// 已有结算单的订单（包括上次中断前已提交的页）被 LEFT JOIN 排除
+const char* kEligiblePaymentsQuery =
+    "SELECT o.out_trade_no, o.create_time, o.total_amount "
+    "FROM alipay_orders o FORCE INDEX (idx_merchant_create_time) "
+    "JOIN alipay_payments p ON p.out_trade_no = o.out_trade_no "
+    "LEFT JOIN alipay_settlements s ON s.out_trade_no = o.out_trade_no "
+    "WHERE o.merchant_id = ? AND o.create_time < ? "
+    "AND (o.create_time > ? OR (o.create_time = ? AND o.out_trade_no > ?)) "
+    "AND p.trade_status IN (2, 3) "    // TradeStatus::TRADE_SUCCESS, TRADE_FINISHED
+    "AND p.pay_time >= ? AND p.pay_time < ? "
+    "AND s.settlement_id IS NULL "
+    "ORDER BY o.create_time, o.out_trade_no LIMIT ?";
+
+const char* kStatusRunning = "RUNNING";
+const char* kStatusDone = "DONE";
+
+constexpr int64_t kSecondsPerDay = 86400;
+
+uint64_t nowSeconds() {
+    return std::chrono::system_clock::to_time_t(std::chrono::system_clock::now());
+}
+
+void bindString(MYSQL_BIND& bind, const std::string& value) {
+    bind.buffer_type = MYSQL_TYPE_STRING;
+    bind.buffer = (void*)value.c_str();
+    bind.buffer_length = value.length();
+}
+
+void bindUInt64(MYSQL_BIND& bind, const uint64_t& value) {
+    bind.buffer_type = MYSQL_TYPE_LONGLONG;
+    bind.buffer = (void*)&value;
+    bind.is_unsigned = true;
+}
+
+// 本页实际写入的结算单：唯一键冲突的行保留原有结算单号，按本页生成的单号回查即可区分；
+// 须在同一事务内、提交前调用
+bool selectInserted(MYSQL* conn, const std::vector<AlipayIdBuffer>& ids,
+                    std::vector<char>& inserted, std::string& error) {
+    inserted.assign(ids.size(), 0);
+    if (ids.empty()) return true;
+
+    std::unordered_map<std::string_view, size_t> index;
+    index.reserve(ids.size());
+    std::string query = "SELECT settlement_id FROM alipay_settlements WHERE settlement_id IN (";
+    for (size_t i = 0; i < ids.size(); ++i) {
+        if (i > 0) query += ',';
+        appendSqlString(conn, query, ids[i].view());
+        index.emplace(ids[i].view(), i);
+    }
+    query += ')';
+
+    if (mysql_real_query(conn, query.data(), static_cast<unsigned long>(query.size())) != 0) {
+        error = mysql_error(conn);
+        return false;
+    }
+    MYSQL_RES* result = mysql_use_result(conn);
+    if (!result) {
+        error = mysql_error(conn);
+        return false;
+    }
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result))) {
+        unsigned long* lengths = mysql_fetch_lengths(result);
+        auto it = index.find(std::string_view(row[0], lengths[0]));
+        if (it != index.end()) inserted[it->second] = 1;
+    }
+    bool ok = mysql_errno(conn) == 0;
+    if (!ok) error = mysql_error(conn);
+    mysql_free_result(result);
+    return ok;
+}
+
+} // namespace
+
+AlipaySettlementBatch::AlipaySettlementBatch(AlipayConnectionPool& pool,
+                                             const SettlementBatchOptions& options)
+    : pool_(pool), options_(options) {}
+
+bool AlipaySettlementBatch::settlementWindow(const std::string& cycle, uint64_t businessDate,
+                                             uint64_t& start, uint64_t& end) {
+    const AlipayTimeZone& zone = AlipayTimeZone::local();
+    int64_t utc = static_cast<int64_t>(businessDate);
+    int64_t local = utc + zone.offsetAt(utc);
+    int64_t today = local / kSecondsPerDay - (local % kSecondsPerDay < 0 ? 1 : 0);
+
+    int64_t first, last; // 账期的起止日（不含 last）
+    if (cycle == "T+1") {
+        first = today - 1;
+        last = today;
+    } else if (cycle == "T+2") {
+        first = today - 2;
+        last = today - 1;
+    } else if (cycle == "WEEKLY") {
+        int64_t weekday = ((today + 3) % 7 + 7) % 7; // 1970-01-01 为周四，周一为 0
+        last = today - weekday;
+        first = last - 7;
+    } else if (cycle == "MONTHLY") {
+        int64_t year;
+        unsigned month, day;
+        civilFromDays(today, year, month, day);
+        last = daysFromCivil(year, month, 1);
+        first = month == 1 ? daysFromCivil(year - 1, 12, 1) : daysFromCivil(year, month - 1, 1);
+    } else {
+        return false;
+    }
+
+    start = static_cast<uint64_t>(zone.toUtc(first * kSecondsPerDay));
+    end = static_cast<uint64_t>(zone.toUtc(last * kSecondsPerDay));
+    return true;
+}
+
+std::string AlipaySettlementBatch::runKey(const std::string& cycle, uint64_t windowStart) {
+    char date[kTimestampBufferSize];
+    size_t length = formatTimestamp(date, sizeof(date), windowStart);
+    return cycle + ":" + std::string(date, length < 10 ? length : 10);
+}
+
+SettlementBatchResult AlipaySettlementBatch::run(const std::string& cycle,
+                                                 uint64_t businessDate) {
+    auto started = std::chrono::steady_clock::now();
+    RunState state;
+    SettlementBatchResult& result = state.result;
+
+    if (!settlementWindow(cycle, businessDate, state.window_start, state.window_end)) {
+        result.error = "不支持的结算周期: " + cycle;
+        return result;
+    }
+    state.run_key = runKey(cycle, state.window_start);
+    result.run_key = state.run_key;
+
+    PooledConnection lease = pool_.acquire();
+    if (!lease) {
+        result.error = "获取数据库连接失败";
+        return result;
+    }
+
+    std::unordered_map<std::string, Checkpoint> checkpoints;
+    if (!loadCheckpoints(lease, state.run_key, checkpoints, result.error)) {
+        return result;
+    }
+
+    // 工作线程在首次执行任务时各自借一条连接
+    size_t workerCount = options_.workers > 0 ? options_.workers : 1;
+    state.leases.resize(workerCount);
+    state.workers = std::make_unique<AlipayWorkStealingPool>(workerCount);
+
+    // 按商户号键集分页，每个商户提交一个任务
+    std::string after;
+    std::vector<MerchantInfo> merchants;
+    std::string error;
+    while (!state.failed.load(std::memory_order_relaxed)) {
+        if (!loadMerchants(lease, cycle, after, merchants, error)) {
+            state.failed.store(true);
+            break;
+        }
+        if (merchants.empty()) break;
+
+        for (const auto& merchant : merchants) {
+            auto it = checkpoints.find(merchant.merchant_id);
+            Checkpoint checkpoint = it != checkpoints.end() ? it->second : Checkpoint();
+            {
+                std::lock_guard<std::mutex> lock(state.mutex);
+                if (checkpoint.done) {
+                    ++result.skipped_merchants;
+                    continue;
+                }
+                ++result.merchants;
+            }
+
+            // 没有检查点时从账期起点往前推一个订单最长存活期开始扫描
+            if (checkpoint.last_out_trade_no.empty() && checkpoint.last_create_time == 0) {
+                checkpoint.last_create_time =
+                    state.window_start > options_.max_order_lifetime_seconds
+                    ? state.window_start - options_.max_order_lifetime_seconds : 0;
+            }
+
+            auto progress = std::make_shared<MerchantProgress>();
+            progress->merchant = merchant;
+            progress->cursor = checkpoint;
+            state.workers->submit([this, &state, progress](size_t worker) {
+                runTask(state, progress, worker);
+            });
+        }
+
+        if (merchants.size() < options_.merchant_page_size) break;
+        after = merchants.back().merchant_id;
+    }
+    lease.release();
+
+    state.workers->wait();
+    WorkStealingStats poolStats = state.workers->stats();
+    state.workers.reset();
+    state.leases.clear();
+
+    result.elapsed_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    result.throughput = result.elapsed_ms > 0
+        ? result.settled_count * 1000.0 / result.elapsed_ms : 0;
+    result.tasks = poolStats.executed;
+    result.stolen_tasks = poolStats.stolen;
+
+    // 按耗时降序取前 straggler_count 个商户，并给出中位数作对照
+    auto slower = [](const SettlementStraggler& a, const SettlementStraggler& b) {
+        return a.elapsed_ms > b.elapsed_ms;
+    };
+    std::vector<SettlementStraggler>& timings = state.timings;
+    if (!timings.empty()) {
+        std::nth_element(timings.begin(), timings.begin() + timings.size() / 2,
+                         timings.end(), slower);
+        result.median_merchant_ms = timings[timings.size() / 2].elapsed_ms;
+
+        size_t count = std::min(options_.straggler_count, timings.size());
+        std::partial_sort(timings.begin(), timings.begin() + count, timings.end(), slower);
+        result.stragglers.assign(timings.begin(), timings.begin() + count);
+    }
+
+    if (result.error.empty() && !error.empty()) {
+        result.error = error;
+    }
+    result.success = !state.failed.load();
+    return result;
+}
+
+void AlipaySettlementBatch::runTask(RunState& state, std::shared_ptr<MerchantProgress> progress,
+                                    size_t worker) {
+    // 其他商户失败后不再开始新的任务，已提交的检查点供重跑继续
+    if (state.failed.load(std::memory_order_relaxed)) return;
+
+    std::string error;
+    PooledConnection& lease = state.leases[worker];
+    if (!lease) {
+        lease = pool_.acquire();
+    }
+
+    SettlementBatchResult totals;
+    bool done = false;
+    bool ok = false;
+    auto started = std::chrono::steady_clock::now();
+    if (!lease) {
+        error = "获取数据库连接失败";
+    } else {
+        ok = settleRange(lease, *progress, state, totals, done, error);
+    }
+    progress->elapsed_us += std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::steady_clock::now() - started).count();
+    progress->settled_count += totals.settled_count;
+    ++progress->tasks;
+
+    {
+        std::lock_guard<std::mutex> lock(state.mutex);
+        state.result.settled_count += totals.settled_count;
+        state.result.settlement_amount += totals.settlement_amount;
+        state.result.fee_amount += totals.fee_amount;
+
+        if (!ok) {
+            if (state.result.error.empty()) {
+                state.result.error = progress->merchant.merchant_id + ": " + error;
+            }
+            state.failed.store(true);
+            return;
+        }
+        if (done) {
+            state.timings.push_back(SettlementStraggler{progress->merchant.merchant_id,
+                                                        progress->elapsed_us / 1000,
+                                                        progress->settled_count,
+                                                        progress->tasks});
+            return;
+        }
+    }
+
+    // 剩余区间作为续作重新入队：同一商户始终只有一个任务在执行，其间其他商户的任务得以穿插
+    state.workers->submit([this, &state, progress](size_t next) {
+        runTask(state, progress, next);
+    });
+}
+
+bool AlipaySettlementBatch::settleRange(PooledConnection& lease, MerchantProgress& progress,
+                                        const RunState& state, SettlementBatchResult& totals,
+                                        bool& done, std::string& error) {
+    Checkpoint& cursor = progress.cursor;
+    std::vector<PaymentRow> rows;
+    rows.reserve(options_.page_size);
+
+    size_t pages = options_.pages_per_task > 0 ? options_.pages_per_task : 1;
+    for (size_t page = 0; page < pages; ++page) {
+        if (!fetchPage(lease, progress.merchant.merchant_id, state.window_start,
+                       state.window_end, cursor, rows, error)) {
+            return false;
+        }
+
+        done = rows.size() < options_.page_size;
+        if (!rows.empty()) {
+            cursor.last_create_time = rows.back().create_time;
+            cursor.last_out_trade_no = rows.back().out_trade_no;
+        }
+        if (!commitPage(lease, progress.merchant, state.run_key, rows, cursor, done,
+                        totals, error)) {
+            return false;
+        }
+        if (done) return true;
+    }
+    return true;
+}
+
+bool AlipaySettlementBatch::loadCheckpoints(PooledConnection& lease, const std::string& runKey,
+                                            std::unordered_map<std::string, Checkpoint>& checkpoints,
+                                            std::string& error) {
+    MYSQL* conn = lease.get();
+    try {
+        std::string query = kCheckpointsQuery;
+        CachedStatement stmt(lease, query);
+        if (!stmt) throw std::runtime_error(stmt.error());
+
+        MYSQL_BIND bind[1];
+        memset(bind, 0, sizeof(bind));
+        bindString(bind[0], runKey);
+
+        if (mysql_stmt_bind_param(stmt.get(), bind)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
+        }
+        if (mysql_stmt_execute(stmt.get())) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
+        }
+
+        StringResult<32> merchant_id;
+        StringResult<16> status;
+        UInt64Result last_create_time;
+        StringResult<64> last_out_trade_no;
+
+        MYSQL_BIND result[4];
+        merchant_id.bind(result[0]);
+        status.bind(result[1]);
+        last_create_time.bind(result[2]);
+        last_out_trade_no.bind(result[3]);
+
+        if (mysql_stmt_bind_result(stmt.get(), result)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
+        }
+
+        int fetch;
+        while ((fetch = mysql_stmt_fetch(stmt.get())) == 0) {
+            Checkpoint& checkpoint = checkpoints[merchant_id.value()];
+            checkpoint.done = status.value() == kStatusDone;
+            checkpoint.last_create_time = last_create_time.value;
+            checkpoint.last_out_trade_no = last_out_trade_no.value();
+        }
+        if (fetch != MYSQL_NO_DATA) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+}
+
+bool AlipaySettlementBatch::loadMerchants(PooledConnection& lease, const std::string& cycle,
+                                          const std::string& afterMerchantId,
+                                          std::vector<MerchantInfo>& merchants,
+                                          std::string& error) {
+    MYSQL* conn = lease.get();
+    merchants.clear();
+    try {
+        std::string query = kMerchantsQuery;
+        CachedStatement stmt(lease, query);
+        if (!stmt) throw std::runtime_error(stmt.error());
+
+        uint64_t limit = options_.merchant_page_size;
+        MYSQL_BIND bind[3];
+        memset(bind, 0, sizeof(bind));
+        bindString(bind[0], cycle);
+        bindString(bind[1], afterMerchantId);
+        bindUInt64(bind[2], limit);
+
+        if (mysql_stmt_bind_param(stmt.get(), bind)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
+        }
+        if (mysql_stmt_execute(stmt.get())) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
+        }
+
+        StringResult<32> merchant_id;
+        UInt64Result fee_rate_bps;
+        StringResult<32> bank_account_no;
+        StringResult<128> bank_name;
+
+        MYSQL_BIND result[4];
+        merchant_id.bind(result[0]);
+        fee_rate_bps.bind(result[1]);
+        bank_account_no.bind(result[2]);
+        bank_name.bind(result[3]);
+
+        if (mysql_stmt_bind_result(stmt.get(), result)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
+        }
+
+        int fetch;
+        while ((fetch = mysql_stmt_fetch(stmt.get())) == 0) {
+            merchants.push_back(MerchantInfo{merchant_id.value(),
+                                             static_cast<uint32_t>(fee_rate_bps.value),
+                                             bank_account_no.value(), bank_name.value()});
+        }
+        if (fetch != MYSQL_NO_DATA) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+}
+
+bool AlipaySettlementBatch::fetchPage(PooledConnection& lease, const std::string& merchantId,
+                                      uint64_t windowStart, uint64_t windowEnd,
+                                      const Checkpoint& cursor, std::vector<PaymentRow>& rows,
+                                      std::string& error) {
+    MYSQL* conn = lease.get();
+    rows.clear();
+    try {
+        std::string query = kEligiblePaymentsQuery;
+        CachedStatement stmt(lease, query);
+        if (!stmt) throw std::runtime_error(stmt.error());
+
+        uint64_t limit = options_.page_size;
+        MYSQL_BIND bind[8];
+        memset(bind, 0, sizeof(bind));
+        bindString(bind[0], merchantId);
+        bindUInt64(bind[1], windowEnd);
+        bindUInt64(bind[2], cursor.last_create_time);
+        bindUInt64(bind[3], cursor.last_create_time);
+        bindString(bind[4], cursor.last_out_trade_no);
+        bindUInt64(bind[5], windowStart);
+        bindUInt64(bind[6], windowEnd);
+        bindUInt64(bind[7], limit);
+
+        if (mysql_stmt_bind_param(stmt.get(), bind)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
+        }
+        if (mysql_stmt_execute(stmt.get())) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
+        }
+
+        StringResult<64> out_trade_no;
+        UInt64Result create_time;
+        UInt64Result total_amount;
+
+        MYSQL_BIND result[3];
+        out_trade_no.bind(result[0]);
+        create_time.bind(result[1]);
+        total_amount.bind(result[2]);
+
+        if (mysql_stmt_bind_result(stmt.get(), result)) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
+        }
+
+        // 逐行读取，不在客户端缓存结果集
+        int fetch;
+        while ((fetch = mysql_stmt_fetch(stmt.get())) == 0) {
+            rows.push_back(PaymentRow{out_trade_no.value(), create_time.value,
+                                      total_amount.value});
+        }
+        if (fetch != MYSQL_NO_DATA) {
+            throw std::runtime_error(mysql_stmt_error(stmt.get()));
+        }
+        return true;
+    }
+    catch (const std::exception& e) {
+        error = e.what();
+        return false;
+    }
+}
+
+bool AlipaySettlementBatch::commitPage(PooledConnection& lease, const MerchantInfo& merchant,
+                                       const std::string& runKey,
+                                       const std::vector<PaymentRow>& rows,
+                                       const Checkpoint& cursor, bool done,
+                                       SettlementBatchResult& result, std::string& error) {
+    MYSQL* conn = lease.get();
+
+    // 整页金额一次交给手续费引擎计算（与单笔结算使用同一套定点规则）
+    std::vector<uint64_t> amounts(rows.size());
+    std::vector<uint64_t> fees(rows.size());
+    std::vector<uint64_t> settlements(rows.size());
+    for (size_t i = 0; i < rows.size(); ++i) {
+        amounts[i] = rows[i].total_amount;
+    }
+    AlipayFeeEngine(options_.fee_rounding).computeBatch(
+        amounts.data(), amounts.size(), merchant.fee_rate_bps, fees.data(), settlements.data());
+
+    // 结算单与检查点在同一个本地事务内提交；多行 INSERT 超长时会在 addRow 中提前执行，须先关闭自动提交
+    mysql_autocommit(conn, 0);
+
+    uint64_t now = nowSeconds();
+    std::vector<AlipayIdBuffer> settlementIds(rows.size());
+    AlipayMultiRowInsert settlementInsert(conn, "INSERT INTO alipay_settlements ("
+        "settlement_id, merchant_id, out_trade_no, settlement_amount, fee_amount, "
+        "status, create_time, update_time, bank_account_no, bank_name"
+        ") VALUES ",
+        // 唯一键兜底：并发的单笔结算已写入时不重复结算
+        " ON DUPLICATE KEY UPDATE settlement_id = settlement_id");
+    for (size_t i = 0; i < rows.size(); ++i) {
+        settlementIds[i] = AlipayIdGenerator::getInstance().nextId("SETTLE");
+        settlementInsert.addRow()
+            .str(settlementIds[i].view())
+            .str(merchant.merchant_id)
+            .str(rows[i].out_trade_no)
+            .u64(settlements[i])
+            .u64(fees[i])
+            .u64(statusCode(SettlementStatus::PENDING))
+            .u64(now)
+            .u64(now)
+            .str(merchant.bank_account_no)
+            .str(merchant.bank_name);
+    }
+
+    // 汇总只计入本页实际写入的行，已被单笔结算写入的行不重复计入
+    std::vector<char> inserted;
+    bool ok = settlementInsert.flush() && selectInserted(conn, settlementIds, inserted, error);
+    uint64_t pageCount = 0;
+    uint64_t pageAmount = 0;
+    uint64_t pageFee = 0;
+    for (size_t i = 0; ok && i < rows.size(); ++i) {
+        if (!inserted[i]) continue;
+        ++pageCount;
+        pageAmount += settlements[i];
+        pageFee += fees[i];
+    }
+
+    AlipayMultiRowInsert checkpointInsert(conn, "INSERT INTO alipay_settlement_checkpoints ("
+        "run_key, merchant_id, status, last_create_time, last_out_trade_no, "
+        "settled_count, settlement_amount, fee_amount, update_time"
+        ") VALUES ",
+        " ON DUPLICATE KEY UPDATE status = VALUES(status), "
+        "last_create_time = VALUES(last_create_time), "
+        "last_out_trade_no = VALUES(last_out_trade_no), "
+        "settled_count = settled_count + VALUES(settled_count), "
+        "settlement_amount = settlement_amount + VALUES(settlement_amount), "
+        "fee_amount = fee_amount + VALUES(fee_amount), "
+        "update_time = VALUES(update_time)");
+
+    checkpointInsert.addRow()
+        .str(runKey)
+        .str(merchant.merchant_id)
+        .str(done ? kStatusDone : kStatusRunning)
+        .u64(cursor.last_create_time)
+        .str(cursor.last_out_trade_no)
+        .u64(pageCount)
+        .u64(pageAmount)
+        .u64(pageFee)
+        .u64(now);
+
+    ok = ok && checkpointInsert.flush() && mysql_commit(conn) == 0;
+    if (!ok) {
+        error = settlementInsert.failed() ? settlementInsert.lastError()
+              : checkpointInsert.failed() ? checkpointInsert.lastError()
+              : !error.empty() ? error
+              : mysql_error(conn);
+        mysql_rollback(conn);
+    }
+    mysql_autocommit(conn, 1);
+
+    if (ok) {
+        result.settled_count += pageCount;
+        result.settlement_amount += pageAmount;
+        result.fee_amount += pageFee;
+    }
+    return ok;
+}
@@ -0,0 +1,108 @@
+#include "alipay_sql_builder.h"
+#include <charconv>
+
+void appendSqlString(MYSQL* conn, std::string& out, std::string_view value) {
+    size_t start = out.size();
+    // 最坏情况每个字符都需要转义
+    out.resize(start + value.size() * 2 + 3);
+    out[start] = '\'';
+    unsigned long written = mysql_real_escape_string(
+        conn, &out[start + 1], value.data(), static_cast<unsigned long>(value.size()));
+    out[start + 1 + written] = '\'';
+    out.resize(start + written + 2);
+}
+
+void appendSqlUInt(std::string& out, uint64_t value) {
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out.append(buffer, result.ptr);
+}
+
+// SqlRow 实现
+void SqlRow::separator() {
+    if (!first_) out_ += ", ";
+    first_ = false;
+}
+
+SqlRow& SqlRow::str(std::string_view value) {
+    separator();
+    appendSqlString(conn_, out_, value);
+    return *this;
+}
+
+SqlRow& SqlRow::optStr(const std::optional<std::string>& value) {
+    return value ? str(*value) : null();
+}
+
+SqlRow& SqlRow::u64(uint64_t value) {
+    separator();
+    appendSqlUInt(out_, value);
+    return *this;
+}
+
+SqlRow& SqlRow::optU64(const std::optional<uint64_t>& value) {
+    return value ? u64(*value) : null();
+}
+
+SqlRow& SqlRow::i64(int64_t value) {
+    separator();
+    char buffer[24];
+    auto result = std::to_chars(buffer, buffer + sizeof(buffer), value);
+    out_.append(buffer, result.ptr);
+    return *this;
+}
+
+SqlRow& SqlRow::null() {
+    separator();
+    out_ += "NULL";
+    return *this;
+}
+
+SqlRow& SqlRow::raw(std::string_view expression) {
+    separator();
+    out_ += expression;
+    return *this;
+}
+
+// AlipayMultiRowInsert 实现
+AlipayMultiRowInsert::AlipayMultiRowInsert(MYSQL* conn, std::string prefix,
+                                           std::string suffix, size_t maxBytes)
+    : conn_(conn), prefix_(std::move(prefix)), suffix_(std::move(suffix)),
+      max_bytes_(maxBytes) {
+    reset();
+}
+
+void AlipayMultiRowInsert::reset() {
+    sql_.clear();
+    sql_ += prefix_;
+    rows_ = 0;
+}
+
+SqlRow AlipayMultiRowInsert::addRow() {
+    if (rows_ > 0 && sql_.size() >= max_bytes_) {
+        flush();
+    }
+
+    if (rows_ > 0) sql_ += "), ";
+    sql_ += '(';
+    ++rows_;
+    return SqlRow(conn_, sql_);
+}
+
+bool AlipayMultiRowInsert::flush() {
+    if (rows_ == 0) return !failed();
+
+    sql_ += ')';
+    sql_ += suffix_;
+
+    if (mysql_real_query(conn_, sql_.data(), static_cast<unsigned long>(sql_.size())) != 0) {
+        last_errno_ = mysql_errno(conn_);
+        last_error_ = mysql_error(conn_);
+        reset();
+        return false;
+    }
+
+    affected_rows_ += mysql_affected_rows(conn_);
+    reset();
+    return !failed();
+}
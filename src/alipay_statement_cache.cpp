@@ -0,0 +1,139 @@
+#include "alipay_statement_cache.h"
+#include "alipay_connection_pool.h"
+#include <mysql/errmsg.h>
+#include <mysql/mysqld_error.h>
+
+std::atomic<uint64_t> AlipayStatementCache::global_hits_{0};
+std::atomic<uint64_t> AlipayStatementCache::global_misses_{0};
+std::atomic<uint64_t> AlipayStatementCache::global_invalidations_{0};
+
+AlipayStatementCache::AlipayStatementCache(size_t capacity)
+    : capacity_(capacity == 0 ? 1 : capacity) {}
+
+AlipayStatementCache::~AlipayStatementCache() {
+    for (auto& entry : entries_) {
+        mysql_stmt_close(entry.stmt);
+    }
+}
+
+MYSQL_STMT* AlipayStatementCache::acquire(MYSQL* conn, const std::string& sql) {
+    // 会话 ID 变化说明连接被自动重连过，服务端已不认识旧语句
+    unsigned long thread_id = mysql_thread_id(conn);
+    if (thread_id != thread_id_) {
+        clear();
+        thread_id_ = thread_id;
+    }
+
+    auto it = index_.find(sql);
+    if (it != index_.end()) {
+        entries_.splice(entries_.begin(), entries_, it->second);
+        ++stats_.hits;
+        global_hits_.fetch_add(1, std::memory_order_relaxed);
+        return it->second->stmt;
+    }
+
+    ++stats_.misses;
+    global_misses_.fetch_add(1, std::memory_order_relaxed);
+
+    MYSQL_STMT* stmt = mysql_stmt_init(conn);
+    if (!stmt) {
+        last_error_ = "mysql_stmt_init failed";
+        last_errno_ = mysql_errno(conn);
+        return nullptr;
+    }
+
+    if (mysql_stmt_prepare(stmt, sql.c_str(), sql.length())) {
+        last_error_ = mysql_stmt_error(stmt);
+        last_errno_ = mysql_stmt_errno(stmt);
+        mysql_stmt_close(stmt);
+        return nullptr;
+    }
+
+    if (entries_.size() >= capacity_) {
+        auto& victim = entries_.back();
+        index_.erase(victim.sql);
+        mysql_stmt_close(victim.stmt);
+        entries_.pop_back();
+    }
+
+    entries_.push_front(Entry{sql, stmt});
+    index_[sql] = entries_.begin();
+    return stmt;
+}
+
+void AlipayStatementCache::invalidate(MYSQL_STMT* stmt) {
+    for (auto it = entries_.begin(); it != entries_.end(); ++it) {
+        if (it->stmt == stmt) {
+            index_.erase(it->sql);
+            mysql_stmt_close(it->stmt);
+            entries_.erase(it);
+            ++stats_.invalidations;
+            global_invalidations_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+}
+
+void AlipayStatementCache::clear() {
+    for (auto& entry : entries_) {
+        mysql_stmt_close(entry.stmt);
+    }
+    stats_.invalidations += entries_.size();
+    global_invalidations_.fetch_add(entries_.size(), std::memory_order_relaxed);
+    entries_.clear();
+    index_.clear();
+}
+
+StatementCacheStats AlipayStatementCache::globalStats() {
+    StatementCacheStats stats;
+    stats.hits = global_hits_.load(std::memory_order_relaxed);
+    stats.misses = global_misses_.load(std::memory_order_relaxed);
+    stats.invalidations = global_invalidations_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+namespace {
+
+// 2000 以上为客户端错误（断线、超时等），连接不可再用
+bool isClientError(unsigned int error) {
+    return error >= CR_MIN_ERROR && error <= CR_MAX_ERROR;
+}
+
+} // namespace
+
+// CachedStatement 实现
+CachedStatement::CachedStatement(PooledConnection& lease, const std::string& sql)
+    : lease_(lease), cache_(lease ? &lease.statements() : nullptr),
+      stmt_(cache_ ? cache_->acquire(lease.get(), sql) : nullptr) {
+    if (!stmt_ && cache_ && isClientError(cache_->lastErrno())) {
+        cache_->clear();
+        lease_.markBroken();
+    }
+}
+
+CachedStatement::~CachedStatement() {
+    if (!stmt_) return;
+
+    unsigned int error = mysql_stmt_errno(stmt_);
+    if (isClientError(error)) {
+        // 连接已断开，所有语句句柄都不可再用，连接也不能再放回池中
+        cache_->clear();
+        lease_.markBroken();
+        return;
+    }
+    switch (error) {
+        case ER_UNKNOWN_STMT_HANDLER:
+        case ER_NEED_REPREPARE:
+            cache_->invalidate(stmt_);
+            break;
+        default:
+            // 保留语句供下次复用，只释放本次结果集
+            mysql_stmt_free_result(stmt_);
+            break;
+    }
+}
+
+const char* CachedStatement::error() const {
+    if (stmt_) return mysql_stmt_error(stmt_);
+    return cache_ ? cache_->lastError().c_str() : "no connection";
+}
@@ -0,0 +1,147 @@
+#include "alipay_timing_wheel.h"
+
+AlipayTimingWheel::AlipayTimingWheel(uint64_t startTick) : current_(startTick) {
+    heads_.fill(kNil);
+}
+
+uint32_t AlipayTimingWheel::slotFor(uint64_t deadline) const {
+    // 超出总跨度的定时器先放在最高层，逐层下沉时再按真实到期时间处理
+    uint64_t delta = deadline - current_;
+    if (delta >= kMaxSpan) {
+        deadline = current_ + kMaxSpan - 1;
+        delta = kMaxSpan - 1;
+    }
+
+    if (delta < kRootSlots) {
+        return static_cast<uint32_t>(deadline & (kRootSlots - 1));
+    }
+
+    for (int level = 1; level < kLevels; ++level) {
+        int shift = kRootBits + kLevelBits * level;
+        if (level == kLevels - 1 || delta < (uint64_t(1) << shift)) {
+            uint64_t index = (deadline >> (shift - kLevelBits)) & (kLevelSlots - 1);
+            return kRootSlots + kLevelSlots * (level - 1) + static_cast<uint32_t>(index);
+        }
+    }
+    return kNil; // 不可达
+}
+
+void AlipayTimingWheel::link(uint32_t node) {
+    Node& n = nodes_[node];
+    if (n.deadline < current_) n.deadline = current_;
+
+    n.slot = slotFor(n.deadline);
+    n.prev = kNil;
+    n.next = heads_[n.slot];
+    if (n.next != kNil) nodes_[n.next].prev = node;
+    heads_[n.slot] = node;
+}
+
+void AlipayTimingWheel::unlink(uint32_t node) {
+    Node& n = nodes_[node];
+    if (n.prev != kNil) {
+        nodes_[n.prev].next = n.next;
+    } else {
+        heads_[n.slot] = n.next;
+    }
+    if (n.next != kNil) nodes_[n.next].prev = n.prev;
+    n.prev = n.next = kNil;
+}
+
+uint32_t AlipayTimingWheel::allocate() {
+    if (free_head_ != kNil) {
+        uint32_t node = free_head_;
+        free_head_ = nodes_[node].next;
+        nodes_[node].next = kNil;
+        return node;
+    }
+    nodes_.emplace_back();
+    return static_cast<uint32_t>(nodes_.size() - 1);
+}
+
+void AlipayTimingWheel::release(uint32_t node) {
+    Node& n = nodes_[node];
+    n.key.clear();
+    n.slot = kNil;
+    n.prev = kNil;
+    n.next = free_head_;
+    free_head_ = node;
+}
+
+void AlipayTimingWheel::schedule(const std::string& key, uint64_t deadline) {
+    auto it = index_.find(key);
+    if (it != index_.end()) {
+        unlink(it->second);
+        nodes_[it->second].deadline = deadline;
+        link(it->second);
+        return;
+    }
+
+    uint32_t node = allocate();
+    nodes_[node].key = key;
+    nodes_[node].deadline = deadline;
+    link(node);
+    index_.emplace(key, node);
+}
+
+bool AlipayTimingWheel::cancel(const std::string& key) {
+    auto it = index_.find(key);
+    if (it == index_.end()) return false;
+
+    unlink(it->second);
+    release(it->second);
+    index_.erase(it);
+    return true;
+}
+
+void AlipayTimingWheel::cascade(int level) {
+    // 取下整个槽位，按与当前刻度的距离重新放入低层
+    uint64_t index = (current_ >> (kRootBits + kLevelBits * (level - 1))) & (kLevelSlots - 1);
+    uint32_t slot = kRootSlots + kLevelSlots * (level - 1) + static_cast<uint32_t>(index);
+
+    uint32_t node = heads_[slot];
+    heads_[slot] = kNil;
+    while (node != kNil) {
+        uint32_t next = nodes_[node].next;
+        link(node);
+        node = next;
+    }
+
+    // 本层也转完一圈时继续向上一层借位
+    if (index == 0 && level + 1 < kLevels) {
+        cascade(level + 1);
+    }
+}
+
+void AlipayTimingWheel::advance(uint64_t now, std::vector<std::string>& expired) {
+    while (current_ <= now) {
+        // 没有定时器时直接跳到目标刻度
+        if (index_.empty()) {
+            current_ = now + 1;
+            return;
+        }
+
+        uint32_t slot = static_cast<uint32_t>(current_ & (kRootSlots - 1));
+        if (slot == 0) {
+            cascade(1);
+        }
+
+        uint32_t node = heads_[slot];
+        heads_[slot] = kNil;
+        while (node != kNil) {
+            uint32_t next = nodes_[node].next;
+            Node& n = nodes_[node];
+            if (n.deadline > current_) {
+                // 超出总跨度被截断的定时器，尚未真正到期
+                link(node);
+            } else {
+                expired.push_back(std::move(n.key));
+                index_.erase(expired.back());
+                release(node);
+            }
+            node = next;
+        }
+
+        ++current_;
+    }
+}
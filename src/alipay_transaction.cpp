@@ -1,27 +1,89 @@
 #include "alipay_transaction.h"
-#include <sstream>
-#include <chrono>
-#include <iomanip>
-#include <random>
+#include "alipay_id_generator.h"
+#include <mysql/mysqld_error.h>
+#include <mysql/errmsg.h>
 
 AlipayTransaction::AlipayTransaction() : conn(nullptr) {}
 
 AlipayTransaction::~AlipayTransaction() {
-    if (conn) {
-        mysql_close(conn);
+    // 各分支的 lease 析构时归还连接池或关闭独占连接；
+    // 未结束的分支不能把连接还给别人，直接关闭（未准备的分支随之回滚，已准备的留给恢复）
+    for (auto& branch : branches_) {
+        bool finished = branch.state == BranchState::IDLE ||
+                        branch.state == BranchState::COMMITTED ||
+                        branch.state == BranchState::ROLLED_BACK;
+        if (!finished || aborted()) {
+            branch.lease.markBroken();
+        }
     }
 }
 
 bool AlipayTransaction::connectDB(const char* host, const char* user, 
                                 const char* password, const char* db) {
-    conn = mysql_init(nullptr);
+    Branch branch;
+    branch.lease = PooledConnection::open(host, user, password, db);
+    branch.conn = branch.lease.get();
+    if (!branch.conn) return false;
+    branch.thread_id = mysql_thread_id(branch.conn);
+    
+    branches_.clear();
+    branches_.push_back(std::move(branch));
+    conn = branches_.front().conn;
+    return true;
+}
+
+bool AlipayTransaction::connectDB(AlipayConnectionPool& pool) {
+    Branch branch;
+    branch.lease = pool.acquire();
+    branch.conn = branch.lease.get();
+    if (!branch.conn) return false;
+    branch.thread_id = mysql_thread_id(branch.conn);
+    
+    branches_.clear();
+    branches_.push_back(std::move(branch));
+    conn = branches_.front().conn;
+    return true;
+}
+
+bool AlipayTransaction::addParticipant(const std::string& name, AlipayConnectionPool& pool) {
     if (!conn) return false;
     
-    if (!mysql_real_connect(conn, host, user, password, db, 0, nullptr, 0)) {
-        return false;
-    }
+    Branch branch;
+    branch.name = name;
+    branch.lease = pool.acquire();
+    branch.conn = branch.lease.get();
+    if (!branch.conn) return false;
+    branch.thread_id = mysql_thread_id(branch.conn);
     
-    mysql_set_character_set(conn, "utf8mb4");
+    branches_.push_back(std::move(branch));
+    if (!current_xid_.empty()) {
+        return startBranch(branches_.back(), branchXid(branches_.size() - 1));
+    }
+    return true;
+}
+
+std::string AlipayTransaction::branchXid(size_t index) const {
+    if (index == 0) return "'" + current_xid_ + "'";
+    return "'" + current_xid_ + "','" + branches_[index].name + "'";
+}
+
+bool AlipayTransaction::startBranch(Branch& branch, const std::string& xid) {
+    std::string start_query = "XA START " + xid;
+    if (mysql_query(branch.conn, start_query.c_str()) != 0) return false;
+    branch.state = BranchState::ACTIVE;
+    return true;
+}
+
+bool AlipayTransaction::execute(size_t index, const std::string& statement) {
+    std::string query = statement + " " + branchXid(index);
+    return mysql_query(branches_[index].conn, query.c_str()) == 0;
+}
+
+bool AlipayTransaction::endBranch(size_t index) {
+    Branch& branch = branches_[index];
+    if (branch.state != BranchState::ACTIVE) return true;
+    if (!execute(index, "XA END")) return false;
+    branch.state = BranchState::ENDED;
     return true;
 }
 
@@ -29,48 +91,138 @@ bool AlipayTransaction::beginTransaction(const std::string& xid) {
     if (!conn) return false;
     
     current_xid_ = xid;
-    std::string start_query = "XA START '" + current_xid_ + "'";
-    return mysql_query(conn, start_query.c_str()) == 0;
+    for (size_t i = 0; i < branches_.size(); ++i) {
+        if (!startBranch(branches_[i], branchXid(i))) return false;
+    }
+    return true;
+}
+
+bool AlipayTransaction::prepareBranch(size_t index) {
+    if (current_xid_.empty() || index >= branches_.size()) return false;
+    
+    Branch& branch = branches_[index];
+    if (branch.state == BranchState::PREPARED) return true;
+    if (!endBranch(index)) return false;
+    if (branch.state != BranchState::ENDED) return false;
+    
+    if (!execute(index, "XA PREPARE")) return false;
+    branch.state = BranchState::PREPARED;
+    return true;
+}
+
+bool AlipayTransaction::commitBranch(size_t index) {
+    if (index >= branches_.size()) return false;
+    
+    Branch& branch = branches_[index];
+    if (branch.state == BranchState::COMMITTED) return true;
+    if (current_xid_.empty()) return false;
+    if (branch.state != BranchState::PREPARED) return false;
+    
+    if (!execute(index, "XA COMMIT")) return false;
+    branch.state = BranchState::COMMITTED;
+    return true;
+}
+
+bool AlipayTransaction::rollbackBranch(size_t index) {
+    if (index >= branches_.size()) return false;
+    
+    Branch& branch = branches_[index];
+    if (branch.state == BranchState::ROLLED_BACK) return true;
+    if (current_xid_.empty()) return false;
+    if (branch.state == BranchState::COMMITTED) return false;
+    if (branch.state == BranchState::UNKNOWN) return false;
+    
+    // 未 XA END 的分支须先结束才能回滚
+    if (branch.state == BranchState::ACTIVE) {
+        execute(index, "XA END");
+    }
+    
+    // 准备失败时 MySQL 可能已回滚该分支，此时 XA ROLLBACK 报 XAER_NOTA，同样视为已回滚
+    bool result = execute(index, "XA ROLLBACK") ||
+                  mysql_errno(branch.conn) == ER_XAER_NOTA;
+    if (result) branch.state = BranchState::ROLLED_BACK;
+    return result;
+}
+
+bool AlipayTransaction::claimCompletion() {
+    int expected = kOpen;
+    return completion_.compare_exchange_strong(expected, kCompleting) ||
+           expected == kCompleting;
+}
+
+bool AlipayTransaction::tryAbort() {
+    int expected = kOpen;
+    return completion_.compare_exchange_strong(expected, kAborted);
+}
+
+bool AlipayTransaction::outcomeUnknown() const {
+    for (const auto& branch : branches_) {
+        if (branch.state == BranchState::UNKNOWN) return true;
+    }
+    return false;
+}
+
+bool AlipayTransaction::hasCommittedBranch() const {
+    for (const auto& branch : branches_) {
+        if (branch.state == BranchState::COMMITTED) return true;
+    }
+    return false;
 }
 
 bool AlipayTransaction::prepareTransaction() {
     if (!conn || current_xid_.empty()) return false;
     
-    std::string prepare_query = "XA END '" + current_xid_ + "'";
-    if (mysql_query(conn, prepare_query.c_str()) != 0) return false;
+    for (size_t i = 0; i < branches_.size(); ++i) {
+        if (!prepareBranch(i)) return false;
+    }
+    return true;
+}
+
+bool AlipayTransaction::commitOnePhase() {
+    if (!conn || current_xid_.empty() || branches_.size() != 1) return false;
     
-    prepare_query = "XA PREPARE '" + current_xid_ + "'";
-    return mysql_query(conn, prepare_query.c_str()) == 0;
+    if (!endBranch(0)) return false;
+    
+    std::string commit_query = "XA COMMIT " + branchXid(0) + " ONE PHASE";
+    if (mysql_query(conn, commit_query.c_str()) == 0) {
+        branches_[0].state = BranchState::COMMITTED;
+        current_xid_.clear();
+        return true;
+    }
+    
+    // 服务端报错时 MySQL 已回滚该分支；客户端错误（连接中断等）时服务端可能已提交，结果未知
+    unsigned int error = mysql_errno(conn);
+    if (error >= CR_MIN_ERROR && error <= CR_MAX_ERROR) {
+        branches_[0].state = BranchState::UNKNOWN;
+        return false;
+    }
+    branches_[0].state = BranchState::ROLLED_BACK;
+    current_xid_.clear();
+    return false;
 }
 
 bool AlipayTransaction::commitTransaction() {
     if (!conn || current_xid_.empty()) return false;
     
-    std::string commit_query = "XA COMMIT '" + current_xid_ + "'";
-    bool result = mysql_query(conn, commit_query.c_str()) == 0;
-    current_xid_.clear();
+    bool result = true;
+    for (size_t i = 0; i < branches_.size(); ++i) {
+        result = commitBranch(i) && result;
+    }
+    if (result) current_xid_.clear();
     return result;
 }
 
 bool AlipayTransaction::rollbackTransaction() {
-    if (!conn || current_xid_.empty()) return false;
+    if (!conn) return false;
     
-    std::string rollback_query = "XA ROLLBACK '" + current_xid_ + "'";
-    bool result = mysql_query(conn, rollback_query.c_str()) == 0;
+    bool result = true;
+    for (size_t i = 0; i < branches_.size(); ++i) {
+        result = rollbackBranch(i) && result;
+    }
     current_xid_.clear();
     return result;
 }
 
 std::string AlipayTransaction::generateXID(const std::string& prefix) {
-    auto now = std::chrono::system_clock::now();
-    auto now_ms = std::chrono::duration_cast<std::chrono::milliseconds>(
-        now.time_since_epoch()).count();
-    
-    std::random_device rd;
-    std::mt19937 gen(rd());
-    std::uniform_int_distribution<> dis(1000, 9999);
-    
-    std::stringstream ss;
-    ss << prefix << "_" << now_ms << "_" << dis(gen);
-    return ss.str();
-} 
\ No newline at end of file
+    return AlipayIdGenerator::getInstance().nextString(prefix);
+}
@@ -0,0 +1,136 @@
+#include "alipay_transaction_log.h"
+#include "alipay_sql_builder.h"
+
+namespace {
+
+std::string joinParticipants(const std::vector<std::string>& participants) {
+    std::string joined;
+    for (const auto& p : participants) {
+        if (!joined.empty()) joined += ",";
+        joined += p;
+    }
+    return joined;
+}
+
+} // namespace
+
+AlipayTransactionLogWriter::AlipayTransactionLogWriter(AlipayConnectionPool& pool,
+                                                       const TransactionLogOptions& options)
+    : pool_(pool), options_(options) {
+    writer_ = std::thread(&AlipayTransactionLogWriter::run, this);
+}
+
+AlipayTransactionLogWriter::~AlipayTransactionLogWriter() {
+    stop();
+}
+
+void AlipayTransactionLogWriter::stop() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (stopping_) return;
+        stopping_ = true;
+    }
+    pending_.notify_all();
+    if (writer_.joinable()) writer_.join();
+}
+
+bool AlipayTransactionLogWriter::append(const TransactionRecord& record) {
+    return appendAsync(record).get();
+}
+
+std::shared_future<bool> AlipayTransactionLogWriter::appendAsync(const TransactionRecord& record) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopping_) {
+        std::promise<bool> rejected;
+        rejected.set_value(false);
+        return rejected.get_future().share();
+    }
+
+    // 队尾批次已满时开启新批次
+    if (batches_.empty() || batches_.back()->records.size() >= batches_.back()->capacity) {
+        auto batch = std::make_shared<LogBatch>();
+        batch->capacity = options_.max_batch > 0 ? options_.max_batch : 1;
+        batch->records.reserve(batch->capacity);
+        batch->opened = std::chrono::steady_clock::now();
+        batch->done = batch->promise.get_future().share();
+        batches_.push_back(std::move(batch));
+    }
+
+    LogBatch& batch = *batches_.back();
+    batch.records.push_back(record);
+    std::shared_future<bool> done = batch.done;
+
+    // 只在新批次的第一条和批次装满时唤醒写线程
+    bool wake = batch.records.size() == 1 || batch.records.size() >= batch.capacity;
+    lock.unlock();
+    if (wake) pending_.notify_one();
+    return done;
+}
+
+void AlipayTransactionLogWriter::setOptions(const TransactionLogOptions& options) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    options_ = options;
+}
+
+TransactionLogStats AlipayTransactionLogWriter::stats() const {
+    TransactionLogStats stats;
+    stats.batches = batches_written_.load(std::memory_order_relaxed);
+    stats.records = records_written_.load(std::memory_order_relaxed);
+    stats.failed_batches = failed_batches_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AlipayTransactionLogWriter::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        pending_.wait(lock, [this] { return stopping_ || !batches_.empty(); });
+        if (batches_.empty()) return; // stopping_ 且已写完
+
+        // 队头批次未满且后面没有排队的批次时，等到最长等待时间再写
+        std::shared_ptr<LogBatch> batch = batches_.front();
+        auto deadline = batch->opened + std::chrono::microseconds(options_.max_wait_us);
+        pending_.wait_until(lock, deadline, [this, &batch] {
+            return stopping_ || batches_.size() > 1 ||
+                   batch->records.size() >= batch->capacity;
+        });
+        batches_.pop_front();
+
+        lock.unlock();
+        bool ok = write(batch->records);
+        batch->promise.set_value(ok);
+        lock.lock();
+    }
+}
+
+bool AlipayTransactionLogWriter::write(const std::vector<TransactionRecord>& records) {
+    auto lease = pool_.acquire();
+    if (!lease) {
+        failed_batches_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    MYSQL* conn = lease.get();
+
+    // 同一 XID 在一批中出现多次时，后写入的行生效，与追加顺序一致
+    AlipayMultiRowInsert insert(conn, "INSERT INTO alipay_transactions ("
+        "xid, status, create_time, update_time, order_no, participants"
+        ") VALUES ",
+        " ON DUPLICATE KEY UPDATE status = VALUES(status), "
+        "update_time = VALUES(update_time)");
+    for (const auto& record : records) {
+        insert.addRow()
+            .str(record.xid)
+            .u64(statusCode(record.status))
+            .u64(record.create_time)
+            .u64(record.update_time)
+            .str(record.order_no)
+            .str(joinParticipants(record.participants));
+    }
+
+    if (!insert.flush()) {
+        failed_batches_.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    batches_written_.fetch_add(1, std::memory_order_relaxed);
+    records_written_.fetch_add(records.size(), std::memory_order_relaxed);
+    return true;
+}
@@ -1,57 +1,212 @@
 #include "alipay_transaction_manager.h"
+#include "alipay_schema_manager.h"
+#include "alipay_sql_builder.h"
+#include "alipay_id_generator.h"
+#include <mysql/mysqld_error.h>
+#include <algorithm>
 #include <chrono>
 #include <sstream>
+#include <cstring>
+
+namespace {
+
+// 本管理器生成的 XID 前缀，恢复时只处理带该前缀的孤立分支
+constexpr const char* kXidPrefix = "TXN";
+
+// 回收时未能 KILL 全部分支（连接池借不到连接等）后的重试间隔，按次数翻倍
+constexpr uint64_t kReapRetryBaseMs = 1000;
+constexpr uint64_t kReapRetryMaxMs = 60000;
+
+// 与本库分支同在订单库上的参与者名称
+bool isPrimaryParticipant(const std::string& name) {
+    return name == "orders" || name == "payments";
+}
+
+std::string branchKey(const std::string& gtrid, const std::string& bqual) {
+    return gtrid + '\n' + bqual;
+}
+
+std::vector<std::string> splitParticipants(const char* participants) {
+    std::vector<std::string> names;
+    std::stringstream stream(participants ? participants : "");
+    std::string name;
+    while (std::getline(stream, name, ',')) {
+        if (!name.empty()) names.push_back(name);
+    }
+    return names;
+}
+
+} // namespace
 
 AlipayTransactionManager& AlipayTransactionManager::getInstance() {
     static AlipayTransactionManager instance;
     return instance;
 }
 
-AlipayTransactionManager::AlipayTransactionManager() : conn_(nullptr) {
-    conn_ = mysql_init(nullptr);
-    if (conn_) {
-        mysql_real_connect(conn_, "localhost", "username", "password", "dbname", 0, nullptr, 0);
-        mysql_set_character_set(conn_, "utf8mb4");
-        createTransactionTable();
+AlipayTransactionManager::AlipayTransactionManager()
+    : pool_(AlipayConnectionPool::getInstance()), log_(pool_),
+      io_pool_(std::make_unique<AlipayWorkStealingPool>(kIoWorkers)),
+      recovery_cutoff_xid_(AlipayTransaction::generateXID(kXidPrefix)) {
+    auto lease = pool_.acquire();
+    if (lease) {
+        AlipaySchemaManager::getInstance().ensureSchema(lease.get());
     }
+    reaper_thread_ = std::thread(&AlipayTransactionManager::runReaper, this);
 }
 
 AlipayTransactionManager::~AlipayTransactionManager() {
-    if (conn_) {
-        mysql_close(conn_);
+    stopping_ = true;
+    waitForRecovery();
+    {
+        std::lock_guard<std::mutex> lock(reaper_mutex_);
+        reaper_stopping_ = true;
+    }
+    reaper_wakeup_.notify_all();
+    if (reaper_thread_.joinable()) {
+        reaper_thread_.join();
+    }
+}
+
+const char* transactionStatusToString(TransactionStatus status) {
+    // 名称表中的 string_view 都指向字符串字面量，以 '\0' 结尾
+    std::string_view name = statusName(status);
+    return name.empty() ? "FAILED" : name.data();
+}
+
+TransactionStatus transactionStatusFromString(const std::string& status) {
+    return statusFromName<TransactionStatus>(status).value_or(TransactionStatus::FAILED);
+}
+
+bool AlipayTransactionManager::saveTransactionRecord(const TransactionRecord& record) {
+    return wal_ ? wal_->append(record) : log_.append(record);
+}
+
+bool AlipayTransactionManager::updateTransactionStatus(const TransactionRecord& record,
+                                                      TransactionStatus status) {
+    TransactionRecord updated = record;
+    updated.status = status;
+    updated.update_time = std::chrono::system_clock::to_time_t(
+        std::chrono::system_clock::now());
+    return wal_ ? wal_->append(updated) : log_.append(updated);
+}
+
+void AlipayTransactionManager::setLogOptions(const TransactionLogOptions& options) {
+    log_.setOptions(options);
+}
+
+TransactionLogStats AlipayTransactionManager::logStats() const {
+    return log_.stats();
+}
+
+bool AlipayTransactionManager::enableWal(const TransactionWalOptions& options,
+                                         std::string& error) {
+    auto wal = std::make_unique<AlipayTransactionWal>(options);
+    if (!wal->open(error)) {
+        return false;
     }
+    wal_ = std::move(wal);
+    return true;
 }
 
-bool AlipayTransactionManager::createTransactionTable() {
-    const char* sql = R"SQL(
-        CREATE TABLE IF NOT EXISTS alipay_transactions (
-            xid VARCHAR(128) PRIMARY KEY,
-            status VARCHAR(32) NOT NULL,
-            create_time BIGINT UNSIGNED NOT NULL,
-            update_time BIGINT UNSIGNED NOT NULL,
-            order_no VARCHAR(64) NOT NULL,
-            participants TEXT,
-            INDEX idx_status (status),
-            INDEX idx_create_time (create_time),
-            INDEX idx_order_no (order_no)
-        ) ENGINE=InnoDB DEFAULT CHARSET=utf8mb4
-    )SQL";
+bool AlipayTransactionManager::addParticipant(const std::string& name,
+                                              AlipayConnectionPool& pool) {
+    if (name.empty()) {
+        return false;
+    }
+    participants_.push_back(Participant{name, &pool});
+    return true;
+}
+
+AlipayConnectionPool* AlipayTransactionManager::participantPool(const std::string& name) {
+    for (const auto& participant : participants_) {
+        if (participant.name == name) return participant.pool;
+    }
+    return nullptr;
+}
+
+bool AlipayTransactionManager::forEachBranch(AlipayTransaction& transaction,
+                                             const std::function<bool(size_t)>& operation) {
+    size_t count = transaction.resourceManagerCount();
+    if (count <= 1) {
+        bool ok = true;
+        for (size_t i = 0; i < count; ++i) {
+            ok = operation(i) && ok;
+        }
+        return ok;
+    }
+    
+    // 其余分支交给 I/O 线程池，第一个分支在调用线程上执行
+    std::vector<std::future<bool>> results;
+    results.reserve(count - 1);
+    for (size_t i = 1; i < count; ++i) {
+        auto task = std::make_shared<std::packaged_task<bool()>>(
+            [&operation, i] { return operation(i); });
+        results.push_back(task->get_future());
+        io_pool_->submit([task](size_t) { (*task)(); });
+    }
     
-    return mysql_query(conn_, sql) == 0;
+    bool ok = false;
+    try {
+        ok = operation(0);
+    }
+    catch (const std::exception&) {
+        ok = false;
+    }
+    // 必须等齐所有分支：operation 以引用被任务持有
+    for (auto& result : results) {
+        try {
+            ok = result.get() && ok;
+        }
+        catch (const std::exception&) {
+            ok = false;
+        }
+    }
+    return ok;
+}
+
+AlipayTransactionManager::TransactionShard&
+AlipayTransactionManager::shardFor(const std::string& xid) {
+    return active_transactions_[std::hash<std::string>()(xid) % kShardCount];
+}
+
+bool AlipayTransactionManager::findTransaction(const std::string& xid,
+                                               ActiveTransaction& active) {
+    TransactionShard& shard = shardFor(xid);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+
+    auto it = shard.transactions.find(xid);
+    if (it == shard.transactions.end()) return false;
+    active = it->second;
+    return true;
+}
+
+void AlipayTransactionManager::setStatus(const std::string& xid, TransactionStatus status) {
+    TransactionShard& shard = shardFor(xid);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    auto it = shard.transactions.find(xid);
+    if (it != shard.transactions.end()) {
+        it->second.record.status = status;
+        it->second.record.update_time = std::chrono::system_clock::to_time_t(
+            std::chrono::system_clock::now());
+    }
+}
+
+void AlipayTransactionManager::erase(const std::string& xid) {
+    TransactionShard& shard = shardFor(xid);
+    std::lock_guard<std::mutex> lock(shard.mutex);
+    shard.transactions.erase(xid);
 }
 
 bool AlipayTransactionManager::startTransaction(
     const std::string& orderNo,
     std::shared_ptr<AlipayTransaction>& transaction) {
     
-    std::lock_guard<std::mutex> lock(mutex_);
-    
     try {
-        // 创建新事务
-        auto xid = AlipayTransaction::generateXID("TXN");
+        // 创建新事务（借连接、XA START、写事务表均不持锁）
+        auto xid = AlipayTransaction::generateXID(kXidPrefix);
         transaction = std::make_shared<AlipayTransaction>();
         
-        if (!transaction->connectDB("localhost", "username", "password", "dbname")) {
+        if (!transaction->connectDB(pool_)) {
             return false;
         }
         
@@ -59,7 +214,17 @@ bool AlipayTransactionManager::startTransaction(
             return false;
         }
         
-        // 记录事务信息
+        // 其他资源管理器（如结算库）各开一个分支
+        for (const auto& participant : participants_) {
+            if (!transaction->addParticipant(participant.name, *participant.pool)) {
+                transaction->rollbackTransaction();
+                return false;
+            }
+        }
+        
+        // 记录事务信息；订单与支付在同一个库时只有一个资源管理器，走一阶段提交
+        const char* path = transaction->resourceManagerCount() == 1
+            ? kCommitPathOnePhase : kCommitPathTwoPhase;
         TransactionRecord record{
             .xid = xid,
             .status = TransactionStatus::STARTED,
@@ -67,15 +232,23 @@ bool AlipayTransactionManager::startTransaction(
                 std::chrono::system_clock::now()),
             .update_time = record.create_time,
             .order_no = orderNo,
-            .participants = {"orders", "payments"}
+            .participants = {path, "orders", "payments"}
         };
+        for (const auto& participant : participants_) {
+            record.participants.push_back(participant.name);
+        }
         
         if (!saveTransactionRecord(record)) {
             transaction->rollbackTransaction();
             return false;
         }
         
-        active_transactions_[xid] = record;
+        {
+            TransactionShard& shard = shardFor(xid);
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            shard.transactions[xid] = ActiveTransaction{std::move(record), transaction};
+        }
+        scheduleDeadline(xid);
         return true;
     }
     catch (const std::exception&) {
@@ -84,20 +257,40 @@ bool AlipayTransactionManager::startTransaction(
 }
 
 bool AlipayTransactionManager::prepareTransaction(const std::string& xid) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    ActiveTransaction active;
+    if (!findTransaction(xid, active)) {
+        return false;
+    }
     
-    auto it = active_transactions_.find(xid);
-    if (it == active_transactions_.end()) {
+    // 已被超时回收的事务不能再准备
+    if (active.transaction && !active.transaction->claimCompletion()) {
         return false;
     }
     
     try {
-        // 更新事务状态
-        it->second.status = TransactionStatus::PREPARED;
-        it->second.update_time = std::chrono::system_clock::to_time_t(
-            std::chrono::system_clock::now());
-            
-        return updateTransactionStatus(xid, TransactionStatus::PREPARED);
+        // 一阶段提交没有准备阶段，也无需为此写日志
+        if (isOnePhaseCommit(active.record)) {
+            setStatus(xid, TransactionStatus::PREPARED);
+            return true;
+        }
+        
+        // 各分支并发准备；任一分支失败则回滚全部分支（未写 PREPARED，按推定回滚处理）
+        if (active.transaction) {
+            AlipayTransaction& transaction = *active.transaction;
+            if (!forEachBranch(transaction, [&](size_t i) { return transaction.prepareBranch(i); })) {
+                forEachBranch(transaction, [&](size_t i) { return transaction.rollbackBranch(i); });
+                updateTransactionStatus(active.record, TransactionStatus::ROLLED_BACK);
+                erase(xid);
+                return false;
+            }
+        }
+        
+        // 先持久化，成功后再更新内存中的状态
+        if (!updateTransactionStatus(active.record, TransactionStatus::PREPARED)) {
+            return false;
+        }
+        setStatus(xid, TransactionStatus::PREPARED);
+        return true;
     }
     catch (const std::exception&) {
         return false;
@@ -105,25 +298,39 @@ bool AlipayTransactionManager::prepareTransaction(const std::string& xid) {
 }
 
 bool AlipayTransactionManager::commitTransaction(const std::string& xid) {
-    std::lock_guard<std::mutex> lock(mutex_);
+    ActiveTransaction active;
+    if (!findTransaction(xid, active)) {
+        return false;
+    }
     
-    auto it = active_transactions_.find(xid);
-    if (it == active_transactions_.end()) {
+    if (active.transaction && !active.transaction->claimCompletion()) {
         return false;
     }
     
     try {
-        // 更新事务状态
-        it->second.status = TransactionStatus::COMMITTED;
-        it->second.update_time = std::chrono::system_clock::to_time_t(
-            std::chrono::system_clock::now());
-            
-        if (!updateTransactionStatus(xid, TransactionStatus::COMMITTED)) {
+        // 两阶段提交的各分支并发提交；部分分支失败时事务保持 PREPARED，
+        // 再次调用只重试尚未提交的分支
+        if (active.transaction) {
+            AlipayTransaction& transaction = *active.transaction;
+            bool committed = isOnePhaseCommit(active.record)
+                ? transaction.commitOnePhase()
+                : forEachBranch(transaction, [&](size_t i) { return transaction.commitBranch(i); });
+            if (!committed) {
+                // 结果未知时不能记为回滚：记为 FAILED，实际结果以订单、支付表为准
+                if (transaction.outcomeUnknown() &&
+                    updateTransactionStatus(active.record, TransactionStatus::FAILED)) {
+                    erase(xid);
+                }
+                return false;
+            }
+        }
+        
+        if (!updateTransactionStatus(active.record, TransactionStatus::COMMITTED)) {
             return false;
         }
         
         // 移除活动事务
-        active_transactions_.erase(it);
+        erase(xid);
         return true;
     }
     catch (const std::exception&) {
@@ -131,43 +338,525 @@ bool AlipayTransactionManager::commitTransaction(const std::string& xid) {
     }
 }
 
-void AlipayTransactionManager::recoverTransactions() {
-    std::lock_guard<std::mutex> lock(mutex_);
+bool AlipayTransactionManager::rollbackTransaction(const std::string& xid) {
+    ActiveTransaction active;
+    if (!findTransaction(xid, active)) {
+        return false;
+    }
     
     try {
-        // 查询所有未完成的事务
-        std::string query = "SELECT * FROM alipay_transactions "
-                           "WHERE status IN ('STARTED', 'PREPARED')";
-                           
-        if (mysql_query(conn_, query.c_str()) != 0) {
-            return;
+        // 已有分支提交时只能继续提交
+        if (active.transaction) {
+            AlipayTransaction& transaction = *active.transaction;
+            if (transaction.hasCommittedBranch() ||
+                !forEachBranch(transaction, [&](size_t i) { return transaction.rollbackBranch(i); })) {
+                return false;
+            }
         }
         
-        MYSQL_RES* result = mysql_store_result(conn_);
-        if (!result) {
-            return;
+        if (!updateTransactionStatus(active.record, TransactionStatus::ROLLED_BACK)) {
+            return false;
         }
         
-        MYSQL_ROW row;
-        while ((row = mysql_fetch_row(result))) {
-            TransactionRecord record{
-                .xid = row[0],
-                .status = TransactionStatus::STARTED,
-                .create_time = std::stoull(row[2]),
-                .update_time = std::stoull(row[3]),
-                .order_no = row[4]
-            };
-            
-            // 解析参与者列表
-            std::string participants(row[5]);
-            // ... 解析逻辑 ...
-            
-            active_transactions_[record.xid] = record;
+        erase(xid);
+        return true;
+    }
+    catch (const std::exception&) {
+        return false;
+    }
+}
+
+TransactionStatus AlipayTransactionManager::getTransactionStatus(const std::string& xid) {
+    ActiveTransaction active;
+    if (!findTransaction(xid, active)) {
+        return TransactionStatus::FAILED;
+    }
+    return active.record.status;
+}
+
+std::vector<TransactionRecord> AlipayTransactionManager::getPendingTransactions() {
+    std::vector<TransactionRecord> pending;
+    for (auto& shard : active_transactions_) {
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        for (const auto& entry : shard.transactions) {
+            pending.push_back(entry.second.record);
         }
-        
+    }
+    return pending;
+}
+
+uint64_t AlipayTransactionManager::cleanupTransactions(uint64_t beforeTime) {
+    // WAL 中已结束的事务在段压缩时丢弃
+    if (wal_) {
+        wal_->compact();
+        return 0;
+    }
+    
+    size_t chunkSize;
+    {
+        std::lock_guard<std::mutex> lock(reaper_mutex_);
+        chunkSize = reaper_options_.cleanup_chunk_size > 0 ? reaper_options_.cleanup_chunk_size : 1;
+    }
+    
+    auto lease = pool_.acquire();
+    if (!lease) return 0;
+    MYSQL* conn = lease.get();
+    
+    // 每块先按主键取区间上界，再在 [下界, 上界] 内删除符合条件的行：
+    // 每条 DELETE 只锁住一小段主键区间，自动提交后立即释放
+    uint64_t deleted = 0;
+    std::string lower;
+    while (!stopping_) {
+        std::string query = "SELECT xid FROM alipay_transactions WHERE xid > ";
+        appendSqlString(conn, query, lower);
+        query += " ORDER BY xid LIMIT 1 OFFSET ";
+        appendSqlUInt(query, chunkSize - 1);
+        if (mysql_real_query(conn, query.data(), static_cast<unsigned long>(query.size())) != 0) {
+            break;
+        }
+        MYSQL_RES* result = mysql_store_result(conn);
+        if (!result) break;
+        MYSQL_ROW row = mysql_fetch_row(result);
+        bool last = row == nullptr;
+        std::string upper = row ? row[0] : "";
         mysql_free_result(result);
+        
+        query = "DELETE FROM alipay_transactions WHERE xid > ";
+        appendSqlString(conn, query, lower);
+        if (!last) {
+            query += " AND xid <= ";
+            appendSqlString(conn, query, upper);
+        }
+        query += " AND status IN (";
+        appendSqlUInt(query, statusCode(TransactionStatus::COMMITTED));
+        query += ", ";
+        appendSqlUInt(query, statusCode(TransactionStatus::ROLLED_BACK));
+        query += ", ";
+        appendSqlUInt(query, statusCode(TransactionStatus::FAILED));
+        query += ") AND update_time < ";
+        appendSqlUInt(query, beforeTime);
+        if (mysql_real_query(conn, query.data(), static_cast<unsigned long>(query.size())) != 0) {
+            break;
+        }
+        deleted += mysql_affected_rows(conn);
+        
+        if (last) break;
+        lower = std::move(upper);
     }
-    catch (const std::exception&) {
-        // 记录错误日志
+    
+    purged_.fetch_add(deleted, std::memory_order_relaxed);
+    return deleted;
+}
+
+void AlipayTransactionManager::setReaperOptions(const TransactionReaperOptions& options) {
+    {
+        std::lock_guard<std::mutex> lock(reaper_mutex_);
+        reaper_options_ = options;
     }
-} 
\ No newline at end of file
+    reaper_wakeup_.notify_all();
+}
+
+TransactionReaperStats AlipayTransactionManager::reaperStats() const {
+    TransactionReaperStats stats;
+    stats.reaped = reaped_.load(std::memory_order_relaxed);
+    stats.purged = purged_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AlipayTransactionManager::scheduleDeadline(const std::string& xid) {
+    bool earliest;
+    {
+        std::lock_guard<std::mutex> lock(reaper_mutex_);
+        uint64_t at = steadyNowMs() + reaper_options_.timeout_ms;
+        earliest = deadlines_.empty() || at < deadlines_.top().at_ms;
+        deadlines_.push(Deadline{at, xid});
+    }
+    // 只有成为新的堆顶时才需要唤醒回收线程
+    if (earliest) {
+        reaper_wakeup_.notify_one();
+    }
+}
+
+void AlipayTransactionManager::runReaper() {
+    // reaper_options_ 可被 setReaperOptions 修改，只在持有 reaper_mutex_ 时读取
+    auto interval = [this] { return std::max<uint64_t>(reaper_options_.cleanup_interval_s, 1) * 1000; };
+    
+    std::unique_lock<std::mutex> lock(reaper_mutex_);
+    uint64_t nextCleanup = steadyNowMs() + interval();
+    while (!reaper_stopping_) {
+        uint64_t now = steadyNowMs();
+        if (!deadlines_.empty() && deadlines_.top().at_ms <= now) {
+            Deadline deadline = deadlines_.top();
+            deadlines_.pop();
+            lock.unlock();
+            reap(deadline);
+            lock.lock();
+            continue;
+        }
+        
+        if (now >= nextCleanup) {
+            uint64_t retention = reaper_options_.retention_s;
+            nextCleanup = now + interval();
+            if (retention > 0) {
+                lock.unlock();
+                uint64_t cutoff = std::chrono::system_clock::to_time_t(
+                    std::chrono::system_clock::now());
+                cleanupTransactions(cutoff > retention ? cutoff - retention : 0);
+                lock.lock();
+            }
+            continue;
+        }
+        
+        uint64_t wakeAt = nextCleanup;
+        if (!deadlines_.empty()) {
+            wakeAt = std::min(wakeAt, deadlines_.top().at_ms);
+        }
+        reaper_wakeup_.wait_for(lock, std::chrono::milliseconds(wakeAt - now));
+    }
+}
+
+void AlipayTransactionManager::reap(const Deadline& deadline) {
+    const std::string& xid = deadline.xid;
+    ActiveTransaction active;
+    if (!findTransaction(xid, active) || !active.transaction) {
+        return; // 已结束，或是恢复出的事务（由恢复线程裁决）
+    }
+    AlipayTransaction& transaction = *active.transaction;
+    // 调用方已开始准备或提交时放弃回收；已中止说明上次回收未完成，继续重试
+    if (!transaction.tryAbort() && !transaction.aborted()) {
+        return;
+    }
+    
+    // 持有连接的调用方线程可能正在使用它，不能在本线程上回滚；从另一条连接 KILL，
+    // 连接断开后 MySQL 回滚未准备的 XA 分支并释放行锁。线程已不存在同样视为成功
+    bool killed = true;
+    for (size_t i = 0; i < transaction.resourceManagerCount(); ++i) {
+        AlipayConnectionPool* pool = i == 0 ? &pool_ : participantPool(transaction.participantName(i));
+        auto lease = pool ? pool->acquire() : PooledConnection();
+        if (!lease) {
+            killed = false;
+            continue;
+        }
+        
+        std::string query = "KILL ";
+        appendSqlUInt(query, transaction.connectionId(i));
+        if (mysql_real_query(lease.get(), query.data(), static_cast<unsigned long>(query.size())) != 0 &&
+            mysql_errno(lease.get()) != ER_NO_SUCH_THREAD) {
+            killed = false;
+        }
+    }
+    
+    // 仍有分支持有行锁时不能记为回滚，退避后重试
+    if (!killed) {
+        uint32_t attempts = deadline.attempts + 1;
+        uint64_t backoff = std::min<uint64_t>(kReapRetryBaseMs << std::min<uint32_t>(attempts - 1, 6),
+                                              kReapRetryMaxMs);
+        std::lock_guard<std::mutex> lock(reaper_mutex_);
+        deadlines_.push(Deadline{steadyNowMs() + backoff, xid, attempts});
+        return;
+    }
+    
+    updateTransactionStatus(active.record, TransactionStatus::ROLLED_BACK);
+    erase(xid);
+    reaped_.fetch_add(1, std::memory_order_relaxed);
+}
+
+void AlipayTransactionManager::recoverTransactions() {
+    bool expected = false;
+    if (!recovery_running_.compare_exchange_strong(expected, true)) {
+        return; // 已在恢复中
+    }
+    if (recovery_thread_.joinable()) {
+        recovery_thread_.join();
+    }
+    recovery_thread_ = std::thread([this] {
+        runRecovery();
+        recovery_running_ = false;
+    });
+}
+
+void AlipayTransactionManager::waitForRecovery() {
+    if (recovery_thread_.joinable()) {
+        recovery_thread_.join();
+    }
+}
+
+TransactionRecoveryStats AlipayTransactionManager::recoveryStats() const {
+    TransactionRecoveryStats stats;
+    stats.running = recovery_running_.load();
+    stats.scanned = recovery_scanned_.load(std::memory_order_relaxed);
+    stats.committed = recovery_committed_.load(std::memory_order_relaxed);
+    stats.rolled_back = recovery_rolled_back_.load(std::memory_order_relaxed);
+    stats.one_phase = recovery_one_phase_.load(std::memory_order_relaxed);
+    stats.orphans = recovery_orphans_.load(std::memory_order_relaxed);
+    stats.unresolved = recovery_unresolved_.load(std::memory_order_relaxed);
+    return stats;
+}
+
+void AlipayTransactionManager::runRecovery() {
+    // 先取各资源管理器的 XA RECOVER 快照；取不到时无法判断分支状态，放弃本次恢复
+    std::vector<PreparedBranches> prepared(participants_.size() + 1);
+    if (!loadPreparedBranches(pool_, prepared[0])) {
+        return;
+    }
+    for (size_t i = 0; i < participants_.size(); ++i) {
+        if (!loadPreparedBranches(*participants_[i].pool, prepared[i + 1])) {
+            return;
+        }
+    }
+    {
+        std::lock_guard<std::mutex> lock(prepared_mutex_);
+        prepared_ = std::move(prepared);
+    }
+    
+    // 一边裁决上一批，一边读取下一批；内存中最多两批记录
+    std::vector<std::future<void>> inflight;
+    std::vector<TransactionRecord> records;
+    bool scanned = true;
+    
+    if (wal_) {
+        // 启用 WAL 时以 WAL 重放结果为准（打开时已重放）
+        std::vector<TransactionRecord> live = wal_->liveTransactions();
+        live.erase(std::remove_if(live.begin(), live.end(),
+                                  [this](const TransactionRecord& record) {
+                                      return !AlipayIdGenerator::generatedBefore(
+                                          record.xid, recovery_cutoff_xid_);
+                                  }),
+                   live.end());
+        for (size_t start = 0; start < live.size() && !stopping_; start += kRecoveryChunkSize) {
+            size_t end = std::min(live.size(), start + kRecoveryChunkSize);
+            records.assign(std::make_move_iterator(live.begin() + start),
+                           std::make_move_iterator(live.begin() + end));
+            dispatchRecoveryChunk(records, inflight);
+        }
+    } else {
+        auto lease = pool_.acquire();
+        if (!lease) {
+            return;
+        }
+        // 已作出提交决定的 PREPARED 先处理，尽早释放参与者上的锁
+        for (TransactionStatus status : {TransactionStatus::PREPARED, TransactionStatus::STARTED}) {
+            std::string afterXid;
+            while (!stopping_) {
+                std::string previousXid = afterXid;
+                if (!fetchRecoveryChunk(lease.get(), status, afterXid, records)) {
+                    scanned = false;
+                    break;
+                }
+                if (afterXid == previousXid) break;
+                if (!records.empty()) dispatchRecoveryChunk(records, inflight);
+            }
+        }
+    }
+    
+    for (auto& task : inflight) {
+        task.get();
+    }
+    // 事务日志没有读完时无法区分孤立分支
+    if (scanned && !stopping_) {
+        resolveOrphans();
+    }
+}
+
+bool AlipayTransactionManager::loadPreparedBranches(AlipayConnectionPool& pool,
+                                                    PreparedBranches& branches) {
+    auto lease = pool.acquire();
+    if (!lease) return false;
+    MYSQL* conn = lease.get();
+    
+    if (mysql_query(conn, "XA RECOVER") != 0) {
+        return false;
+    }
+    MYSQL_RES* result = mysql_use_result(conn);
+    if (!result) {
+        return false;
+    }
+    
+    // 列：formatID, gtrid_length, bqual_length, data（gtrid 与 bqual 首尾相接）
+    MYSQL_ROW row;
+    while ((row = mysql_fetch_row(result))) {
+        unsigned long* lengths = mysql_fetch_lengths(result);
+        size_t gtridLength = std::strtoul(row[1], nullptr, 10);
+        size_t bqualLength = std::strtoul(row[2], nullptr, 10);
+        if (gtridLength + bqualLength > lengths[3]) continue;
+        branches.insert(branchKey(std::string(row[3], gtridLength),
+                                  std::string(row[3] + gtridLength, bqualLength)));
+    }
+    mysql_free_result(result);
+    return true;
+}
+
+bool AlipayTransactionManager::fetchRecoveryChunk(MYSQL* conn, TransactionStatus status,
+                                                  std::string& afterXid,
+                                                  std::vector<TransactionRecord>& records) {
+    records.clear();
+    
+    // idx_status 的叶子按 (status, xid) 有序，按 xid 翻页不需要排序也不会重复扫描。
+    // 只裁决本进程启动前的事务，本进程的事务由调用方自己结束；旧版本的 XID 与定长 XID
+    // 的字典序和时间先后无关，不能在 SQL 中按 XID 截断，取回后逐条判断
+    std::string query = "SELECT xid, status, create_time, update_time, order_no, participants "
+                        "FROM alipay_transactions WHERE status = ";
+    appendSqlUInt(query, statusCode(status));
+    query += " AND xid > ";
+    appendSqlString(conn, query, afterXid);
+    query += " ORDER BY xid LIMIT ";
+    appendSqlUInt(query, kRecoveryChunkSize);
+    
+    if (mysql_real_query(conn, query.data(), static_cast<unsigned long>(query.size())) != 0) {
+        return false;
+    }
+    MYSQL_RES* result = mysql_use_result(conn);
+    if (!result) {
+        return false;
+    }
+    
+    MYSQL_ROW row;
+    std::string lastXid;
+    while ((row = mysql_fetch_row(result))) {
+        lastXid = row[0];
+        if (!AlipayIdGenerator::generatedBefore(lastXid, recovery_cutoff_xid_)) continue;
+        TransactionRecord record{
+            .xid = row[0],
+            .status = statusFromField<TransactionStatus>(row[1]).value_or(TransactionStatus::FAILED),
+            .create_time = std::strtoull(row[2], nullptr, 10),
+            .update_time = std::strtoull(row[3], nullptr, 10),
+            .order_no = row[4],
+            .participants = splitParticipants(row[5])
+        };
+        records.push_back(std::move(record));
+    }
+    bool ok = mysql_errno(conn) == 0;
+    mysql_free_result(result);
+    // 被跳过的行也计入翻页位置；afterXid 不变表示已读完
+    if (ok && !lastXid.empty()) {
+        afterXid = std::move(lastXid);
+    }
+    return ok;
+}
+
+void AlipayTransactionManager::dispatchRecoveryChunk(std::vector<TransactionRecord>& records,
+                                                     std::vector<std::future<void>>& inflight) {
+    recovery_scanned_.fetch_add(records.size(), std::memory_order_relaxed);
+    
+    // 先放入活动表，恢复期间即可查询状态；活动表中已有本进程仍在进行的事务时跳过，
+    // 防止调用方的事务被当作待恢复事务裁决
+    size_t kept = 0;
+    for (auto& record : records) {
+        TransactionShard& shard = shardFor(record.xid);
+        std::lock_guard<std::mutex> lock(shard.mutex);
+        auto [it, inserted] = shard.transactions.emplace(record.xid, ActiveTransaction{record, nullptr});
+        if (!inserted && it->second.transaction) continue;
+        if (&records[kept] != &record) records[kept] = std::move(record);
+        ++kept;
+    }
+    records.resize(kept);
+    
+    for (auto& task : inflight) {
+        task.get();
+    }
+    inflight.clear();
+    
+    for (auto& record : records) {
+        auto task = std::make_shared<std::packaged_task<void()>>(
+            [this, record = std::move(record)] { resolveRecord(record); });
+        inflight.push_back(task->get_future());
+        io_pool_->submit([task](size_t) { (*task)(); });
+    }
+    records.clear();
+}
+
+void AlipayTransactionManager::resolveRecord(const TransactionRecord& record) {
+    // 一阶段提交没有 in-doubt 状态，分支已由 MySQL 提交或回滚，协调者无从得知也无需裁决；
+    // 记为 FAILED 使其不再参与恢复，实际结果以订单、支付表为准
+    if (isOnePhaseCommit(record)) {
+        if (!updateTransactionStatus(record, TransactionStatus::FAILED)) {
+            recovery_unresolved_.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+        recovery_one_phase_.fetch_add(1, std::memory_order_relaxed);
+        erase(record.xid);
+        return;
+    }
+    
+    // 只有全部分支准备成功后才会写 PREPARED，因此 PREPARED 提交、其余推定回滚；
+    // XA RECOVER 中没有的分支已经结束（或从未准备，已随连接断开回滚）
+    bool commit = record.status == TransactionStatus::PREPARED;
+    bool resolved = resolveBranch(0, record.xid, "", commit);
+    for (size_t i = 1; i < record.participants.size(); ++i) {
+        const std::string& name = record.participants[i];
+        if (isPrimaryParticipant(name)) continue;
+        
+        size_t rm = 0;
+        for (size_t p = 0; p < participants_.size(); ++p) {
+            if (participants_[p].name == name) rm = p + 1;
+        }
+        resolved = rm != 0 && resolveBranch(rm, record.xid, name, commit) && resolved;
+    }
+    
+    TransactionStatus status = commit ? TransactionStatus::COMMITTED : TransactionStatus::ROLLED_BACK;
+    if (!resolved || !updateTransactionStatus(record, status)) {
+        recovery_unresolved_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    (commit ? recovery_committed_ : recovery_rolled_back_).fetch_add(1, std::memory_order_relaxed);
+    erase(record.xid);
+}
+
+bool AlipayTransactionManager::resolveBranch(size_t rm, const std::string& gtrid,
+                                             const std::string& bqual, bool commit) {
+    std::string key = branchKey(gtrid, bqual);
+    {
+        std::lock_guard<std::mutex> lock(prepared_mutex_);
+        if (prepared_[rm].erase(key) == 0) return true;
+    }
+    
+    AlipayConnectionPool& pool = rm == 0 ? pool_ : *participants_[rm - 1].pool;
+    auto lease = pool.acquire();
+    bool ok = false;
+    if (lease) {
+        MYSQL* conn = lease.get();
+        std::string query = commit ? "XA COMMIT " : "XA ROLLBACK ";
+        appendSqlString(conn, query, gtrid);
+        if (!bqual.empty()) {
+            query += ",";
+            appendSqlString(conn, query, bqual);
+        }
+        // XAER_NOTA：分支已被其他途径结束
+        ok = mysql_real_query(conn, query.data(), static_cast<unsigned long>(query.size())) == 0 ||
+             mysql_errno(conn) == ER_XAER_NOTA;
+    }
+    if (!ok) {
+        // 留给下次恢复
+        std::lock_guard<std::mutex> lock(prepared_mutex_);
+        prepared_[rm].insert(key);
+    }
+    return ok;
+}
+
+void AlipayTransactionManager::resolveOrphans() {
+    // 剩下的分支在事务日志中没有未结束的记录：开始记录未落盘、或已记为回滚但回滚未完成，一律回滚。
+    // 只处理本进程启动前生成的 XID（含旧版本格式）；更早的若仍在活动表中也跳过
+    std::vector<std::pair<size_t, std::string>> orphans;
+    {
+        std::lock_guard<std::mutex> lock(prepared_mutex_);
+        for (size_t rm = 0; rm < prepared_.size(); ++rm) {
+            for (const auto& key : prepared_[rm]) {
+                std::string_view gtrid(key.data(), key.find('\n'));
+                if (AlipayIdGenerator::generatedBefore(gtrid, recovery_cutoff_xid_)) {
+                    orphans.emplace_back(rm, key);
+                }
+            }
+        }
+    }
+    
+    for (const auto& [rm, key] : orphans) {
+        size_t separator = key.find('\n');
+        std::string gtrid = key.substr(0, separator);
+        ActiveTransaction active;
+        if (findTransaction(gtrid, active)) continue;
+        
+        if (resolveBranch(rm, gtrid, key.substr(separator + 1), false)) {
+            recovery_orphans_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+}
@@ -0,0 +1,451 @@
+#include "alipay_transaction_wal.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include <cstdio>
+#include <cerrno>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+namespace {
+
+const char kSegmentMagic[8] = {'A', 'L', 'P', 'W', 'A', 'L', '0', '1'};
+const uint32_t kMaxPayloadSize = 1 << 20;    // 超过视为损坏
+
+// CRC32C（Castagnoli），查表实现
+uint32_t crc32c(const char* data, size_t size) {
+    static const auto table = [] {
+        std::array<uint32_t, 256> t{};
+        for (uint32_t i = 0; i < 256; ++i) {
+            uint32_t crc = i;
+            for (int k = 0; k < 8; ++k) {
+                crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1)));
+            }
+            t[i] = crc;
+        }
+        return t;
+    }();
+
+    uint32_t crc = 0xFFFFFFFFu;
+    for (size_t i = 0; i < size; ++i) {
+        crc = table[(crc ^ static_cast<uint8_t>(data[i])) & 0xFF] ^ (crc >> 8);
+    }
+    return crc ^ 0xFFFFFFFFu;
+}
+
+// 定长整数按小端写入
+template <typename T>
+void putInt(std::string& out, T value) {
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        out.push_back(static_cast<char>((static_cast<uint64_t>(value) >> (8 * i)) & 0xFF));
+    }
+}
+
+template <typename T>
+bool getInt(const char*& cursor, const char* end, T& value) {
+    if (static_cast<size_t>(end - cursor) < sizeof(T)) return false;
+    uint64_t result = 0;
+    for (size_t i = 0; i < sizeof(T); ++i) {
+        result |= static_cast<uint64_t>(static_cast<uint8_t>(cursor[i])) << (8 * i);
+    }
+    value = static_cast<T>(result);
+    cursor += sizeof(T);
+    return true;
+}
+
+void putString(std::string& out, const std::string& value) {
+    putInt<uint16_t>(out, static_cast<uint16_t>(value.size()));
+    out.append(value, 0, std::min<size_t>(value.size(), UINT16_MAX));
+}
+
+bool getString(const char*& cursor, const char* end, std::string& value) {
+    uint16_t length;
+    if (!getInt(cursor, end, length) || end - cursor < length) return false;
+    value.assign(cursor, length);
+    cursor += length;
+    return true;
+}
+
+// 帧：[载荷长度][CRC32C(载荷)][载荷]
+void encodeRecord(std::string& out, const TransactionRecord& record) {
+    std::string payload;
+    putInt<uint8_t>(payload, static_cast<uint8_t>(record.status));
+    putInt<uint64_t>(payload, record.create_time);
+    putInt<uint64_t>(payload, record.update_time);
+    putString(payload, record.xid);
+    putString(payload, record.order_no);
+    putInt<uint16_t>(payload, static_cast<uint16_t>(record.participants.size()));
+    for (const auto& participant : record.participants) {
+        putString(payload, participant);
+    }
+
+    putInt<uint32_t>(out, static_cast<uint32_t>(payload.size()));
+    putInt<uint32_t>(out, crc32c(payload.data(), payload.size()));
+    out += payload;
+}
+
+bool decodeRecord(const char* cursor, const char* end, TransactionRecord& record) {
+    uint8_t status;
+    uint16_t participants;
+    if (!getInt(cursor, end, status) || status > static_cast<uint8_t>(TransactionStatus::FAILED) ||
+        !getInt(cursor, end, record.create_time) ||
+        !getInt(cursor, end, record.update_time) ||
+        !getString(cursor, end, record.xid) ||
+        !getString(cursor, end, record.order_no) ||
+        !getInt(cursor, end, participants)) {
+        return false;
+    }
+    record.status = static_cast<TransactionStatus>(status);
+    record.participants.resize(participants);
+    for (auto& participant : record.participants) {
+        if (!getString(cursor, end, participant)) return false;
+    }
+    return cursor == end;
+}
+
+bool syncDirectory(const std::string& directory) {
+    int fd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY);
+    if (fd < 0) return false;
+    bool ok = fsync(fd) == 0;
+    ::close(fd);
+    return ok;
+}
+
+bool readFile(const std::string& path, std::string& data) {
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    data.clear();
+    char buffer[1 << 16];
+    ssize_t n;
+    while ((n = read(fd, buffer, sizeof(buffer))) > 0) {
+        data.append(buffer, static_cast<size_t>(n));
+    }
+    ::close(fd);
+    return n == 0;
+}
+
+} // namespace
+
+AlipayTransactionWal::AlipayTransactionWal(const TransactionWalOptions& options)
+    : options_(options) {}
+
+AlipayTransactionWal::~AlipayTransactionWal() {
+    close();
+}
+
+bool AlipayTransactionWal::isTerminal(TransactionStatus status) {
+    return status == TransactionStatus::COMMITTED ||
+           status == TransactionStatus::ROLLED_BACK ||
+           status == TransactionStatus::FAILED;
+}
+
+std::string AlipayTransactionWal::segmentPath(uint64_t sequence) const {
+    char name[32];
+    snprintf(name, sizeof(name), "wal-%016llu.log", static_cast<unsigned long long>(sequence));
+    return options_.directory + "/" + name;
+}
+
+void AlipayTransactionWal::crashPoint(const char* point) const {
+    if (options_.crash_hook) options_.crash_hook(point);
+}
+
+bool AlipayTransactionWal::open(std::string& error) {
+    DIR* dir = opendir(options_.directory.c_str());
+    if (!dir) {
+        error = "无法打开 WAL 目录: " + options_.directory;
+        return false;
+    }
+    std::vector<uint64_t> sequences;
+    while (dirent* entry = readdir(dir)) {
+        unsigned long long sequence;
+        char tail;
+        if (sscanf(entry->d_name, "wal-%16llu.lo%c", &sequence, &tail) == 2 && tail == 'g' &&
+            strlen(entry->d_name) == 24) {
+            sequences.push_back(sequence);
+        }
+    }
+    closedir(dir);
+    std::sort(sequences.begin(), sequences.end());
+
+    // 按顺序重放，后出现的记录覆盖先前的状态
+    for (size_t i = 0; i < sequences.size(); ++i) {
+        if (!replaySegment(sequences[i], i + 1 == sequences.size(), error)) return false;
+    }
+
+    // 总是切换到新段：新段以快照开头，落盘后旧段全部删除
+    sealed_ = sequences;
+    if (!startSegment(sequences.empty() ? 1 : sequences.back() + 1, error)) return false;
+
+    stopping_ = false;
+    flusher_ = std::thread(&AlipayTransactionWal::run, this);
+    return true;
+}
+
+bool AlipayTransactionWal::replaySegment(uint64_t sequence, bool last, std::string& error) {
+    std::string path = segmentPath(sequence);
+    std::string data;
+    if (!readFile(path, data)) {
+        error = "读取 WAL 段失败: " + path;
+        return false;
+    }
+
+    // 文件头与快照在新段的第一次 fdatasync 之前写入，文件头不完整的段里不可能有已确认的记录；
+    // 最后一段出现这种情况说明创建段时崩溃，按空段处理
+    if (data.size() < sizeof(kSegmentMagic) ||
+        memcmp(data.data(), kSegmentMagic, sizeof(kSegmentMagic)) != 0) {
+        if (last) return true;
+        error = "WAL 段文件头损坏: " + path;
+        return false;
+    }
+
+    const char* begin = data.data();
+    const char* end = begin + data.size();
+    const char* cursor = begin + sizeof(kSegmentMagic);
+    while (cursor < end) {
+        const char* frame = cursor;
+        uint32_t length, checksum;
+        TransactionRecord record;
+        bool valid = getInt(cursor, end, length) && getInt(cursor, end, checksum) &&
+                     length <= kMaxPayloadSize && static_cast<size_t>(end - cursor) >= length &&
+                     crc32c(cursor, length) == checksum &&
+                     decodeRecord(cursor, cursor + length, record);
+        if (!valid) {
+            // 只有最后一段允许出现残缺的尾部（最后一批写到一半时崩溃），截断后继续
+            if (!last) {
+                error = "WAL 段损坏: " + path;
+                return false;
+            }
+            int fd = ::open(path.c_str(), O_WRONLY);
+            bool truncated = fd >= 0 && ftruncate(fd, frame - begin) == 0 && fdatasync(fd) == 0;
+            if (fd >= 0) ::close(fd);
+            if (!truncated) {
+                error = "截断 WAL 段失败: " + path;
+                return false;
+            }
+            return true;
+        }
+        cursor += length;
+        applyLive(record);
+    }
+    return true;
+}
+
+bool AlipayTransactionWal::startSegment(uint64_t sequence, std::string& error) {
+    std::string path = segmentPath(sequence);
+    int fd = ::open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_APPEND, 0644);
+    if (fd < 0) {
+        error = "创建 WAL 段失败: " + path;
+        return false;
+    }
+    crashPoint("segment_created");
+
+    // 文件头 + 当前未结束事务的快照
+    std::string bytes(kSegmentMagic, sizeof(kSegmentMagic));
+    {
+        std::lock_guard<std::mutex> lock(live_mutex_);
+        for (const auto& entry : live_) {
+            encodeRecord(bytes, entry.second);
+        }
+    }
+
+    int previous = fd_;
+    fd_ = fd;
+    bool ok = writeAll(bytes.data(), bytes.size());
+    crashPoint("snapshot_written");
+    ok = ok && fdatasync(fd) == 0 && syncDirectory(options_.directory);
+    if (!ok) {
+        // 删除写了一半的新段，保证当前段仍是最后一段（重放时只有最后一段允许残缺）
+        fd_ = previous;
+        ::close(fd);
+        unlink(path.c_str());
+        error = "写入 WAL 段失败: " + path;
+        return false;
+    }
+    if (previous >= 0) ::close(previous);
+    sequence_ = sequence;
+    segment_size_ = bytes.size();
+    syncs_.fetch_add(1, std::memory_order_relaxed);
+
+    // 新段已包含全部未结束事务，旧段可以删除
+    crashPoint("before_compact");
+    for (uint64_t old : sealed_) {
+        unlink(segmentPath(old).c_str());
+    }
+    if (!sealed_.empty()) syncDirectory(options_.directory);
+    sealed_.clear();
+    return true;
+}
+
+bool AlipayTransactionWal::rotate(std::string& error) {
+    sealed_.push_back(sequence_);
+    if (!startSegment(sequence_ + 1, error)) {
+        sealed_.pop_back();
+        return false;
+    }
+    rotations_.fetch_add(1, std::memory_order_relaxed);
+    return true;
+}
+
+bool AlipayTransactionWal::truncateTail() {
+    if (fd_ < 0 || ftruncate(fd_, static_cast<off_t>(segment_size_)) != 0 || fdatasync(fd_) != 0) {
+        return false;
+    }
+    tail_dirty_ = false;
+    return true;
+}
+
+bool AlipayTransactionWal::writeAll(const char* data, size_t size) {
+    while (size > 0) {
+        ssize_t n = write(fd_, data, size);
+        if (n < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+void AlipayTransactionWal::applyLive(const TransactionRecord& record) {
+    std::lock_guard<std::mutex> lock(live_mutex_);
+    if (isTerminal(record.status)) {
+        live_.erase(record.xid);
+    } else {
+        live_[record.xid] = record;
+    }
+}
+
+void AlipayTransactionWal::close() {
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    pending_.notify_all();
+    if (flusher_.joinable()) flusher_.join();
+
+    if (fd_ >= 0) {
+        ::close(fd_);
+        fd_ = -1;
+    }
+}
+
+bool AlipayTransactionWal::append(const TransactionRecord& record) {
+    return appendAsync(record).get();
+}
+
+std::shared_future<bool> AlipayTransactionWal::appendAsync(const TransactionRecord& record) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (stopping_ || !flusher_.joinable()) {
+        std::promise<bool> rejected;
+        rejected.set_value(false);
+        return rejected.get_future().share();
+    }
+
+    if (batches_.empty() || batches_.back()->records.size() >= batches_.back()->capacity) {
+        auto batch = std::make_shared<WalBatch>();
+        batch->capacity = options_.max_batch > 0 ? options_.max_batch : 1;
+        batch->opened = std::chrono::steady_clock::now();
+        batch->done = batch->promise.get_future().share();
+        batches_.push_back(std::move(batch));
+    }
+
+    // 在调用线程编码，写线程只做 write 和 fdatasync
+    WalBatch& batch = *batches_.back();
+    encodeRecord(batch.bytes, record);
+    batch.records.push_back(record);
+    std::shared_future<bool> done = batch.done;
+
+    bool wake = batch.records.size() == 1 || batch.records.size() >= batch.capacity;
+    lock.unlock();
+    if (wake) pending_.notify_one();
+    return done;
+}
+
+std::vector<TransactionRecord> AlipayTransactionWal::liveTransactions() const {
+    std::lock_guard<std::mutex> lock(live_mutex_);
+    std::vector<TransactionRecord> records;
+    records.reserve(live_.size());
+    for (const auto& entry : live_) {
+        records.push_back(entry.second);
+    }
+    return records;
+}
+
+void AlipayTransactionWal::compact() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    compact_requested_ = true;
+}
+
+TransactionWalStats AlipayTransactionWal::stats() const {
+    TransactionWalStats stats;
+    stats.records = records_.load(std::memory_order_relaxed);
+    stats.syncs = syncs_.load(std::memory_order_relaxed);
+    stats.rotations = rotations_.load(std::memory_order_relaxed);
+    std::lock_guard<std::mutex> lock(live_mutex_);
+    stats.live = live_.size();
+    return stats;
+}
+
+void AlipayTransactionWal::run() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (true) {
+        pending_.wait(lock, [this] { return stopping_ || !batches_.empty(); });
+        if (batches_.empty()) return;
+
+        std::shared_ptr<WalBatch> batch = batches_.front();
+        auto deadline = batch->opened + std::chrono::microseconds(options_.max_wait_us);
+        pending_.wait_until(lock, deadline, [this, &batch] {
+            return stopping_ || batches_.size() > 1 ||
+                   batch->records.size() >= batch->capacity;
+        });
+        batches_.pop_front();
+        bool compact = compact_requested_;
+        compact_requested_ = false;
+        lock.unlock();
+
+        // 段写满或收到压缩请求时先切换新段；写入失败的段须先截掉残缺的尾部
+        std::string error;
+        bool ok = !tail_dirty_ || truncateTail();
+        if (ok && (compact || segment_size_ + batch->bytes.size() > options_.segment_bytes)) {
+            ok = rotate(error);
+        }
+
+        if (ok) {
+            const char* data = batch->bytes.data();
+            size_t size = batch->bytes.size();
+            if (options_.crash_hook) {
+                // 测试时分两次写，以便在记录中间崩溃
+                size_t half = size / 2;
+                ok = writeAll(data, half);
+                crashPoint("mid_write");
+                ok = ok && writeAll(data + half, size - half);
+            } else {
+                ok = writeAll(data, size);
+            }
+            crashPoint("before_sync");
+            ok = ok && fdatasync(fd_) == 0;
+            crashPoint("after_sync");
+        }
+
+        if (ok) {
+            segment_size_ += batch->bytes.size();
+            syncs_.fetch_add(1, std::memory_order_relaxed);
+            records_.fetch_add(batch->records.size(), std::memory_order_relaxed);
+            for (const auto& record : batch->records) {
+                applyLive(record);
+            }
+        } else {
+            // 截回上次落盘的位置：残缺的记录留在之后被封存的段里会使重放失败。
+            // 截断失败时由下一批重试，截断成功后才切换新段
+            tail_dirty_ = true;
+            truncateTail();
+            std::lock_guard<std::mutex> guard(mutex_);
+            compact_requested_ = true;
+        }
+        batch->promise.set_value(ok);
+        lock.lock();
+    }
+}
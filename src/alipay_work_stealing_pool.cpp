@@ -0,0 +1,110 @@
+#include "alipay_work_stealing_pool.h"
+
+AlipayWorkStealingPool::AlipayWorkStealingPool(size_t workers) {
+    if (workers == 0) workers = 1;
+
+    for (size_t i = 0; i < workers; ++i) {
+        workers_.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < workers; ++i) {
+        threads_.emplace_back(&AlipayWorkStealingPool::run, this, i);
+    }
+}
+
+AlipayWorkStealingPool::~AlipayWorkStealingPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        stopping_ = true;
+    }
+    work_available_.notify_all();
+    for (auto& thread : threads_) {
+        thread.join();
+    }
+}
+
+void AlipayWorkStealingPool::submit(Task task) {
+    size_t index = next_worker_.fetch_add(1, std::memory_order_relaxed) % workers_.size();
+    pending_.fetch_add(1, std::memory_order_relaxed);
+    {
+        std::lock_guard<std::mutex> lock(workers_[index]->mutex);
+        workers_[index]->tasks.push_back(std::move(task));
+    }
+
+    // 在 mutex_ 内递增，避免与工作线程的等待判断错过唤醒
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        queued_.fetch_add(1, std::memory_order_release);
+    }
+    work_available_.notify_one();
+}
+
+void AlipayWorkStealingPool::wait() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    all_done_.wait(lock, [this] { return pending_.load(std::memory_order_acquire) == 0; });
+}
+
+WorkStealingStats AlipayWorkStealingPool::stats() const {
+    WorkStealingStats stats;
+    for (const auto& worker : workers_) {
+        stats.executed += worker->executed.load(std::memory_order_relaxed);
+        stats.stolen += worker->stolen.load(std::memory_order_relaxed);
+    }
+    return stats;
+}
+
+bool AlipayWorkStealingPool::popLocal(size_t index, Task& task) {
+    Worker& worker = *workers_[index];
+    std::lock_guard<std::mutex> lock(worker.mutex);
+    if (worker.tasks.empty()) return false;
+
+    task = std::move(worker.tasks.back());
+    worker.tasks.pop_back();
+    return true;
+}
+
+bool AlipayWorkStealingPool::steal(size_t index, Task& task) {
+    // 从下一个线程开始依次尝试，取最早入队的任务
+    for (size_t offset = 1; offset < workers_.size(); ++offset) {
+        Worker& victim = *workers_[(index + offset) % workers_.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (victim.tasks.empty()) continue;
+
+        task = std::move(victim.tasks.front());
+        victim.tasks.pop_front();
+        return true;
+    }
+    return false;
+}
+
+void AlipayWorkStealingPool::run(size_t index) {
+    Worker& self = *workers_[index];
+    Task task;
+
+    while (true) {
+        bool stolen = false;
+        if (!popLocal(index, task)) {
+            stolen = steal(index, task);
+            if (!stolen) {
+                std::unique_lock<std::mutex> lock(mutex_);
+                work_available_.wait(lock, [this] {
+                    return stopping_ || queued_.load(std::memory_order_acquire) > 0;
+                });
+                if (stopping_ && queued_.load(std::memory_order_acquire) == 0) return;
+                continue;
+            }
+        }
+
+        queued_.fetch_sub(1, std::memory_order_acq_rel);
+        task(index);
+        task = nullptr;
+
+        self.executed.fetch_add(1, std::memory_order_relaxed);
+        if (stolen) self.stolen.fetch_add(1, std::memory_order_relaxed);
+
+        if (pending_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            std::lock_guard<std::mutex> lock(mutex_);
+            all_done_.notify_all();
+        }
+    }
+}